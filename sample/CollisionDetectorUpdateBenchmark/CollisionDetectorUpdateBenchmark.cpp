@@ -0,0 +1,134 @@
+/**
+   This program answers whether CollisionDetector::updatePositions is faster than calling
+   updatePosition for each geometry. The geometries of AISTCollisionDetector are grouped
+   into bodies as a simulator registers the links, and their positions are updated
+   in the following three ways every frame.
+
+   - updatePosition for each geometry
+   - updatePositions for each body with the positions which are already stored in an array
+   - updatePositions for each body after copying the positions of the links into a buffer
+
+   The last one is what a simulator whose links are not stored contiguously has to do.
+
+   Usage: cdupdate-benchmark [number of bodies] [number of links per body] [number of frames]
+*/
+
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/MeshGenerator>
+#include <cnoid/SceneShape>
+#include <cnoid/TimeMeasure>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+typedef vector<Position, Eigen::aligned_allocator<Position> > PositionArray;
+
+enum UpdateType { EACH_GEOMETRY, CONTIGUOUS_ARRAY, COPIED_BUFFER };
+
+/**
+   @return the time per frame
+*/
+double measure(CollisionDetector& detector, UpdateType type, int numBodies, int numLinks, int numFrames)
+{
+    const int numGeometries = numBodies * numLinks;
+
+    // The link positions are held separately as the links of the bodies are
+    vector<PositionArray> linkPositions(numBodies, PositionArray(numLinks));
+    PositionArray positions(numGeometries);
+    PositionArray buffer(numLinks);
+
+    for(int i=0; i < numBodies; ++i){
+        for(int j=0; j < numLinks; ++j){
+            Position& T = linkPositions[i][j];
+            T.setIdentity();
+            T.translation() << j * 0.3, i * 0.3, 0.0;
+            positions[i * numLinks + j] = T;
+        }
+    }
+
+    TimeMeasure timer;
+    timer.begin();
+    
+    for(int frame=0; frame < numFrames; ++frame){
+        const double z = frame * 1.0e-6;
+        switch(type){
+        case EACH_GEOMETRY:
+            for(int i=0; i < numBodies; ++i){
+                for(int j=0; j < numLinks; ++j){
+                    Position& T = linkPositions[i][j];
+                    T.translation().z() = z;
+                    detector.updatePosition(i * numLinks + j, T);
+                }
+            }
+            break;
+        case CONTIGUOUS_ARRAY:
+            for(int i=0; i < numGeometries; ++i){
+                positions[i].translation().z() = z;
+            }
+            for(int i=0; i < numBodies; ++i){
+                detector.updatePositions(i * numLinks, (i + 1) * numLinks, &positions[i * numLinks]);
+            }
+            break;
+        case COPIED_BUFFER:
+            for(int i=0; i < numBodies; ++i){
+                for(int j=0; j < numLinks; ++j){
+                    Position& T = linkPositions[i][j];
+                    T.translation().z() = z;
+                    buffer[j] = T;
+                }
+                detector.updatePositions(i * numLinks, (i + 1) * numLinks, &buffer[0]);
+            }
+            break;
+        }
+    }
+
+    timer.end();
+    
+    return timer.time() / numFrames;
+}
+
+}
+
+
+int main(int argc, char** argv)
+{
+    const int numBodies = (argc > 1) ? atoi(argv[1]) : 100;
+    const int numLinks = (argc > 2) ? atoi(argv[2]) : 30;
+    const int numFrames = (argc > 3) ? atoi(argv[3]) : 2000;
+
+    AISTCollisionDetector detector;
+    MeshGenerator meshGenerator;
+    SgMeshPtr mesh = meshGenerator.generateBox(Vector3(0.1, 0.1, 0.1));
+    for(int i=0; i < numBodies * numLinks; ++i){
+        SgShapePtr shape = new SgShape;
+        shape->setMesh(mesh);
+        detector.addGeometry(shape);
+    }
+    detector.makeReady();
+
+    const char* typeNames[] = {
+        "updatePosition for each geometry",
+        "updatePositions with a contiguous array",
+        "updatePositions with a copied buffer"
+    };
+
+    printf("%d geometries (%d bodies of %d links), %d frames\n",
+           numBodies * numLinks, numBodies, numLinks, numFrames);
+
+    // The first round warms up the caches
+    for(int round=0; round < 2; ++round){
+        for(int type = EACH_GEOMETRY; type <= COPIED_BUFFER; ++type){
+            const double time = measure(detector, static_cast<UpdateType>(type), numBodies, numLinks, numFrames);
+            if(round > 0){
+                printf("%-42s %10.2f us/frame\n", typeNames[type], time * 1.0e6);
+            }
+        }
+    }
+
+    return 0;
+}
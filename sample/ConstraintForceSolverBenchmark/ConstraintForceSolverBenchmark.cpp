@@ -0,0 +1,184 @@
+/**
+   This program compares the two methods of assembling the acceleration matrix in
+   ConstraintForceSolver: applying a test force to each constraint vector and calculating
+   the accelerations by ABM, and summing J * M^-1 * J^T of the constrained bodies.
+   The scenes are made of boxes stacked on a floor and of articulated chains lying on it,
+   each of which has more than one hundred contact points.
+
+   Usage: cfs-benchmark [number of steps]
+*/
+
+#include <cnoid/Body>
+#include <cnoid/DyBody>
+#include <cnoid/DyWorld>
+#include <cnoid/ConstraintForceSolver>
+#include <cnoid/MeshGenerator>
+#include <cnoid/SceneShape>
+#include <cnoid/TimeMeasure>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+MeshGenerator meshGenerator;
+
+Link* createBoxLink(Body* body, const Vector3& size, Link::JointType jointType, const Vector3& axis, const Vector3& offset)
+{
+    Link* link = body->createLink();
+    SgShapePtr shape = new SgShape;
+    shape->setMesh(meshGenerator.generateBox(size));
+    link->setShape(shape);
+    link->setJointType(jointType);
+    link->setJointAxis(axis);
+    link->setOffsetTranslation(offset);
+    link->setMass(1.0);
+    link->setCenterOfMass(Vector3::Zero());
+    link->setInertia(Matrix3::Identity() * (size.squaredNorm() / 12.0));
+    return link;
+}
+
+BodyPtr createBox(const Vector3& size, bool isStatic)
+{
+    BodyPtr body = new Body;
+    body->setRootLink(
+        createBoxLink(body, size, isStatic ? Link::FIXED_JOINT : Link::FREE_JOINT, Vector3::UnitZ(), Vector3::Zero()));
+    return body;
+}
+
+BodyPtr createChain(int numJoints)
+{
+    BodyPtr body = new Body;
+    const Vector3 size(0.18, 0.1, 0.1);
+    Link* root = createBoxLink(body, size, Link::FREE_JOINT, Vector3::UnitZ(), Vector3::Zero());
+    Link* parent = root;
+    for(int i=0; i < numJoints; ++i){
+        const Vector3 axis = (i % 2) ? Vector3::UnitY() : Vector3::UnitZ();
+        Link* link = createBoxLink(body, size, Link::ROTATIONAL_JOINT, axis, Vector3(0.2, 0.0, 0.0));
+        link->setJointId(i);
+        link->setEquivalentRotorInertia(0.01);
+        parent->appendChild(link);
+        parent = link;
+    }
+    body->setRootLink(root);
+    return body;
+}
+
+// The initialization done in AISTSimulatorItem
+void addBody(World<ConstraintForceSolver>& world, DyBody* body)
+{
+    DyLink* rootLink = body->rootLink();
+    rootLink->v().setZero();
+    rootLink->dv().setZero();
+    rootLink->w().setZero();
+    rootLink->dw().setZero();
+    rootLink->vo().setZero();
+    rootLink->dvo().setZero();
+    body->clearExternalForces();
+    body->calcForwardKinematics(true, true);
+    world.addBody(body);
+}
+
+
+enum SceneType { BOX_STACKS, CHAINS };
+
+struct Result
+{
+    double timePerStep;
+    long long numIterations;
+    int numConstraintPoints;
+    std::vector<Vector3> positions;
+};
+
+Result simulate(SceneType scene, bool isMassMatrixAssemblyEnabled, int numSteps)
+{
+    World<ConstraintForceSolver> world;
+    ConstraintForceSolver& cfs = world.constraintForceSolver;
+    cfs.enableMassMatrixAssembly(isMassMatrixAssemblyEnabled);
+    cfs.enableConstraintForceOutput(true);
+
+    DyBodyPtr floor = new DyBody(*createBox(Vector3(100.0, 100.0, 1.0), true));
+    floor->rootLink()->p() << 0.0, 0.0, -0.5;
+    addBody(world, floor);
+
+    if(scene == BOX_STACKS){
+        // 5 x 5 stacks of 3 boxes which are slightly shifted
+        BodyPtr box = createBox(Vector3(0.2, 0.2, 0.2), false);
+        for(int i=0; i < 25; ++i){
+            for(int j=0; j < 3; ++j){
+                DyBodyPtr body = new DyBody(*box);
+                body->rootLink()->p() << (i % 5) * 0.5 + j * 0.02, (i / 5) * 0.5, 0.1 + j * 0.201;
+                body->rootLink()->R() = AngleAxis(0.1 * j, Vector3::UnitZ()).toRotationMatrix();
+                addBody(world, body);
+            }
+        }
+    } else {
+        // 10 chains of 9 links whose joints are bent
+        BodyPtr chain = createChain(8);
+        for(int i=0; i < 10; ++i){
+            DyBodyPtr body = new DyBody(*chain);
+            body->rootLink()->p() << 0.0, i * 1.0, 0.0501;
+            for(int j=0; j < body->numJoints(); ++j){
+                body->joint(j)->q() = (j % 2) ? 0.0 : 0.2;
+            }
+            addBody(world, body);
+        }
+    }
+
+    world.setTimeStep(0.001);
+    world.initialize();
+
+    TimeMeasure timer;
+    for(int i=0; i < numSteps; ++i){
+        cfs.clearExternalForces();
+        timer.begin();
+        world.calcNextState();
+        timer.end();
+    }
+
+    Result result;
+    result.timePerStep = timer.avarageTime();
+    result.numIterations = cfs.gaussSeidelTotalNumIterations();
+    // The force of a constraint point is output to both the links
+    int numConstraintForces = 0;
+    for(int i=0; i < world.numBodies(); ++i){
+        DyBody* body = world.body(i);
+        for(int j=0; j < body->numLinks(); ++j){
+            numConstraintForces += body->link(j)->constraintForces().size();
+        }
+        if(i > 0){
+            result.positions.push_back(body->rootLink()->p());
+        }
+    }
+    result.numConstraintPoints = numConstraintForces / 2;
+    return result;
+}
+
+}
+
+
+int main(int argc, char** argv)
+{
+    const int numSteps = (argc > 1) ? atoi(argv[1]) : 1000;
+    const char* sceneNames[] = { "box stacks", "chains" };
+
+    printf("%-12s %-14s %12s %12s %12s %14s\n",
+           "scene", "assembly", "points", "ms/step", "GS iter.", "max pos. diff");
+
+    for(int scene = BOX_STACKS; scene <= CHAINS; ++scene){
+        Result testForce = simulate(static_cast<SceneType>(scene), false, numSteps);
+        Result massMatrix = simulate(static_cast<SceneType>(scene), true, numSteps);
+        double maxDiff = 0.0;
+        for(size_t i=0; i < testForce.positions.size(); ++i){
+            maxDiff = std::max(maxDiff, (testForce.positions[i] - massMatrix.positions[i]).norm());
+        }
+        printf("%-12s %-14s %12d %12.3f %12lld %14s\n", sceneNames[scene], "test force",
+               testForce.numConstraintPoints, testForce.timePerStep * 1000.0, testForce.numIterations, "");
+        printf("%-12s %-14s %12d %12.3f %12lld %14.3g\n", sceneNames[scene], "mass matrix",
+               massMatrix.numConstraintPoints, massMatrix.timePerStep * 1000.0, massMatrix.numIterations, maxDiff);
+    }
+
+    return 0;
+}
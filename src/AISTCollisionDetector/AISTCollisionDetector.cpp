@@ -5,25 +5,63 @@
 
 #include "AISTCollisionDetector.h"
 #include "ColdetModelPair.h"
+#include "PrimitiveCollision.h"
 #include <cnoid/IdPair>
 #include <cnoid/MeshExtractor>
+#include <cnoid/ThreadPool>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/bind.hpp>
+#include <algorithm>
 
 using namespace std;
 using namespace cnoid;
 
 namespace {
 
+const double BOUNDING_BOX_MARGIN = 1.0e-4;
+
+// The pairs are divided into more chunks than threads to balance the load
+const int NUM_CHUNKS_PER_THREAD = 4;
+
+// The contact points of a sphere and a mesh closer than this are merged
+const double SPHERE_CONTACT_MERGE_DISTANCE = 1.0e-6;
+
 CollisionDetectorPtr factory()
 {
     return boost::make_shared<AISTCollisionDetector>();
 }
 
+CollisionDetectorPtr sweepAndPruneFactory()
+{
+    AISTCollisionDetectorPtr detector = boost::make_shared<AISTCollisionDetector>();
+    detector->enableBroadPhase(true);
+    return detector;
+}
+
+CollisionDetectorPtr primitiveFactory()
+{
+    AISTCollisionDetectorPtr detector = boost::make_shared<AISTCollisionDetector>();
+    detector->enablePrimitiveCollision(true);
+    return detector;
+}
+
+CollisionDetectorPtr primitiveSweepAndPruneFactory()
+{
+    AISTCollisionDetectorPtr detector = boost::make_shared<AISTCollisionDetector>();
+    detector->enablePrimitiveCollision(true);
+    detector->enableBroadPhase(true);
+    return detector;
+}
+
 struct FactoryRegistration
 {
     FactoryRegistration(){
         CollisionDetector::registerFactory("AISTCollisionDetector", factory);
+        CollisionDetector::registerFactory("AISTCollisionDetectorSAP", sweepAndPruneFactory);
+        CollisionDetector::registerFactory("AISTCollisionDetectorPrimitive", primitiveFactory);
+        CollisionDetector::registerFactory("AISTCollisionDetectorPrimitiveSAP", primitiveSweepAndPruneFactory);
     }
 } factoryRegistration;
 
@@ -31,8 +69,65 @@ struct FactoryRegistration
 class ColdetModelEx : public ColdetModel
 {
 public:
-    ColdetModelEx() { isStatic = false; }
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+        
+    ColdetModelEx() {
+        isStatic = false;
+        isPositionChanged = true;
+        T.setIdentity();
+    }
+
+    /**
+       The internal model including the AABB tree is shared with the original model,
+       but the states for the detection are not copied.
+    */
+    ColdetModelEx(const ColdetModelEx& org)
+        : ColdetModel(org),
+          primitive(org.primitive),
+          localCenter(org.localCenter),
+          localExtents(org.localExtents) {
+        isStatic = false;
+        isPositionChanged = true;
+        T.setIdentity();
+        bbmin = localCenter - localExtents;
+        bbmax = localCenter + localExtents;
+    }
+        
     bool isStatic;
+
+    // The analytic shape used when the primitive collision is enabled
+    PrimitiveShape primitive;
+
+    // The current position, which is also compared for the collision cache
+    Position T;
+    bool isPositionChanged;
+
+    // bounding box in the world coordinate
+    Vector3 bbmin;
+    Vector3 bbmax;
+    Vector3 localCenter;
+    Vector3 localExtents;
+
+    void initializeBoundingBox() {
+        vector<Vector3> rootBox;
+        getBoundingBoxData(0, rootBox);
+        if(rootBox.size() >= 2){
+            localCenter = rootBox[0];
+            localExtents = (rootBox[1].array() + BOUNDING_BOX_MARGIN).matrix();
+        } else {
+            localCenter.setZero();
+            localExtents.setConstant(BOUNDING_BOX_MARGIN);
+        }
+        bbmin = localCenter - localExtents;
+        bbmax = localCenter + localExtents;
+    }
+
+    void updateBoundingBox(const Position& T) {
+        const Vector3 c = T * localCenter;
+        const Vector3 e = T.linear().cwiseAbs() * localExtents;
+        bbmin = c - e;
+        bbmax = c + e;
+    }
 };
 typedef boost::shared_ptr<ColdetModelEx> ColdetModelExPtr;
         
@@ -48,15 +143,79 @@ public:
         {
             id1_ = id1;
             id2_ = id2;
+            collisionPair.geometryId[0] = id1;
+            collisionPair.geometryId[1] = id2;
+            hasCache = false;
         }
     const int id1() const { return id1_; }
     const int id2() const { return id2_; }
+
+    // collisions detected in the last detection
+    CollisionPair collisionPair;
+    bool hasCache;
 };
 typedef boost::shared_ptr<ColdetModelPairEx> ColdetModelPairExPtr;
 
 
-typedef map<weak_ref_ptr<SgNode>, ColdetModelExPtr>  ModelMap;
+/**
+   Used for finding a pair in the model pair array,
+   which is sorted in the lexicographical order of the geometry ids
+*/
+struct ModelPairIdLess
+{
+    bool operator()(const ColdetModelPairExPtr& pair, const IdPair<>& ids) const {
+        return (pair->id1() < ids(0)) || (pair->id1() == ids(0) && pair->id2() < ids(1));
+    }
+};
+
+
+/**
+   A mesh and its transform extracted from a geometry node.
+   A cached model is reused only when the meshes extracted from the node are
+   same as those used for building the model.
+*/
+struct MeshSignature
+{
+    SgMeshPtr mesh;
+    SgVertexArray* vertices;
+    int numVertices;
+    int numTriangles;
+    Matrix3 R;
+    Vector3 p;
+
+    bool operator==(const MeshSignature& rhs) const {
+        return (mesh == rhs.mesh && vertices == rhs.vertices &&
+                numVertices == rhs.numVertices && numTriangles == rhs.numTriangles &&
+                R == rhs.R && p == rhs.p);
+    }
+};
+
+struct ModelCacheEntry
+{
+    ColdetModelExPtr model;
+    vector<MeshSignature> meshes;
+};
+
+typedef map<weak_ref_ptr<SgNode>, ModelCacheEntry>  ModelMap;
 ModelMap modelCache;
+boost::mutex modelCacheMutex;
+
+/**
+   The entries of the released geometries are removed once when the models are made ready
+   instead of every time a geometry is added.
+*/
+void removeExpiredModelCacheEntries()
+{
+    boost::mutex::scoped_lock lock(modelCacheMutex);
+    ModelMap::iterator p = modelCache.begin();
+    while(p != modelCache.end()){
+        if(p->first.expired()){
+            modelCache.erase(p++);
+        } else {
+            ++p;
+        }
+    }
+}
 }
 
 namespace cnoid {
@@ -71,13 +230,50 @@ public:
     IdPairSet nonInterfarencePairs;
 
     MeshExtractor* meshExtractor;
+    vector<MeshSignature> meshSignatures;
+    int numExtractedMeshes;
+
+    bool isGeometryCacheEnabled;
+    bool isBroadPhaseEnabled;
+    bool isCollisionCacheEnabled;
+    bool isPrimitiveCollisionEnabled;
+    int numNarrowPhasePairs;
+    int numCachedPairs;
+    int sweepAxis;
+    vector<int> sortedModelIds;
+    vector<int> candidatePairIndices;
+
+    int numThreads;
+    boost::scoped_ptr<ThreadPool> threadPool;
+    vector<int> numNarrowPhasePairsOfChunks;
+
+    // buffer for the sphere and mesh collisions
+    vector<int> triangleIndices;
         
     AISTCollisionDetectorImpl();
     ~AISTCollisionDetectorImpl();
     int addGeometry(SgNode* geometry);
+    ColdetModelExPtr findCachedModel(SgNode* geometry);
     void addMesh(ColdetModelEx* model);
+    void addMeshSignature();
+    void setPrimitiveShape(ColdetModelEx* model);
+    void updatePosition(int geometryId, const Position& position);
     bool makeReady();
+    int updateCollisions();
     void detectCollisions(boost::function<void(const CollisionPair&)> callback);
+    int detectCollisions(std::vector<CollisionPair>& out_collisionPairs);
+    ColdetModelPairEx& targetPair(int index) {
+        return isBroadPhaseEnabled ? *modelPairs[candidatePairIndices[index]] : *modelPairs[index];
+    }
+    void updateCollisionsOfPairs(int begin, int end, int* out_numNarrowPhasePairs);
+    bool updateCollisionsOfPair(ColdetModelPairEx& modelPair);
+    bool detectPrimitiveCollisions(ColdetModelPairEx& modelPair, CollisionList& collisions);
+    void detectSphereMeshCollisions(ColdetModelEx* sphereModel, ColdetModelEx* meshModel, CollisionList& collisions);
+    void enableCollisionCache(bool on);
+    void setNumThreads(int n);
+    void sweepAndPrune();
+    void determineSweepAxis();
+    int findModelPairIndex(int id1, int id2);
 };
 }
 
@@ -91,7 +287,14 @@ AISTCollisionDetector::AISTCollisionDetector()
 AISTCollisionDetectorImpl::AISTCollisionDetectorImpl()
 {
     meshExtractor = new MeshExtractor();
-
+    isGeometryCacheEnabled = false;
+    isBroadPhaseEnabled = false;
+    isCollisionCacheEnabled = false;
+    isPrimitiveCollisionEnabled = false;
+    numNarrowPhasePairs = 0;
+    numCachedPairs = 0;
+    sweepAxis = -1;
+    numThreads = 1;
 }
 
 
@@ -110,13 +313,22 @@ AISTCollisionDetector::~AISTCollisionDetector()
 
 const char* AISTCollisionDetector::name() const
 {
-    return "AISTCollisionDetector";
+    if(impl->isPrimitiveCollisionEnabled){
+        return impl->isBroadPhaseEnabled ? "AISTCollisionDetectorPrimitiveSAP" : "AISTCollisionDetectorPrimitive";
+    }
+    return impl->isBroadPhaseEnabled ? "AISTCollisionDetectorSAP" : "AISTCollisionDetector";
 }
 
 
 CollisionDetectorPtr AISTCollisionDetector::clone() const
 {
-    return boost::make_shared<AISTCollisionDetector>();
+    AISTCollisionDetectorPtr detector = boost::make_shared<AISTCollisionDetector>();
+    detector->enableGeometryCache(impl->isGeometryCacheEnabled);
+    detector->enableBroadPhase(impl->isBroadPhaseEnabled);
+    detector->enableCollisionCache(impl->isCollisionCacheEnabled);
+    detector->enablePrimitiveCollision(impl->isPrimitiveCollisionEnabled);
+    detector->setNumThreads(impl->numThreads);
+    return detector;
 }
 
         
@@ -125,6 +337,7 @@ void AISTCollisionDetector::clearGeometries()
     impl->models.clear();
     impl->modelPairs.clear();
     impl->nonInterfarencePairs.clear();
+    impl->sortedModelIds.clear();
 }
 
 
@@ -146,13 +359,31 @@ int AISTCollisionDetectorImpl::addGeometry(SgNode* geometry)
     bool isValid = false;
 
     if(geometry){
-        ColdetModelExPtr model = boost::make_shared<ColdetModelEx>();
-        if(meshExtractor->extract(geometry, boost::bind(&AISTCollisionDetectorImpl::addMesh, this, model.get()))){
-            model->setName(geometry->name());
-            model->build();
-            if(model->isValid()){
-                models.push_back(model);
-                isValid = true;
+        ColdetModelExPtr model;
+        if(isGeometryCacheEnabled){
+            model = findCachedModel(geometry);
+        }
+        if(model){
+            models.push_back(model);
+            isValid = true;
+        } else {
+            model = boost::make_shared<ColdetModelEx>();
+            meshSignatures.clear();
+            numExtractedMeshes = 0;
+            if(meshExtractor->extract(geometry, boost::bind(&AISTCollisionDetectorImpl::addMesh, this, model.get()))){
+                model->setName(geometry->name());
+                model->build();
+                if(model->isValid()){
+                    model->initializeBoundingBox();
+                    models.push_back(model);
+                    isValid = true;
+                    if(isGeometryCacheEnabled){
+                        boost::mutex::scoped_lock lock(modelCacheMutex);
+                        ModelCacheEntry& entry = modelCache[weak_ref_ptr<SgNode>(geometry)];
+                        entry.model = boost::make_shared<ColdetModelEx>(*model);
+                        entry.meshes.swap(meshSignatures);
+                    }
+                }
             }
         }
     }
@@ -165,8 +396,56 @@ int AISTCollisionDetectorImpl::addGeometry(SgNode* geometry)
 }
 
 
+ColdetModelExPtr AISTCollisionDetectorImpl::findCachedModel(SgNode* geometry)
+{
+    ColdetModelExPtr model;
+    
+    boost::mutex::scoped_lock lock(modelCacheMutex);
+
+    ModelMap::iterator p = modelCache.find(weak_ref_ptr<SgNode>(geometry));
+    if(p != modelCache.end()){
+        ModelCacheEntry& entry = p->second;
+        meshSignatures.clear();
+        meshExtractor->extract(geometry, boost::bind(&AISTCollisionDetectorImpl::addMeshSignature, this));
+        if(meshSignatures == entry.meshes){
+            model = boost::make_shared<ColdetModelEx>(*entry.model);
+            model->setName(geometry->name());
+        } else {
+            modelCache.erase(p);
+        }
+    }
+
+    return model;
+}
+
+
+void AISTCollisionDetectorImpl::addMeshSignature()
+{
+    SgMesh* mesh = meshExtractor->currentMesh();
+    const Affine3& T = meshExtractor->currentTransform();
+    meshSignatures.push_back(MeshSignature());
+    MeshSignature& signature = meshSignatures.back();
+    signature.mesh = mesh;
+    signature.vertices = mesh->vertices();
+    signature.numVertices = mesh->vertices()->size();
+    signature.numTriangles = mesh->numTriangles();
+    signature.R = T.linear();
+    signature.p = T.translation();
+}
+
+
 void AISTCollisionDetectorImpl::addMesh(ColdetModelEx* model)
 {
+    if(isGeometryCacheEnabled){
+        addMeshSignature();
+    }
+    
+    if(++numExtractedMeshes == 1){
+        setPrimitiveShape(model);
+    } else {
+        model->primitive.type = SgMesh::MESH;
+    }
+    
     SgMesh* mesh = meshExtractor->currentMesh();
     const Affine3& T = meshExtractor->currentTransform();
     
@@ -190,6 +469,40 @@ void AISTCollisionDetectorImpl::addMesh(ColdetModelEx* model)
 }
 
 
+/**
+   The primitive of the mesh is kept as the analytic shape only when the geometry consists of
+   the single mesh which is not scaled. Otherwise the shape is treated as a general mesh.
+*/
+void AISTCollisionDetectorImpl::setPrimitiveShape(ColdetModelEx* model)
+{
+    SgMesh* mesh = meshExtractor->currentMesh();
+    PrimitiveShape& shape = model->primitive;
+    shape.type = SgMesh::MESH;
+
+    if(meshExtractor->isCurrentScaled()){
+        return;
+    }
+    switch(mesh->primitiveType()){
+    case SgMesh::BOX:
+        shape.boxSize = mesh->primitive<SgMesh::Box>().size;
+        break;
+    case SgMesh::SPHERE:
+        shape.radius = mesh->primitive<SgMesh::Sphere>().radius;
+        break;
+    case SgMesh::CYLINDER:
+        shape.radius = mesh->primitive<SgMesh::Cylinder>().radius;
+        shape.height = mesh->primitive<SgMesh::Cylinder>().height;
+        break;
+    default:
+        return;
+    }
+    shape.type = mesh->primitiveType();
+    const Affine3& T = meshExtractor->currentTransform();
+    shape.T.linear() = T.linear();
+    shape.T.translation() = T.translation();
+}
+
+
 void AISTCollisionDetector::setGeometryStatic(int geometryId, bool isStatic)
 {
     ColdetModelExPtr& model = impl->models[geometryId];
@@ -199,20 +512,28 @@ void AISTCollisionDetector::setGeometryStatic(int geometryId, bool isStatic)
 }
 
 
+/**
+   When the geometry cache is enabled, the models built from the geometry nodes are
+   stored in the cache shared by all the detector instances, and the AABB trees of the
+   models are reused when the same nodes are added again.
+*/
 bool AISTCollisionDetector::enableGeometryCache(bool on)
 {
-    return false;
+    impl->isGeometryCacheEnabled = on;
+    return true;
 }
 
 
 void AISTCollisionDetector::clearGeometryCache(SgNodePtr geometry)
 {
+    boost::mutex::scoped_lock lock(modelCacheMutex);
     modelCache.erase(weak_ref_ptr<SgNode>(geometry));
 }
 
 
 void AISTCollisionDetector::clearAllGeometryCaches()
 {
+    boost::mutex::scoped_lock lock(modelCacheMutex);
     modelCache.clear();
 }
 
@@ -231,6 +552,10 @@ bool AISTCollisionDetector::makeReady()
 
 bool AISTCollisionDetectorImpl::makeReady()
 {
+    if(isGeometryCacheEnabled){
+        removeExpiredModelCacheEntries();
+    }
+    
     modelPairs.clear();
 
     const int n = models.size();
@@ -249,57 +574,475 @@ bool AISTCollisionDetectorImpl::makeReady()
             }
         }
     }
+
+    sortedModelIds.clear();
+    for(int i=0; i < n; ++i){
+        if(models[i]){
+            sortedModelIds.push_back(i);
+        }
+    }
+    sweepAxis = -1;
+    
     return true;
 }
 
 
-void AISTCollisionDetector::updatePosition(int geometryId, const Position& position)
+inline void AISTCollisionDetectorImpl::updatePosition(int geometryId, const Position& position)
 {
-    ColdetModelExPtr& model = impl->models[geometryId];
+    ColdetModelExPtr& model = models[geometryId];
     if(model){
+        if(isCollisionCacheEnabled){
+            if(position.matrix() == model->T.matrix()){
+                return;
+            }
+            model->isPositionChanged = true;
+        }
+        model->T = position;
         model->setPosition(position);
+        model->updateBoundingBox(position);
     }
 }
 
 
+void AISTCollisionDetector::updatePosition(int geometryId, const Position& position)
+{
+    impl->updatePosition(geometryId, position);
+}
+
+
+void AISTCollisionDetector::updatePositions(int begin, int end, const Position* positions)
+{
+    for(int i=begin; i < end; ++i){
+        impl->updatePosition(i, *positions++);
+    }
+}
+
+
+void AISTCollisionDetector::enableBroadPhase(bool on)
+{
+    impl->isBroadPhaseEnabled = on;
+}
+
+
+bool AISTCollisionDetector::isBroadPhaseEnabled() const
+{
+    return impl->isBroadPhaseEnabled;
+}
+
+
+void AISTCollisionDetector::enableCollisionCache(bool on)
+{
+    impl->enableCollisionCache(on);
+}
+
+
+void AISTCollisionDetectorImpl::enableCollisionCache(bool on)
+{
+    if(on && !isCollisionCacheEnabled){
+        for(size_t i=0; i < models.size(); ++i){
+            if(models[i]){
+                models[i]->isPositionChanged = true;
+            }
+        }
+        for(size_t i=0; i < modelPairs.size(); ++i){
+            modelPairs[i]->hasCache = false;
+        }
+    }
+    isCollisionCacheEnabled = on;
+}
+
+
+bool AISTCollisionDetector::isCollisionCacheEnabled() const
+{
+    return impl->isCollisionCacheEnabled;
+}
+
+
+void AISTCollisionDetector::enablePrimitiveCollision(bool on)
+{
+    impl->isPrimitiveCollisionEnabled = on;
+}
+
+
+bool AISTCollisionDetector::isPrimitiveCollisionEnabled() const
+{
+    return impl->isPrimitiveCollisionEnabled;
+}
+
+
+void AISTCollisionDetector::setNumThreads(int n)
+{
+    impl->setNumThreads(n);
+}
+
+
+void AISTCollisionDetectorImpl::setNumThreads(int n)
+{
+    if(n < 1){
+        n = 1;
+    }
+    if(n != numThreads){
+        numThreads = n;
+        if(n == 1){
+            threadPool.reset();
+        } else {
+            threadPool.reset(new ThreadPool(n));
+        }
+    }
+}
+
+
+int AISTCollisionDetector::numThreads() const
+{
+    return impl->numThreads;
+}
+
+
+int AISTCollisionDetector::numModelPairs() const
+{
+    return impl->modelPairs.size();
+}
+
+
+int AISTCollisionDetector::numNarrowPhasePairs() const
+{
+    return impl->numNarrowPhasePairs;
+}
+
+
+int AISTCollisionDetector::numCachedPairs() const
+{
+    return impl->numCachedPairs;
+}
+
+
 void AISTCollisionDetector::detectCollisions(boost::function<void(const CollisionPair&)> callback)
 {
     impl->detectCollisions(callback);
 }
 
 
+int AISTCollisionDetector::detectCollisions(std::vector<CollisionPair>& out_collisionPairs)
+{
+    return impl->detectCollisions(out_collisionPairs);
+}
+
+
+void AISTCollisionDetectorImpl::detectCollisions(boost::function<void(const CollisionPair&)> callback)
+{
+    const int numTargetPairs = updateCollisions();
+    for(int i=0; i < numTargetPairs; ++i){
+        const CollisionPair& collisionPair = targetPair(i).collisionPair;
+        if(!collisionPair.collisions.empty()){
+            callback(collisionPair);
+        }
+    }
+}
+
+
+int AISTCollisionDetectorImpl::detectCollisions(std::vector<CollisionPair>& out_collisionPairs)
+{
+    const int numTargetPairs = updateCollisions();
+    size_t numPairs = 0;
+    for(int i=0; i < numTargetPairs; ++i){
+        const CollisionPair& collisionPair = targetPair(i).collisionPair;
+        if(!collisionPair.collisions.empty()){
+            if(numPairs < out_collisionPairs.size()){
+                // The copy assignment reuses the capacity of the existing collision list
+                out_collisionPairs[numPairs] = collisionPair;
+            } else {
+                out_collisionPairs.push_back(collisionPair);
+            }
+            ++numPairs;
+        }
+    }
+    for(size_t i=numPairs; i < out_collisionPairs.size(); ++i){
+        out_collisionPairs[i].collisions.clear();
+    }
+    return numPairs;
+}
+
+
 /**
-   \todo Remeber which geometry positions are updated after the last collision detection
-   and do the actual collision detection only for the updated geometry pairs.
+   Update the collisions stored in the target pairs.
+   \return the number of the target pairs
 */
-void AISTCollisionDetectorImpl::detectCollisions(boost::function<void(const CollisionPair&)> callback)
+int AISTCollisionDetectorImpl::updateCollisions()
 {
-    CollisionPair collisionPair;
-    vector<Collision>& collisions = collisionPair.collisions;
+    int numTargetPairs;
+    if(isBroadPhaseEnabled){
+        sweepAndPrune();
+        numTargetPairs = candidatePairIndices.size();
+    } else {
+        numTargetPairs = modelPairs.size();
+    }
+
+    numNarrowPhasePairs = 0;
+
+    if(threadPool && numTargetPairs > 1){
+        // The collisions are detected in parallel and stored in each pair
+        const int numChunks = std::min(numTargetPairs, numThreads * NUM_CHUNKS_PER_THREAD);
+        numNarrowPhasePairsOfChunks.resize(numChunks);
+        for(int i=0; i < numChunks; ++i){
+            const int begin = numTargetPairs * i / numChunks;
+            const int end = numTargetPairs * (i + 1) / numChunks;
+            threadPool->start(
+                boost::bind(&AISTCollisionDetectorImpl::updateCollisionsOfPairs,
+                            this, begin, end, &numNarrowPhasePairsOfChunks[i]));
+        }
+        threadPool->wait();
+        
+        for(int i=0; i < numChunks; ++i){
+            numNarrowPhasePairs += numNarrowPhasePairsOfChunks[i];
+        }
+    } else {
+        updateCollisionsOfPairs(0, numTargetPairs, &numNarrowPhasePairs);
+    }
+
+    numCachedPairs = numTargetPairs - numNarrowPhasePairs;
+
+    if(isCollisionCacheEnabled){
+        for(size_t i=0; i < models.size(); ++i){
+            if(models[i]){
+                models[i]->isPositionChanged = false;
+            }
+        }
+    }
+
+    return numTargetPairs;
+}
+
+
+void AISTCollisionDetectorImpl::updateCollisionsOfPairs(int begin, int end, int* out_numNarrowPhasePairs)
+{
+    int n = 0;
+    for(int i=begin; i < end; ++i){
+        if(updateCollisionsOfPair(targetPair(i))){
+            ++n;
+        }
+    }
+    *out_numNarrowPhasePairs = n;
+}
+
+
+/**
+   When the collision cache is enabled, the collisions of the pair are only detected
+   when either geometry has been moved after the last detection. Otherwise the collisions
+   detected in the last detection are kept. Note that the pair culled by the broad phase
+   in the last detection always has a moved geometry when it becomes a candidate again,
+   so its cache is never used without being updated.
+
+   \return true if the narrow phase is actually executed
+*/
+bool AISTCollisionDetectorImpl::updateCollisionsOfPair(ColdetModelPairEx& modelPair)
+{
+    if(isCollisionCacheEnabled && modelPair.hasCache){
+        ColdetModelEx* model1 = static_cast<ColdetModelEx*>(modelPair.model(0).get());
+        ColdetModelEx* model2 = static_cast<ColdetModelEx*>(modelPair.model(1).get());
+        if(!model1->isPositionChanged && !model2->isPositionChanged){
+            return false;
+        }
+    }
     
-    const int n = modelPairs.size();
-    for(int i=0; i < n; ++i){
-        ColdetModelPairEx& modelPair = *modelPairs[i];
-        const std::vector<collision_data>& cdata = modelPair.detectCollisions();
-        if(!cdata.empty()){
-            collisionPair.geometryId[0] = modelPair.id1();
-            collisionPair.geometryId[1] = modelPair.id2();
-            collisions.clear();
-            for(size_t j=0; j < cdata.size(); ++j){
-                const collision_data& cd = cdata[j];
-                for(int k=0; k < cd.num_of_i_points; ++k){
-                    if(cd.i_point_new[k]){
-                        collisions.push_back(Collision());
-                        Collision& collision = collisions.back();
-                        collision.point = cd.i_points[k];
-                        collision.normal = cd.n_vector;
-                        collision.depth = cd.depth;
-                    }
+    vector<Collision>& collisions = modelPair.collisionPair.collisions;
+    collisions.clear();
+
+    if(isPrimitiveCollisionEnabled && detectPrimitiveCollisions(modelPair, collisions)){
+        modelPair.hasCache = true;
+        return true;
+    }
+    
+    const std::vector<collision_data>& cdata = modelPair.detectCollisions();
+    for(size_t j=0; j < cdata.size(); ++j){
+        const collision_data& cd = cdata[j];
+        for(int k=0; k < cd.num_of_i_points; ++k){
+            if(cd.i_point_new[k]){
+                collisions.push_back(Collision());
+                Collision& collision = collisions.back();
+                collision.point = cd.i_points[k];
+                collision.normal = cd.n_vector;
+                collision.depth = cd.depth;
+            }
+        }
+    }
+    modelPair.hasCache = true;
+    
+    return true;
+}
+
+
+/**
+   \return false if the collisions of the pair must be detected with the meshes
+*/
+bool AISTCollisionDetectorImpl::detectPrimitiveCollisions(ColdetModelPairEx& modelPair, CollisionList& collisions)
+{
+    ColdetModelEx* model1 = static_cast<ColdetModelEx*>(modelPair.model(0).get());
+    ColdetModelEx* model2 = static_cast<ColdetModelEx*>(modelPair.model(1).get());
+    const PrimitiveShape& shape1 = model1->primitive;
+    const PrimitiveShape& shape2 = model2->primitive;
+
+    if(shape1.type != SgMesh::MESH && shape2.type != SgMesh::MESH){
+        if(cnoid::detectPrimitiveCollisions(
+               shape1, model1->T * shape1.T, shape2, model2->T * shape2.T, collisions)){
+            return true;
+        }
+        collisions.clear();
+    }
+    if(shape1.type == SgMesh::SPHERE){
+        detectSphereMeshCollisions(model1, model2, collisions);
+        // The normals must point from the first model to the second model
+        for(size_t i=0; i < collisions.size(); ++i){
+            collisions[i].normal = -collisions[i].normal;
+        }
+        return true;
+    }
+    if(shape2.type == SgMesh::SPHERE){
+        detectSphereMeshCollisions(model2, model1, collisions);
+        return true;
+    }
+    return false;
+}
+
+
+/**
+   The normals of the detected collisions point from the mesh to the sphere.
+*/
+void AISTCollisionDetectorImpl::detectSphereMeshCollisions
+(ColdetModelEx* sphereModel, ColdetModelEx* meshModel, CollisionList& collisions)
+{
+    const Vector3 center = sphereModel->T * sphereModel->primitive.T.translation();
+    const double radius = sphereModel->primitive.radius;
+
+    // This function is called by multiple threads when the number of threads is more than one
+    vector<int> localTriangleIndices;
+    vector<int>& triangles = threadPool ? localTriangleIndices : triangleIndices;
+    meshModel->getTrianglesInSphere(center, radius, triangles);
+
+    const Position& T = meshModel->T;
+    Collision collision;
+    for(size_t i=0; i < triangles.size(); ++i){
+        int indices[3];
+        meshModel->getTriangle(triangles[i], indices[0], indices[1], indices[2]);
+        Vector3 v[3];
+        for(int j=0; j < 3; ++j){
+            float x, y, z;
+            meshModel->getVertex(indices[j], x, y, z);
+            v[j] = T * Vector3(x, y, z);
+        }
+        if(detectSphereTriangleCollision(center, radius, v[0], v[1], v[2], collision)){
+            // The triangles sharing the closest edge or vertex give the same contact
+            bool isNew = true;
+            for(size_t j=0; j < collisions.size(); ++j){
+                if((collisions[j].point - collision.point).norm() < SPHERE_CONTACT_MERGE_DISTANCE){
+                    isNew = false;
+                    break;
                 }
             }
-            if(!collisions.empty()){
-                callback(collisionPair);
+            if(isNew){
+                collisions.push_back(collision);
+            }
+        }
+    }
+}
+
+
+/**
+   The axis with the largest variance of the box centers is used as the sweep axis
+   so that the number of the overlapping intervals on the axis is minimized.
+*/
+void AISTCollisionDetectorImpl::determineSweepAxis()
+{
+    const int n = sortedModelIds.size();
+    Vector3 sum = Vector3::Zero();
+    Vector3 sum2 = Vector3::Zero();
+    for(int i=0; i < n; ++i){
+        ColdetModelEx* model = models[sortedModelIds[i]].get();
+        const Vector3 c = (model->bbmin + model->bbmax) / 2.0;
+        sum += c;
+        sum2 += c.cwiseProduct(c);
+    }
+    Vector3 variance = sum2 * n - sum.cwiseProduct(sum);
+    variance.maxCoeff(&sweepAxis);
+}
+
+
+namespace {
+
+struct BoundingBoxMinLess
+{
+    const vector<ColdetModelExPtr>& models;
+    const int axis;
+    BoundingBoxMinLess(const vector<ColdetModelExPtr>& models, int axis) : models(models), axis(axis) { }
+    bool operator()(int id1, int id2) const {
+        return models[id1]->bbmin[axis] < models[id2]->bbmin[axis];
+    }
+};
+}
+
+
+/**
+   Extract the model pairs whose bounding boxes overlap each other.
+   The indices of the extracted pairs are stored in candidatePairIndices
+   in the same order as modelPairs so that the order of the detected collisions
+   does not depend on the broad phase.
+*/
+void AISTCollisionDetectorImpl::sweepAndPrune()
+{
+    const int n = sortedModelIds.size();
+
+    if(sweepAxis < 0){
+        determineSweepAxis();
+        std::sort(sortedModelIds.begin(), sortedModelIds.end(), BoundingBoxMinLess(models, sweepAxis));
+    } else {
+        // The insertion sort is efficient for the order which is almost kept between frames
+        for(int i=1; i < n; ++i){
+            const int id = sortedModelIds[i];
+            const double key = models[id]->bbmin[sweepAxis];
+            int j = i - 1;
+            while(j >= 0 && models[sortedModelIds[j]]->bbmin[sweepAxis] > key){
+                sortedModelIds[j+1] = sortedModelIds[j];
+                --j;
+            }
+            sortedModelIds[j+1] = id;
+        }
+    }
+
+    const int axis1 = (sweepAxis + 1) % 3;
+    const int axis2 = (sweepAxis + 2) % 3;
+    
+    candidatePairIndices.clear();
+    
+    for(int i=0; i < n; ++i){
+        const int id1 = sortedModelIds[i];
+        const ColdetModelEx* model1 = models[id1].get();
+        const double max1 = model1->bbmax[sweepAxis];
+        for(int j = i+1; j < n; ++j){
+            const int id2 = sortedModelIds[j];
+            const ColdetModelEx* model2 = models[id2].get();
+            if(model2->bbmin[sweepAxis] > max1){
+                break;
+            }
+            if(model1->bbmin[axis1] <= model2->bbmax[axis1] && model2->bbmin[axis1] <= model1->bbmax[axis1] &&
+               model1->bbmin[axis2] <= model2->bbmax[axis2] && model2->bbmin[axis2] <= model1->bbmax[axis2]){
+                const int pairIndex = findModelPairIndex(id1, id2);
+                if(pairIndex >= 0){
+                    candidatePairIndices.push_back(pairIndex);
+                }
             }
         }
     }
+
+    std::sort(candidatePairIndices.begin(), candidatePairIndices.end());
+}
+
+
+int AISTCollisionDetectorImpl::findModelPairIndex(int id1, int id2)
+{
+    const IdPair<> ids(id1, id2);
+    vector<ColdetModelPairExPtr>::iterator p =
+        std::lower_bound(modelPairs.begin(), modelPairs.end(), ids, ModelPairIdLess());
+    if(p != modelPairs.end() && (*p)->id1() == ids(0) && (*p)->id2() == ids(1)){
+        return p - modelPairs.begin();
+    }
+    return -1;
 }
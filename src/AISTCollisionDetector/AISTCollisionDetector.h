@@ -30,7 +30,51 @@ public:
     virtual void setNonInterfarenceGeometyrPair(int geometryId1, int geometryId2);
     virtual bool makeReady();
     virtual void updatePosition(int geometryId, const Position& position);
+    virtual void updatePositions(int begin, int end, const Position* positions);
     virtual void detectCollisions(boost::function<void(const CollisionPair&)> callback);
+    virtual int detectCollisions(std::vector<CollisionPair>& out_collisionPairs);
+
+    /**
+       When the number of threads is more than one, the narrow phase of the pairs
+       is executed in parallel by the thread pool.
+    */
+    virtual void setNumThreads(int n);
+    int numThreads() const;
+
+    /**
+       When the broad phase is enabled, the pairs whose bounding boxes in the world
+       coordinate do not overlap are culled by the sweep and prune method before
+       the narrow phase. The detected collision pairs are same as those without it.
+    */
+    void enableBroadPhase(bool on);
+    bool isBroadPhaseEnabled() const;
+
+    /**
+       When the collision cache is enabled, the geometries whose positions are actually
+       changed by updatePosition() are remembered, and the pairs where neither geometry
+       has been moved since the last detection are not tested again. The collisions
+       detected for such a pair in the last detection are output instead.
+    */
+    void enableCollisionCache(bool on);
+    bool isCollisionCacheEnabled() const;
+
+    /**
+       When the primitive collision is enabled, the geometries consisting of a box, sphere or
+       cylinder primitive of SgMesh are kept as the analytic shapes, and the contacts between
+       them and those between a sphere and a mesh are computed in the closed forms, which are
+       faster and give the exact normals and depths. The other pairs are detected with the meshes.
+    */
+    void enablePrimitiveCollision(bool on);
+    bool isPrimitiveCollisionEnabled() const;
+
+    /**
+       The following functions return the statistics of the last detection.
+       The pairs which are neither tested in the narrow phase nor output from the cache
+       are the ones culled by the broad phase.
+    */
+    int numModelPairs() const;
+    int numNarrowPhasePairs() const;
+    int numCachedPairs() const;
 
 private:
     AISTCollisionDetectorImpl* impl;
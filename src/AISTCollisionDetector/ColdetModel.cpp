@@ -396,6 +396,26 @@ bool ColdetModel::checkCollisionWithPointCloud(const std::vector<Vector3> &i_clo
 }
 
 
+void ColdetModel::getTrianglesInSphere(const Vector3& center, double radius, std::vector<int>& out_triangles)
+{
+    out_triangles.clear();
+    Opcode::SphereCollider SC;
+    SC.SetFirstContact(false);
+    Opcode::SphereCache Cache;
+    IceMaths::Sphere sphere(IceMaths::Point(center[0], center[1], center[2]), radius);
+    if(!SC.Collide(Cache, sphere, internalModel->model, 0, transform)){
+        std::cerr << "SphereCollider::Collide() failed" << std::endl;
+        return;
+    }
+    const int n = SC.GetNbTouchedPrimitives();
+    const udword* triangles = SC.GetTouchedPrimitives();
+    out_triangles.reserve(n);
+    for(int i=0; i < n; ++i){
+        out_triangles.push_back(triangles[i]);
+    }
+}
+
+
 namespace {
 
 inline void extractNeighborTriangle
@@ -207,6 +207,14 @@ public:
     bool checkCollisionWithPointCloud(const std::vector<Vector3> &i_cloud,
                                       double i_radius);
 
+    /**
+     * @brief get the triangles which intersect with a sphere
+     * @param center center of the sphere in the world coordinate
+     * @param radius radius of the sphere
+     * @param out_triangles indices of the triangles
+     */
+    void getTrianglesInSphere(const Vector3& center, double radius, std::vector<int>& out_triangles);
+
     void getBoundingBoxData(const int depth, std::vector<Vector3>& out_boxes);
         
     int getAABBTreeDepth();
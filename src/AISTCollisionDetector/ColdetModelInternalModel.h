@@ -7,6 +7,7 @@
 
 #include "ColdetModel.h"
 #include "Opcode/Opcode.h"
+#include <cnoid/Referenced>
 #include <vector>
 
 namespace cnoid {
@@ -60,7 +61,12 @@ public:
     };
 
 private:
+    // The internal model is shared by the models in the geometry cache, which are used in multiple threads
+#ifdef CNOID_REFERENCED_USE_ATOMIC_COUNTER
+    boost::atomic<int> refCounter;
+#else
     int refCounter;
+#endif
     int AABBTreeMaxDepth;
     std::vector<int> numBBMap;
     std::vector<int> numLeafMap;
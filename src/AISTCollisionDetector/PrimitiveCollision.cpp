@@ -0,0 +1,589 @@
+/**
+   \file
+   \author Shin'ichiro Nakaoka
+*/
+
+#include "PrimitiveCollision.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const double EPSILON = 1.0e-12;
+
+// The tolerance for checking whether a contact point is within the reference face
+const double FACE_MARGIN = 1.0e-6;
+
+
+inline void addCollision(CollisionList& collisions, const Vector3& point, const Vector3& normal, double depth)
+{
+    collisions.push_back(Collision());
+    Collision& collision = collisions.back();
+    collision.point = point;
+    collision.normal = normal;
+    collision.depth = depth;
+}
+
+
+/**
+   Add the collision between a point on the surface of a shape and a sphere.
+   @param surfacePoint the point on the surface which is closest to the center of the sphere
+   @param normal the direction from the shape to the sphere
+   @param depth the penetration depth
+   The contact point is the middle point between the surface point and the deepest point of the sphere.
+*/
+inline void addSphereCollision
+(CollisionList& collisions, const Vector3& center, double radius, const Vector3& surfacePoint, const Vector3& normal, double depth)
+{
+    addCollision(collisions, (surfacePoint + center - normal * radius) / 2.0, normal, depth);
+}
+
+
+void collideSphereSphere
+(const Vector3& center1, double radius1, const Vector3& center2, double radius2, CollisionList& collisions)
+{
+    const Vector3 d = center2 - center1;
+    const double distance = d.norm();
+    const double depth = radius1 + radius2 - distance;
+    if(depth >= 0.0){
+        const Vector3 n = (distance > EPSILON) ? Vector3(d / distance) : Vector3::UnitZ();
+        addCollision(collisions, center1 + n * (radius1 - depth / 2.0), n, depth);
+    }
+}
+
+
+/**
+   The normal points from the box to the sphere.
+*/
+void collideBoxSphere
+(const Position& T, const Vector3& halfSize, const Vector3& center, double radius, CollisionList& collisions)
+{
+    const Matrix3 R = T.linear();
+    const Vector3 p = R.transpose() * (center - T.translation());
+    const Vector3 q = p.cwiseMax(-halfSize).cwiseMin(halfSize);
+
+    if(q != p){
+        const Vector3 d = p - q;
+        const double distance = d.norm();
+        if(distance <= radius){
+            const Vector3 n = R * (d / distance);
+            addSphereCollision(collisions, center, radius, T * q, n, radius - distance);
+        }
+    } else {
+        // The center is inside the box, and the nearest face is used
+        int axis = 0;
+        double minDistance = halfSize[0] - fabs(p[0]);
+        for(int i=1; i < 3; ++i){
+            const double distance = halfSize[i] - fabs(p[i]);
+            if(distance < minDistance){
+                minDistance = distance;
+                axis = i;
+            }
+        }
+        const double s = (p[axis] >= 0.0) ? 1.0 : -1.0;
+        Vector3 surfacePoint = p;
+        surfacePoint[axis] = s * halfSize[axis];
+        const Vector3 n = R.col(axis) * s;
+        addSphereCollision(collisions, center, radius, T * surfacePoint, n, radius + minDistance);
+    }
+}
+
+
+/**
+   The normal points from the cylinder to the sphere.
+*/
+void collideCylinderSphere
+(const Position& T, double cylinderRadius, double halfHeight, const Vector3& center, double radius, CollisionList& collisions)
+{
+    const Matrix3 R = T.linear();
+    const Vector3 p = R.transpose() * (center - T.translation());
+    const Vector3 radial(p.x(), 0.0, p.z());
+    const double rho = radial.norm();
+
+    Vector3 q;
+    Vector3 nl;
+    double depth;
+
+    if(rho <= cylinderRadius && fabs(p.y()) <= halfHeight){
+        // The center is inside the cylinder
+        const double sideDistance = cylinderRadius - rho;
+        const double capDistance = halfHeight - fabs(p.y());
+        if(sideDistance < capDistance){
+            nl = (rho > EPSILON) ? Vector3(radial / rho) : Vector3::UnitX();
+            q = p + nl * sideDistance;
+            depth = radius + sideDistance;
+        } else {
+            nl << 0.0, ((p.y() >= 0.0) ? 1.0 : -1.0), 0.0;
+            q = p;
+            q.y() = nl.y() * halfHeight;
+            depth = radius + capDistance;
+        }
+    } else {
+        q = (rho > cylinderRadius) ? Vector3(radial * (cylinderRadius / rho)) : radial;
+        q.y() = std::max(-halfHeight, std::min(p.y(), halfHeight));
+        const Vector3 d = p - q;
+        const double distance = d.norm();
+        if(distance > radius){
+            return;
+        }
+        nl = d / distance;
+        depth = radius - distance;
+    }
+
+    addSphereCollision(collisions, center, radius, T * q, R * nl, depth);
+}
+
+
+inline double boxProjectionRadius(const Matrix3& R, const Vector3& halfSize, const Vector3& axis)
+{
+    return (halfSize.array() * (R.transpose() * axis).array().abs()).sum();
+}
+
+
+inline double cylinderProjectionRadius(const Vector3& cylinderAxis, double radius, double halfHeight, const Vector3& axis)
+{
+    const double c = fabs(cylinderAxis.dot(axis));
+    return halfHeight * c + radius * sqrt(std::max(0.0, 1.0 - c * c));
+}
+
+
+/**
+   Clip the polygon by the half space where dir.dot(p) <= offset.
+*/
+void clipPolygon(const vector<Vector3>& polygon, const Vector3& dir, double offset, vector<Vector3>& out_polygon)
+{
+    out_polygon.clear();
+    const int n = polygon.size();
+    for(int i=0; i < n; ++i){
+        const Vector3& p = polygon[i];
+        const Vector3& q = polygon[(i + 1) % n];
+        const double dp = dir.dot(p) - offset;
+        const double dq = dir.dot(q) - offset;
+        if(dp <= 0.0){
+            out_polygon.push_back(p);
+        }
+        if((dp < 0.0 && dq > 0.0) || (dp > 0.0 && dq < 0.0)){
+            out_polygon.push_back(p + (q - p) * (dp / (dp - dq)));
+        }
+    }
+}
+
+
+/**
+   The face of a box which is used as the reference of the contact points
+*/
+struct ReferenceFace
+{
+    Vector3 normal; // outward
+    Vector3 center;
+    Vector3 u;
+    Vector3 v;
+    double halfWidthU;
+    double halfWidthV;
+
+    ReferenceFace(const Position& T, const Vector3& halfSize, int axis, const Vector3& direction) {
+        const Matrix3 R = T.linear();
+        const int iu = (axis + 1) % 3;
+        const int iv = (axis + 2) % 3;
+        normal = R.col(axis);
+        if(normal.dot(direction) < 0.0){
+            normal = -normal;
+        }
+        center = T.translation() + normal * halfSize[axis];
+        u = R.col(iu);
+        v = R.col(iv);
+        halfWidthU = halfSize[iu];
+        halfWidthV = halfSize[iv];
+    }
+
+    double depth(const Vector3& p) const {
+        return normal.dot(center - p);
+    }
+
+    bool contains(const Vector3& p) const {
+        const Vector3 d = p - center;
+        return (fabs(u.dot(d)) <= halfWidthU + FACE_MARGIN) && (fabs(v.dot(d)) <= halfWidthV + FACE_MARGIN);
+    }
+};
+
+
+/**
+   The contact points are the points of the incident face clipped by the sides of the reference face.
+   The normal points from the reference box to the incident box.
+*/
+void addBoxFaceContacts
+(const ReferenceFace& face, const Position& T, const Vector3& halfSize, CollisionList& collisions)
+{
+    const Matrix3 R = T.linear();
+    const Vector3 c = R.transpose() * face.normal;
+    int axis;
+    c.cwiseAbs().maxCoeff(&axis);
+    const double s = (c[axis] > 0.0) ? -1.0 : 1.0;
+    const Vector3 faceCenter = T.translation() + R.col(axis) * (s * halfSize[axis]);
+    const Vector3 a = R.col((axis + 1) % 3) * halfSize[(axis + 1) % 3];
+    const Vector3 b = R.col((axis + 2) % 3) * halfSize[(axis + 2) % 3];
+
+    vector<Vector3> polygon(4);
+    polygon[0] = faceCenter + a + b;
+    polygon[1] = faceCenter - a + b;
+    polygon[2] = faceCenter - a - b;
+    polygon[3] = faceCenter + a - b;
+
+    vector<Vector3> clipped;
+    clipPolygon(polygon, face.u, face.u.dot(face.center) + face.halfWidthU, clipped);
+    clipPolygon(clipped, -face.u, -face.u.dot(face.center) + face.halfWidthU, polygon);
+    clipPolygon(polygon, face.v, face.v.dot(face.center) + face.halfWidthV, clipped);
+    clipPolygon(clipped, -face.v, -face.v.dot(face.center) + face.halfWidthV, polygon);
+
+    for(size_t i=0; i < polygon.size(); ++i){
+        const Vector3& p = polygon[i];
+        const double depth = face.depth(p);
+        if(depth > 0.0){
+            addCollision(collisions, p + face.normal * (depth / 2.0), face.normal, depth);
+        }
+    }
+}
+
+
+/**
+   The contact point between the edges of the boxes which are the most deeply penetrating along the axis.
+   The normal is the axis, which points from the first box to the second box.
+*/
+void addBoxEdgeContact
+(const Position& T1, const Vector3& halfSize1, int edge1, const Position& T2, const Vector3& halfSize2, int edge2,
+ const Vector3& axis, double depth, CollisionList& collisions)
+{
+    const Matrix3 R1 = T1.linear();
+    const Matrix3 R2 = T2.linear();
+    
+    Vector3 p1 = T1.translation();
+    Vector3 p2 = T2.translation();
+    for(int i=0; i < 3; ++i){
+        if(i != edge1){
+            p1 += R1.col(i) * ((axis.dot(R1.col(i)) > 0.0) ? halfSize1[i] : -halfSize1[i]);
+        }
+        if(i != edge2){
+            p2 += R2.col(i) * ((axis.dot(R2.col(i)) > 0.0) ? -halfSize2[i] : halfSize2[i]);
+        }
+    }
+
+    // The closest points of the edges
+    const Vector3 u1 = R1.col(edge1);
+    const Vector3 u2 = R2.col(edge2);
+    const Vector3 r = p1 - p2;
+    const double b = u1.dot(u2);
+    const double f = u2.dot(r);
+    double s = (b * f - u1.dot(r)) / (1.0 - b * b);
+    s = std::max(-halfSize1[edge1], std::min(s, halfSize1[edge1]));
+    double t = f + s * b;
+    t = std::max(-halfSize2[edge2], std::min(t, halfSize2[edge2]));
+
+    addCollision(collisions, ((p1 + u1 * s) + (p2 + u2 * t)) / 2.0, axis, depth);
+}
+
+
+/**
+   The separating axis test is done for the 15 axes. When the boxes overlap, the face
+   which has the minimum penetration among the faces of both boxes is used as the reference.
+   If the penetration along one of the axes given by the edge pairs is clearly smaller,
+   a contact between the edges is detected instead.
+   @return false if no contact point is found although the boxes overlap
+*/
+bool collideBoxBox
+(const Position& T1, const Vector3& halfSize1, const Position& T2, const Vector3& halfSize2, CollisionList& collisions)
+{
+    const Matrix3 R1 = T1.linear();
+    const Matrix3 R2 = T2.linear();
+    const Vector3 d = T2.translation() - T1.translation();
+
+    double minOverlap = std::numeric_limits<double>::max();
+    int referenceBox = 0;
+    int referenceAxis = 0;
+
+    for(int i=0; i < 3; ++i){
+        const Vector3 axis = R1.col(i);
+        const double overlap = halfSize1[i] + boxProjectionRadius(R2, halfSize2, axis) - fabs(axis.dot(d));
+        if(overlap < 0.0){
+            return true;
+        }
+        if(overlap < minOverlap){
+            minOverlap = overlap;
+            referenceBox = 0;
+            referenceAxis = i;
+        }
+    }
+    for(int i=0; i < 3; ++i){
+        const Vector3 axis = R2.col(i);
+        const double overlap = boxProjectionRadius(R1, halfSize1, axis) + halfSize2[i] - fabs(axis.dot(d));
+        if(overlap < 0.0){
+            return true;
+        }
+        if(overlap < minOverlap){
+            minOverlap = overlap;
+            referenceBox = 1;
+            referenceAxis = i;
+        }
+    }
+    double minEdgeOverlap = std::numeric_limits<double>::max();
+    int edge1 = 0;
+    int edge2 = 0;
+    Vector3 edgeAxis = Vector3::Zero();
+    
+    for(int i=0; i < 3; ++i){
+        for(int j=0; j < 3; ++j){
+            Vector3 axis = R1.col(i).cross(R2.col(j));
+            const double norm = axis.norm();
+            if(norm > 1.0e-6){
+                axis /= norm;
+                const double overlap =
+                    boxProjectionRadius(R1, halfSize1, axis) + boxProjectionRadius(R2, halfSize2, axis) - fabs(axis.dot(d));
+                if(overlap < 0.0){
+                    return true;
+                }
+                if(overlap < minEdgeOverlap){
+                    minEdgeOverlap = overlap;
+                    edge1 = i;
+                    edge2 = j;
+                    edgeAxis = (axis.dot(d) < 0.0) ? Vector3(-axis) : axis;
+                }
+            }
+        }
+    }
+
+    const size_t numCollisions = collisions.size();
+
+    // The faces are preferred for the stability of the resting contacts when the overlaps are close
+    if(minEdgeOverlap * 1.05 < minOverlap){
+        addBoxEdgeContact(T1, halfSize1, edge1, T2, halfSize2, edge2, edgeAxis, minEdgeOverlap, collisions);
+
+    } else if(referenceBox == 0){
+        addBoxFaceContacts(ReferenceFace(T1, halfSize1, referenceAxis, d), T2, halfSize2, collisions);
+    } else {
+        addBoxFaceContacts(ReferenceFace(T2, halfSize2, referenceAxis, -d), T1, halfSize1, collisions);
+        for(size_t i=numCollisions; i < collisions.size(); ++i){
+            collisions[i].normal = -collisions[i].normal;
+        }
+    }
+
+    return (collisions.size() > numCollisions);
+}
+
+
+/**
+   The contacts are detected between the reference face of the box and the rims of the
+   cylinder caps, or between the reference cap of the cylinder and the incident face of the box.
+   The normal points from the box to the cylinder.
+   @return false if no contact point is found although the shapes may overlap
+*/
+bool collideBoxCylinder
+(const Position& T1, const Vector3& halfSize, const Position& T2, double radius, double halfHeight, CollisionList& collisions)
+{
+    const Matrix3 R1 = T1.linear();
+    const Vector3 a = T2.linear().col(1);
+    const Vector3 c = T2.translation();
+    const Vector3 d = c - T1.translation();
+
+    double minOverlap = std::numeric_limits<double>::max();
+    int referenceAxis = 0;
+
+    for(int i=0; i < 3; ++i){
+        const Vector3 axis = R1.col(i);
+        const double overlap = halfSize[i] + cylinderProjectionRadius(a, radius, halfHeight, axis) - fabs(axis.dot(d));
+        if(overlap < 0.0){
+            return true;
+        }
+        if(overlap < minOverlap){
+            minOverlap = overlap;
+            referenceAxis = i;
+        }
+    }
+    const double capOverlap = boxProjectionRadius(R1, halfSize, a) + halfHeight - fabs(a.dot(d));
+    if(capOverlap < 0.0){
+        return true;
+    }
+    for(int i=0; i < 3; ++i){
+        Vector3 axis = a.cross(R1.col(i));
+        const double norm = axis.norm();
+        if(norm > 1.0e-6){
+            axis /= norm;
+            const double overlap =
+                boxProjectionRadius(R1, halfSize, axis) + cylinderProjectionRadius(a, radius, halfHeight, axis) - fabs(axis.dot(d));
+            if(overlap < 0.0){
+                return true;
+            }
+        }
+    }
+
+    const size_t numCollisions = collisions.size();
+
+    if(capOverlap < minOverlap){
+        // The vertices of the incident face of the box within the reference cap
+        const Vector3 n = (a.dot(d) < 0.0) ? a : Vector3(-a);
+        const Vector3 capCenter = c + n * halfHeight;
+        const Vector3 cl = R1.transpose() * n;
+        int axis;
+        cl.cwiseAbs().maxCoeff(&axis);
+        const double s = (cl[axis] > 0.0) ? -1.0 : 1.0;
+        const Vector3 faceCenter = T1.translation() + R1.col(axis) * (s * halfSize[axis]);
+        const Vector3 u = R1.col((axis + 1) % 3) * halfSize[(axis + 1) % 3];
+        const Vector3 v = R1.col((axis + 2) % 3) * halfSize[(axis + 2) % 3];
+        for(int i=0; i < 4; ++i){
+            const Vector3 p = faceCenter + u * ((i & 1) ? -1.0 : 1.0) + v * ((i & 2) ? -1.0 : 1.0);
+            const Vector3 r = p - capCenter;
+            const double depth = n.dot(-r);
+            if(depth > 0.0 && (r - n * n.dot(r)).norm() <= radius + FACE_MARGIN){
+                addCollision(collisions, p + n * (depth / 2.0), -n, depth);
+            }
+        }
+    } else {
+        // The rim points of the cylinder caps within the reference face of the box
+        const ReferenceFace face(T1, halfSize, referenceAxis, d);
+        Vector3 w = -face.normal - a * a.dot(-face.normal);
+        const double norm = w.norm();
+        if(norm > 1.0e-6){
+            w /= norm;
+        } else {
+            // The cap faces the reference face
+            w = a.unitOrthogonal();
+        }
+        const Vector3 w2 = a.cross(w);
+        for(int i=0; i < 2; ++i){
+            const Vector3 capCenter = c + a * ((i == 0) ? halfHeight : -halfHeight);
+            for(int j=0; j < 4; ++j){
+                const Vector3 p = capCenter + radius * ((j < 2) ? w : w2) * ((j % 2) ? -1.0 : 1.0);
+                const double depth = face.depth(p);
+                if(depth > 0.0 && face.contains(p)){
+                    addCollision(collisions, p + face.normal * (depth / 2.0), face.normal, depth);
+                }
+            }
+        }
+    }
+
+    return (collisions.size() > numCollisions);
+}
+
+
+inline void flipNormals(CollisionList& collisions, size_t begin)
+{
+    for(size_t i=begin; i < collisions.size(); ++i){
+        collisions[i].normal = -collisions[i].normal;
+    }
+}
+
+
+/**
+   Ericson, Real-Time Collision Detection, 5.1.5
+*/
+Vector3 closestPointOnTriangle(const Vector3& p, const Vector3& a, const Vector3& b, const Vector3& c)
+{
+    const Vector3 ab = b - a;
+    const Vector3 ac = c - a;
+    const Vector3 ap = p - a;
+    const double d1 = ab.dot(ap);
+    const double d2 = ac.dot(ap);
+    if(d1 <= 0.0 && d2 <= 0.0){
+        return a;
+    }
+    const Vector3 bp = p - b;
+    const double d3 = ab.dot(bp);
+    const double d4 = ac.dot(bp);
+    if(d3 >= 0.0 && d4 <= d3){
+        return b;
+    }
+    const double vc = d1 * d4 - d3 * d2;
+    if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0){
+        return a + ab * (d1 / (d1 - d3));
+    }
+    const Vector3 cp = p - c;
+    const double d5 = ab.dot(cp);
+    const double d6 = ac.dot(cp);
+    if(d6 >= 0.0 && d5 <= d6){
+        return c;
+    }
+    const double vb = d5 * d2 - d1 * d6;
+    if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0){
+        return a + ac * (d2 / (d2 - d6));
+    }
+    const double va = d3 * d6 - d5 * d4;
+    if(va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0){
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    const double denom = 1.0 / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+}
+
+
+bool cnoid::detectPrimitiveCollisions
+(const PrimitiveShape& shape1, const Position& T1, const PrimitiveShape& shape2, const Position& T2,
+ CollisionList& out_collisions)
+{
+    const int type1 = shape1.type;
+    const int type2 = shape2.type;
+    const size_t numCollisions = out_collisions.size();
+
+    if(type1 == SgMesh::SPHERE){
+        if(type2 == SgMesh::SPHERE){
+            collideSphereSphere(T1.translation(), shape1.radius, T2.translation(), shape2.radius, out_collisions);
+            return true;
+        } else if(type2 == SgMesh::BOX){
+            collideBoxSphere(T2, shape2.boxSize / 2.0, T1.translation(), shape1.radius, out_collisions);
+            flipNormals(out_collisions, numCollisions);
+            return true;
+        } else if(type2 == SgMesh::CYLINDER){
+            collideCylinderSphere(T2, shape2.radius, shape2.height / 2.0, T1.translation(), shape1.radius, out_collisions);
+            flipNormals(out_collisions, numCollisions);
+            return true;
+        }
+    } else if(type1 == SgMesh::BOX){
+        if(type2 == SgMesh::SPHERE){
+            collideBoxSphere(T1, shape1.boxSize / 2.0, T2.translation(), shape2.radius, out_collisions);
+            return true;
+        } else if(type2 == SgMesh::BOX){
+            return collideBoxBox(T1, shape1.boxSize / 2.0, T2, shape2.boxSize / 2.0, out_collisions);
+        } else if(type2 == SgMesh::CYLINDER){
+            return collideBoxCylinder(T1, shape1.boxSize / 2.0, T2, shape2.radius, shape2.height / 2.0, out_collisions);
+        }
+    } else if(type1 == SgMesh::CYLINDER){
+        if(type2 == SgMesh::SPHERE){
+            collideCylinderSphere(T1, shape1.radius, shape1.height / 2.0, T2.translation(), shape2.radius, out_collisions);
+            return true;
+        } else if(type2 == SgMesh::BOX){
+            if(collideBoxCylinder(T2, shape2.boxSize / 2.0, T1, shape1.radius, shape1.height / 2.0, out_collisions)){
+                flipNormals(out_collisions, numCollisions);
+                return true;
+            }
+            return false;
+        }
+    }
+
+    return false;
+}
+
+
+bool cnoid::detectSphereTriangleCollision
+(const Vector3& center, double radius, const Vector3& v0, const Vector3& v1, const Vector3& v2, Collision& out_collision)
+{
+    const Vector3 q = closestPointOnTriangle(center, v0, v1, v2);
+    const Vector3 d = center - q;
+    const double distance = d.norm();
+    if(distance > radius){
+        return false;
+    }
+    Vector3 n;
+    if(distance > EPSILON){
+        n = d / distance;
+    } else {
+        n = (v1 - v0).cross(v2 - v0).normalized();
+    }
+    const double depth = radius - distance;
+    out_collision.point = (q + center - n * radius) / 2.0;
+    out_collision.normal = n;
+    out_collision.depth = depth;
+    return true;
+}
@@ -0,0 +1,59 @@
+/**
+   \file
+   \author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_AIST_COLLISION_DETECTOR_PRIMITIVE_COLLISION_H_INCLUDED
+#define CNOID_AIST_COLLISION_DETECTOR_PRIMITIVE_COLLISION_H_INCLUDED
+
+#include <cnoid/CollisionDetector>
+#include <cnoid/SceneShape>
+
+namespace cnoid {
+
+/**
+   The analytic shape of a geometry built from a primitive of SgMesh.
+   The box is centered at the origin and the cylinder has its axis on the Y axis
+   as the meshes generated by MeshGenerator.
+*/
+struct PrimitiveShape
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+    PrimitiveShape() : type(SgMesh::MESH), radius(0.0), height(0.0) {
+        boxSize.setZero();
+        T.setIdentity();
+    }
+
+    // SgMesh::MESH if the geometry is not a primitive
+    int type;
+    Vector3 boxSize;
+    double radius;
+    double height;
+    // the position in the coordinate of the geometry
+    Position T;
+};
+
+/**
+   Detect the collisions between primitives by the closed form computations.
+   The normals of the detected collisions point from the first shape to the second shape.
+   @param T1 the position of the first shape in the world coordinate
+   @param T2 the position of the second shape in the world coordinate
+   @return false if the collisions of the pair cannot be detected analytically.
+   In that case the collisions must be detected with the meshes.
+*/
+bool detectPrimitiveCollisions(const PrimitiveShape& shape1, const Position& T1,
+                               const PrimitiveShape& shape2, const Position& T2,
+                               CollisionList& out_collisions);
+
+/**
+   Detect the collision between a sphere and a triangle.
+   The normal of the detected collision points from the triangle to the sphere.
+   @return true if they collide
+*/
+bool detectSphereTriangleCollision(const Vector3& center, double radius,
+                                   const Vector3& v0, const Vector3& v1, const Vector3& v2,
+                                   Collision& out_collision);
+}
+
+#endif
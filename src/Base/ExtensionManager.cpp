@@ -159,7 +159,13 @@ ViewManager& ExtensionManager::viewManager()
 MenuManager& ExtensionManager::menuManager()
 {
     if(!impl->menuManager){
-        impl->menuManager.reset(new MenuManager(MainWindow::instance()->menuBar()));
+        if(MainWindow* mainWindow = MainWindow::instance()){
+            impl->menuManager.reset(new MenuManager(mainWindow->menuBar()));
+        } else {
+            // The menu items are put into a detached menu when the main window is not used
+            impl->menuManager.reset(new MenuManager());
+            impl->menuManager->setNewPopupMenu();
+        }
         impl->menuManager->bindTextDomain(impl->textDomain);
     }
     return *impl->menuManager;
@@ -209,7 +215,9 @@ void ExtensionManager::addToolBar(ToolBar* toolBar)
 {
     toolBar->setWindowTitle(dgettext(impl->textDomain.c_str(), toolBar->objectName().toAscii()));
     manage(toolBar);
-    MainWindow::instance()->addToolBar(toolBar);
+    if(MainWindow* mainWindow = MainWindow::instance()){
+        mainWindow->addToolBar(toolBar);
+    }
 }
 
 
@@ -7,6 +7,7 @@
 #include <cnoid/SceneShape>
 #include <cnoid/SceneCamera>
 #include <cnoid/SceneLight>
+#include <cnoid/SceneRayPicker>
 #include <cnoid/EigenUtil>
 #include <Eigen/StdVector>
 #ifdef _WIN32
@@ -35,7 +36,6 @@ using namespace cnoid;
 namespace {
 
 const bool USE_DISPLAY_LISTS = true;
-const bool USE_VBO = false;
 const bool USE_INDEXING = false;
 const bool SHOW_IMAGE_FOR_PICKING = false;
 
@@ -62,17 +62,26 @@ public:
     GLuint listID;
     GLuint listIDforPicking;
     bool useIDforPicking;
-    GLuint bufferNames[4];
-    GLuint size;
+    GLuint bufferNames[5];
+    GLuint size; // the number of the vertices or indices to draw
+    bool isIndexed; // true if the index buffer is used
+    bool isBufferUpdateNeeded;
+    bool isBufferWritten;
+    float alpha; // the alpha value of the colors in the color buffer
     vector<TransparentShapeInfoPtr> transparentShapes;
         
     ShapeCache() {
         listID = 0;
         useIDforPicking = false;
         listIDforPicking = 0;
-        for(int i=0; i < 4; ++i){
+        for(int i=0; i < 5; ++i){
             bufferNames[i] = GL_INVALID_VALUE;
         }
+        size = 0;
+        isIndexed = false;
+        isBufferUpdateNeeded = true;
+        isBufferWritten = false;
+        alpha = 1.0f;
     }
     ~ShapeCache() {
         if(listID){
@@ -81,16 +90,30 @@ public:
         if(listIDforPicking){
             glDeleteLists(listIDforPicking, 1);
         }
-        for(int i=0; i < 4; ++i){
-            if(bufferNames[i] != GL_INVALID_VALUE){
-                glDeleteBuffers(1, &bufferNames[i]);
-            }
+        for(int i=0; i < 5; ++i){
+            releaseBuffer(bufferNames[i]);
         }
     }
     GLuint& vertexBufferName() { return bufferNames[0]; }
     GLuint& normalBufferName() { return bufferNames[1]; }
     GLuint& indexBufferName() { return bufferNames[2]; }
     GLuint& texCoordBufferName() { return bufferNames[3]; }
+    GLuint& colorBufferName() { return bufferNames[4]; }
+
+    void writeBuffer(GLenum target, GLuint& name, size_t size, const GLvoid* data) {
+        if(name == GL_INVALID_VALUE){
+            glGenBuffers(1, &name);
+        }
+        glBindBuffer(target, name);
+        // The buffers of a mesh which has been updated once are likely to be updated again
+        glBufferData(target, size, data, isBufferWritten ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+    }
+    void releaseBuffer(GLuint& name) {
+        if(name != GL_INVALID_VALUE){
+            glDeleteBuffers(1, &name);
+            name = GL_INVALID_VALUE;
+        }
+    }
 };
 typedef ref_ptr<ShapeCache> ShapeCachePtr;
 
@@ -385,6 +408,8 @@ public:
     GLfloat defaultPointSize;
     GLfloat defaultLineWidth;
     GLuint defaultTextureName;
+    bool isVertexBufferObjectEnabled;
+    bool isVertexBufferObjectAvailable;
         
     bool doNormalVisualization;
     double normalLength;
@@ -402,8 +427,17 @@ public:
     SgNodePath pickedNodePath;
     Vector3 pickedPoint;
 
+    bool isRayCastPickingEnabled;
+    boost::scoped_ptr<SceneRayPicker> rayPicker;
+
     vector<TransparentShapeInfoPtr> transparentShapeInfos;
 
+    bool isFrustumCullingEnabled;
+    // false when the current node is known to be inside the view volume
+    bool isFrustumCullingActive;
+    int numCulledNodes;
+    int numRenderedNodes;
+
     // OpenGL states
     enum StateFlag {
         CURRENT_COLOR,
@@ -464,20 +498,29 @@ public:
     void endRendering();
     void render();
     bool pick(int x, int y);
+    bool pickByRayCasting(int x, int y);
+    Vector3 unproject(double x, double y, double depth, const Matrix4& PVinv) const;
     inline void setPickColor(unsigned int id);
     inline unsigned int pushPickName(SgNode* node, bool doSetColor = true);
     void popPickName();
+    bool isCulled(SgNode* node, const BoundingBox& bbox, bool& out_isInside);
+    void retainCaches(SgNode* node);
+    void retainCache(SgObject* object);
+    void renderGroup(SgGroup* group);
     void visitInvariantGroup(SgInvariantGroup* group);
     void visitShape(SgShape* shape);
     void visitPointSet(SgPointSet* pointSet);
-    void renderPlot(SgPlot* plot, SgVertexArray& expandedVertices, GLenum primitiveMode);
+    void renderPlot(SgPlot* plot, SgVertexArray& expandedVertices, GLenum primitiveMode, ShapeCache* cache = 0);
     void visitLineSet(SgLineSet* lineSet);
     void renderMaterial(const SgMaterial* material);
     bool renderTexture(SgTexture* texture, bool withMaterial);
     void putMeshData(SgMesh* mesh);
     void renderMesh(SgMesh* mesh, bool hasTexture);
     void renderTransparentShapes();
-    void writeVertexBuffers(SgMesh* mesh, ShapeCache* cache, bool hasTexture);
+    void writeVertexBuffers(SgMesh* mesh, bool hasTexture);
+    ShapeCache* getBufferObjectCache(SgObject* object);
+    void renderMeshWithBufferObjects(SgMesh* mesh, bool hasTexture);
+    void writeBufferObjects(SgMesh* mesh, ShapeCache* cache, bool hasTexture);
 
     void clearGLState();
     void setColor(const Vector4f& color);
@@ -571,6 +614,8 @@ GLSceneRendererImpl::GLSceneRendererImpl(GLSceneRenderer* self, SgGroup* root)
     isTextureEnabled = true;
     defaultPointSize = 1.0f;
     defaultLineWidth = 1.0f;
+    isVertexBufferObjectEnabled = false;
+    isVertexBufferObjectAvailable = false;
     
     doNormalVisualization = false;
     normalLength = 0.0;
@@ -580,6 +625,12 @@ GLSceneRendererImpl::GLSceneRendererImpl(GLSceneRenderer* self, SgGroup* root)
     isNewDisplayListCreated = false;
     isPicking = false;
     pickedPoint.setZero();
+    isRayCastPickingEnabled = false;
+
+    isFrustumCullingEnabled = true;
+    isFrustumCullingActive = false;
+    numCulledNodes = 0;
+    numRenderedNodes = 0;
 
     stateFlag.resize(NUM_STATE_FLAGS, false);
     clearGLState();
@@ -623,6 +674,25 @@ void GLSceneRendererImpl::onSceneGraphUpdated(const SgUpdate& update)
             cache->isImageUpdateNeeded = true;
         }
     }
+    if(isVertexBufferObjectEnabled){
+        // The update of a vertex array is propagated to the mesh or point set owning it
+        const SgUpdate::Path& path = update.path();
+        for(size_t i=0; i < path.size() && i < 2; ++i){
+            SgObject* object = path[i];
+            if(dynamic_cast<SgMesh*>(object) || dynamic_cast<SgPointSet*>(object)){
+                CacheMap* cacheMap = hasValidNextCacheMap ? nextCacheMap : currentCacheMap;
+                CacheMap::iterator p = cacheMap->find(object);
+                if(p != cacheMap->end()){
+                    ShapeCache* cache = static_cast<ShapeCache*>(p->second.get());
+                    cache->isBufferUpdateNeeded = true;
+                }
+                break;
+            }
+        }
+    }
+    if(rayPicker){
+        rayPicker->invalidateCache(update);
+    }
                 
     sigRenderingRequest();
 }
@@ -863,6 +933,8 @@ bool GLSceneRendererImpl::initializeGL()
 
     glGenTextures(1, &defaultTextureName);
 
+    isVertexBufferObjectAvailable = GLEW_VERSION_1_5;
+
     return true;
 }
 
@@ -982,8 +1054,13 @@ void GLSceneRendererImpl::beginRendering(bool doRenderingCommands)
 
     setCurrentCamera(currentCameraIndex, false);
 
+    isFrustumCullingActive = false;
+    numCulledNodes = 0;
+    numRenderedNodes = 0;
+
     if(doRenderingCommands && currentCamera){
         renderCamera();
+        isFrustumCullingActive = isFrustumCullingEnabled;
         if(!isPicking){
             renderLights();
         }
@@ -1244,6 +1321,9 @@ void GLSceneRenderer::endRendering()
 
 void GLSceneRendererImpl::endRendering()
 {
+    // The nodes rendered with another projection after the rendering must not be culled
+    isFrustumCullingActive = false;
+    
     if(isCheckingUnusedCaches){
         currentCacheMap->clear();
         hasValidNextCacheMap = true;
@@ -1298,6 +1378,10 @@ bool GLSceneRenderer::pick(int x, int y)
 */
 bool GLSceneRendererImpl::pick(int x, int y)
 {
+    if(isRayCastPickingEnabled){
+        return pickByRayCasting(x, y);
+    }
+    
     glPushAttrib(GL_ENABLE_BIT);
 
     //glDisable(GL_LIGHTING); // disable this later in 'renderCamera()'
@@ -1323,7 +1407,9 @@ bool GLSceneRendererImpl::pick(int x, int y)
     if(SHOW_IMAGE_FOR_PICKING){
         color[2] = 0.0f;
     }
-    unsigned int id = (color[0] * 255) + ((int)(color[1] * 255) << 8) + ((int)(color[2] * 255) << 16) - 1;
+    // The components are rounded because the values read as float may be slightly smaller than the written ones
+    unsigned int id =
+        (int)(color[0] * 255 + 0.5f) + ((int)(color[1] * 255 + 0.5f) << 8) + ((int)(color[2] * 255 + 0.5f) << 16) - 1;
 
     pickedNodePath.clear();
 
@@ -1344,6 +1430,47 @@ bool GLSceneRendererImpl::pick(int x, int y)
 }
 
 
+/**
+   The ray through the center of the pixel is cast from the near plane to the far plane
+   of the view volume used in the last rendering, so that the object seen at the pixel
+   is picked without rendering the scene again.
+*/
+bool GLSceneRendererImpl::pickByRayCasting(int x, int y)
+{
+    if(!rayPicker){
+        rayPicker.reset(new SceneRayPicker);
+    }
+    
+    const Matrix4 PVinv = (lastProjectionMatrix * lastViewMatrix.matrix()).inverse();
+    const Vector3 start = unproject(x + 0.5, y + 0.5, 0.0, PVinv);
+    const Vector3 end = unproject(x + 0.5, y + 0.5, 1.0, PVinv);
+    rayPicker->setPixelSizes(
+        (unproject(x + 1.5, y + 0.5, 0.0, PVinv) - start).norm(),
+        (unproject(x + 1.5, y + 0.5, 1.0, PVinv) - end).norm());
+    rayPicker->setDefaultPointSize(defaultPointSize);
+    rayPicker->setDefaultLineWidth(defaultLineWidth);
+
+    pickedNodePath.clear();
+
+    if(rayPicker->pick(root, start, end)){
+        pickedNodePath = rayPicker->pickedNodePath();
+        pickedPoint = rayPicker->pickedPoint();
+    }
+
+    return !pickedNodePath.empty();
+}
+
+
+Vector3 GLSceneRendererImpl::unproject(double x, double y, double depth, const Matrix4& PVinv) const
+{
+    const Vector4 p = PVinv * Vector4(2.0 * (x - viewport[0]) / viewport[2] - 1.0,
+                                      2.0 * (y - viewport[1]) / viewport[3] - 1.0,
+                                      2.0 * depth - 1.0,
+                                      1.0);
+    return p.head<3>() / p[3];
+}
+
+
 const std::vector<SgNode*>& GLSceneRenderer::pickedNodePath() const
 {
     return impl->pickedNodePath;
@@ -1398,11 +1525,108 @@ inline void GLSceneRendererImpl::popPickName()
 }
 
 
+/**
+   The bounding box is tested against the six planes of the view volume extracted from
+   the matrix which transforms the current coordinate into the clip coordinate.
+   \param out_isInside true if the bounding box is entirely inside the view volume,
+   which means the culling test is not necessary for the descendant nodes
+   \return true if the bounding box is entirely outside the view volume
+*/
+bool GLSceneRendererImpl::isCulled(SgNode* node, const BoundingBox& bbox, bool& out_isInside)
+{
+    out_isInside = false;
+    
+    if(bbox.empty()){
+        return false;
+    }
+
+    const Matrix4 M = lastProjectionMatrix * Vstack.back().matrix();
+    const Vector3 c = bbox.center();
+    const Vector3 e = (bbox.max() - bbox.min()) / 2.0;
+    bool isInside = true;
+    
+    for(int i=0; i < 3; ++i){
+        for(int j=0; j < 2; ++j){
+            Vector4 plane;
+            if(j == 0){
+                plane = (M.row(3) + M.row(i)).transpose();
+            } else {
+                plane = (M.row(3) - M.row(i)).transpose();
+            }
+            const double d = plane.head<3>().dot(c) + plane[3];
+            const double r = plane.head<3>().cwiseAbs().dot(e);
+            if(d + r < 0.0){
+                ++numCulledNodes;
+                if(isCheckingUnusedCaches){
+                    retainCaches(node);
+                }
+                return true;
+            }
+            if(d - r < 0.0){
+                isInside = false;
+            }
+        }
+    }
+
+    out_isInside = isInside;
+    return false;
+}
+
+
+/**
+   The caches of the culled nodes are kept for the next rendering
+   so that the display lists and textures are not released and created again
+   when the nodes go out of the view volume and come back.
+*/
+void GLSceneRendererImpl::retainCaches(SgNode* node)
+{
+    retainCache(node);
+    
+    if(node->isGroup()){
+        SgGroup* group = static_cast<SgGroup*>(node);
+        for(SgGroup::const_iterator p = group->begin(); p != group->end(); ++p){
+            retainCaches(*p);
+        }
+    } else if(SgShape* shape = dynamic_cast<SgShape*>(node)){
+        retainCache(shape->mesh());
+        if(SgTexture* texture = shape->texture()){
+            retainCache(texture->image());
+        }
+    }
+}
+
+
+void GLSceneRendererImpl::retainCache(SgObject* object)
+{
+    if(object){
+        CacheMap::iterator p = currentCacheMap->find(object);
+        if(p != currentCacheMap->end()){
+            nextCacheMap->insert(*p);
+        }
+    }
+}
+
+
 void GLSceneRenderer::visitGroup(SgGroup* group)
 {
-    impl->pushPickName(group);
-    SceneVisitor::visitGroup(group);
-    impl->popPickName();
+    const bool isCullingActive = impl->isFrustumCullingActive;
+    if(isCullingActive && !group->isUnbounded()){
+        bool isInside;
+        if(impl->isCulled(group, group->boundingBox(), isInside)){
+            return;
+        }
+        impl->isFrustumCullingActive = !isInside;
+    }
+    impl->renderGroup(group);
+    impl->isFrustumCullingActive = isCullingActive;
+}
+
+
+void GLSceneRendererImpl::renderGroup(SgGroup* group)
+{
+    pushPickName(group);
+    self->SceneVisitor::visitGroup(group);
+    popPickName();
 }
 
 
@@ -1414,10 +1638,21 @@ void GLSceneRenderer::visitInvariantGroup(SgInvariantGroup* group)
 
 void GLSceneRendererImpl::visitInvariantGroup(SgInvariantGroup* group)
 {
-    if(!USE_DISPLAY_LISTS || isCompiling){
+    // The meshes in the group are rendered with their own buffer objects when they are enabled
+    if(!USE_DISPLAY_LISTS || isCompiling || isVertexBufferObjectEnabled){
         self->visitGroup(group);
 
     } else {
+        // The display lists must contain all the nodes
+        const bool isCullingActive = isFrustumCullingActive;
+        if(isCullingActive){
+            bool isInside;
+            if(!group->isUnbounded() && isCulled(group, group->boundingBox(), isInside)){
+                return;
+            }
+            isFrustumCullingActive = false;
+        }
+        
         ShapeCache* cache;
         CacheMap::iterator p = currentCacheMap->find(group);
         if(p == currentCacheMap->end()){
@@ -1472,6 +1707,7 @@ void GLSceneRendererImpl::visitInvariantGroup(SgInvariantGroup* group)
                 const unsigned int pickId = pushPickName(group);
                 glPushAttrib(GL_ENABLE_BIT);
                 glCallList(listID);
+                ++numRenderedNodes;
                 glPopAttrib();
                 clearGLState();
                 popPickName();
@@ -1494,6 +1730,8 @@ void GLSceneRendererImpl::visitInvariantGroup(SgInvariantGroup* group)
                 nextCacheMap->insert(CacheMap::value_type(group, cache));
             }
         }
+
+        isFrustumCullingActive = isCullingActive;
     }
     currentShapeCache = 0;
 }
@@ -1501,6 +1739,16 @@ void GLSceneRendererImpl::visitInvariantGroup(SgInvariantGroup* group)
 
 void GLSceneRenderer::visitTransform(SgTransform* transform)
 {
+    // The bounding box of the transform node is tested in the parent coordinate
+    const bool isCullingActive = impl->isFrustumCullingActive;
+    if(isCullingActive && !transform->isUnbounded()){
+        bool isInside;
+        if(impl->isCulled(transform, transform->boundingBox(), isInside)){
+            return;
+        }
+        impl->isFrustumCullingActive = !isInside;
+    }
+    
     Affine3 T;
     transform->getTransform(T);
 
@@ -1517,7 +1765,7 @@ void GLSceneRenderer::visitTransform(SgTransform* transform)
       }
     */
     
-    visitGroup(transform);
+    impl->renderGroup(transform);
     
     /*
       if(isNotRotationMatrix){
@@ -1527,6 +1775,8 @@ void GLSceneRenderer::visitTransform(SgTransform* transform)
     
     glPopMatrix();
     Vstack.pop_back();
+
+    impl->isFrustumCullingActive = isCullingActive;
 }
 
 
@@ -1535,6 +1785,14 @@ void GLSceneRendererImpl::visitShape(SgShape* shape)
     SgMesh* mesh = shape->mesh();
     if(mesh){
         if(mesh->hasVertices()){
+            bool isInside;
+            if(isFrustumCullingActive && isCulled(shape, mesh->boundingBox(), isInside)){
+                return;
+            }
+            if(!isCompiling){
+                ++numRenderedNodes;
+            }
+            
             SgMaterial* material = shape->material();
             SgTexture* texture = isTextureEnabled ? shape->texture() : 0;
 
@@ -1845,57 +2103,218 @@ void GLSceneRendererImpl::renderMesh(SgMesh* mesh, bool hasTexture)
 
     glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
 
-    if(!USE_VBO){
-        writeVertexBuffers(mesh, 0, hasTexture);
+    // The display lists being compiled cannot refer to the buffer objects
+    if(isVertexBufferObjectEnabled && isVertexBufferObjectAvailable && !isCompiling && !doNormalVisualization){
+        renderMeshWithBufferObjects(mesh, hasTexture);
+    } else {
+        writeVertexBuffers(mesh, hasTexture);
+    }
 
+    glPopClientAttrib();
+}
+
+
+ShapeCache* GLSceneRendererImpl::getBufferObjectCache(SgObject* object)
+{
+    ShapeCache* cache;
+    CacheMap::iterator p = currentCacheMap->find(object);
+    if(p != currentCacheMap->end()){
+        cache = static_cast<ShapeCache*>(p->second.get());
     } else {
-        ShapeCache* cache;
-        CacheMap::iterator it = currentCacheMap->find(mesh);
-        if(it != currentCacheMap->end()){
-            cache = static_cast<ShapeCache*>(it->second.get());
+        cache = new ShapeCache;
+        p = currentCacheMap->insert(CacheMap::value_type(object, cache)).first;
+    }
+    if(isCheckingUnusedCaches){
+        nextCacheMap->insert(*p);
+    }
+    return cache;
+}
+
+
+/**
+   The buffer objects of a mesh are shared by all the shapes referring to the mesh,
+   and they are written again only when the update of the mesh is notified.
+*/
+void GLSceneRendererImpl::renderMeshWithBufferObjects(SgMesh* mesh, bool hasTexture)
+{
+    ShapeCache* cache = getBufferObjectCache(mesh);
+
+    if(cache->isBufferUpdateNeeded ||
+       (hasTexture && cache->texCoordBufferName() == GL_INVALID_VALUE) ||
+       (cache->colorBufferName() != GL_INVALID_VALUE && cache->alpha != lastAlpha)){
+        writeBufferObjects(mesh, cache, hasTexture);
+    }
+    if(cache->size == 0){
+        return;
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, cache->vertexBufferName());
+    glVertexPointer(3, GL_FLOAT, 0, 0);
+
+    bool useColorArray = false;
+    if(!isPicking){
+        if(cache->normalBufferName() != GL_INVALID_VALUE){
+            glEnableClientState(GL_NORMAL_ARRAY);
+            glBindBuffer(GL_ARRAY_BUFFER, cache->normalBufferName());
+            glNormalPointer(GL_FLOAT, 0, 0);
+        }
+        if(cache->colorBufferName() != GL_INVALID_VALUE){
+            glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+            glEnable(GL_COLOR_MATERIAL);
+            glEnableClientState(GL_COLOR_ARRAY);
+            glBindBuffer(GL_ARRAY_BUFFER, cache->colorBufferName());
+            glColorPointer(4, GL_FLOAT, 0, 0);
+            useColorArray = true;
+        }
+    }
+    const bool useTexture = hasTexture && (cache->texCoordBufferName() != GL_INVALID_VALUE);
+    if(useTexture){
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, cache->texCoordBufferName());
+        glTexCoordPointer(2, GL_FLOAT, 0, 0);
+        glEnable(GL_TEXTURE_2D);
+    }
+
+    if(cache->isIndexed){
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cache->indexBufferName());
+        glDrawElements(GL_TRIANGLES, cache->size, GL_UNSIGNED_INT, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    } else {
+        glDrawArrays(GL_TRIANGLES, 0, cache->size);
+    }
+    
+    // The client side arrays of the other nodes must not be interpreted as the buffer offsets
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if(useColorArray){
+        glDisable(GL_COLOR_MATERIAL);
+        stateFlag.set(CURRENT_COLOR);
+    }
+    if(useTexture){
+        glDisable(GL_TEXTURE_2D);
+    }
+}
+
+
+/**
+   When all the attributes are given for each vertex, the original vertex arrays are
+   written with the index buffer of the triangles. Otherwise the vertices of each triangle
+   are expanded in the same way as the client side arrays.
+*/
+void GLSceneRendererImpl::writeBufferObjects(SgMesh* mesh, ShapeCache* cache, bool hasTexture)
+{
+    const SgVertexArray& orgVertices = *mesh->vertices();
+    const SgIndexArray& orgTriangleVertices = mesh->triangleVertices();
+    const size_t numOrgVertices = orgVertices.size();
+    const bool hasNormals = mesh->hasNormals();
+    const bool hasColors = mesh->hasColors();
+    // The texture coordinates once written are kept for the shapes sharing the mesh
+    const bool hasTexCoords =
+        mesh->hasTexCoords() && (hasTexture || cache->texCoordBufferName() != GL_INVALID_VALUE);
+
+    const bool isIndexed =
+        (!hasNormals || (mesh->normalIndices().empty() && mesh->normals()->size() == numOrgVertices)) &&
+        !hasColors &&
+        (!hasTexCoords || (mesh->texCoordIndices().empty() && mesh->texCoords()->size() == numOrgVertices));
+
+    if(orgTriangleVertices.empty()){
+        cache->size = 0;
+
+    } else if(isIndexed){
+        cache->writeBuffer(GL_ARRAY_BUFFER, cache->vertexBufferName(),
+                           numOrgVertices * sizeof(Vector3f), orgVertices.data());
+        if(hasNormals){
+            const SgNormalArray& normals = *mesh->normals();
+            cache->writeBuffer(GL_ARRAY_BUFFER, cache->normalBufferName(),
+                               normals.size() * sizeof(Vector3f), normals.data());
         } else {
-            it = currentCacheMap->insert(CacheMap::value_type(mesh, new ShapeCache)).first;
-            cache = static_cast<ShapeCache*>(it->second.get());
-            writeVertexBuffers(mesh, cache, hasTexture);
+            cache->releaseBuffer(cache->normalBufferName());
         }
-        if(isCheckingUnusedCaches){
-            nextCacheMap->insert(*it);
+        cache->releaseBuffer(cache->colorBufferName());
+        if(hasTexCoords){
+            const SgTexCoordArray& texCoords = *mesh->texCoords();
+            cache->writeBuffer(GL_ARRAY_BUFFER, cache->texCoordBufferName(),
+                               texCoords.size() * sizeof(Vector2f), texCoords.data());
+        } else {
+            cache->releaseBuffer(cache->texCoordBufferName());
         }
-        if(cache->vertexBufferName() != GL_INVALID_VALUE){
-            glEnableClientState(GL_VERTEX_ARRAY);
-            glBindBuffer(GL_ARRAY_BUFFER, cache->vertexBufferName());
-            glVertexPointer(3, GL_FLOAT, 0, 0);
-                        
-            if(cache->normalBufferName() != GL_INVALID_VALUE){
-                glEnableClientState(GL_NORMAL_ARRAY);
-                glBindBuffer(GL_ARRAY_BUFFER, cache->normalBufferName());
-                glNormalPointer(GL_FLOAT, 0, 0);
-            }
-            if(cache->texCoordBufferName() != GL_INVALID_VALUE){
-                glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-                glBindBuffer(GL_ARRAY_BUFFER, cache->texCoordBufferName());
-                glTexCoordPointer(2, GL_FLOAT, 0, 0);
-                glEnable(GL_TEXTURE_2D);
+        cache->writeBuffer(GL_ELEMENT_ARRAY_BUFFER, cache->indexBufferName(),
+                           orgTriangleVertices.size() * sizeof(GLuint), &orgTriangleVertices.front());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        cache->size = orgTriangleVertices.size();
+        
+    } else {
+        const size_t numVertices = orgTriangleVertices.size();
+        SgVertexArray& vertices = buf->vertices;
+        SgNormalArray& normals = buf->normals;
+        ColorArray& colors = buf->colors;
+        SgTexCoordArray& texCoords = buf->texCoords;
+        vertices.resize(numVertices);
+        normals.resize(hasNormals ? numVertices : 0);
+        colors.resize(hasColors ? numVertices : 0);
+        texCoords.resize(hasTexCoords ? numVertices : 0);
+        
+        for(size_t i=0; i < numVertices; ++i){
+            const int orgVertexIndex = orgTriangleVertices[i];
+            vertices[i] = orgVertices[orgVertexIndex];
+            if(hasNormals){
+                if(mesh->normalIndices().empty()){
+                    normals[i] = mesh->normals()->at(orgVertexIndex);
+                } else {
+                    normals[i] = mesh->normals()->at(mesh->normalIndices()[i]);
+                }
             }
-            if(USE_INDEXING){
-                if(cache->indexBufferName() != GL_INVALID_VALUE){
-                    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cache->indexBufferName());
-                    glDrawElements(GL_TRIANGLES, cache->size, GL_UNSIGNED_INT, 0);
+            if(hasColors){
+                if(mesh->colorIndices().empty()){
+                    colors[i] = createColorWithAlpha(mesh->colors()->at(i));
+                } else {
+                    colors[i] = createColorWithAlpha(mesh->colors()->at(mesh->colorIndices()[i]));
                 }
-            } else {
-                glDrawArrays(GL_TRIANGLES, 0, cache->size);
             }
-            if(cache->texCoordBufferName() != GL_INVALID_VALUE){
-                glDisable(GL_TEXTURE_2D);
+            if(hasTexCoords){
+                if(mesh->texCoordIndices().empty()){
+                    texCoords[i] = mesh->texCoords()->at(orgVertexIndex);
+                } else {
+                    texCoords[i] = mesh->texCoords()->at(mesh->texCoordIndices()[i]);
+                }
             }
         }
+
+        cache->writeBuffer(GL_ARRAY_BUFFER, cache->vertexBufferName(),
+                           numVertices * sizeof(Vector3f), vertices.data());
+        if(hasNormals){
+            cache->writeBuffer(GL_ARRAY_BUFFER, cache->normalBufferName(),
+                               numVertices * sizeof(Vector3f), normals.data());
+        } else {
+            cache->releaseBuffer(cache->normalBufferName());
+        }
+        if(hasColors){
+            cache->writeBuffer(GL_ARRAY_BUFFER, cache->colorBufferName(),
+                               numVertices * sizeof(Vector4f), colors.front().data());
+        } else {
+            cache->releaseBuffer(cache->colorBufferName());
+        }
+        if(hasTexCoords){
+            cache->writeBuffer(GL_ARRAY_BUFFER, cache->texCoordBufferName(),
+                               numVertices * sizeof(Vector2f), texCoords.data());
+        } else {
+            cache->releaseBuffer(cache->texCoordBufferName());
+        }
+        cache->releaseBuffer(cache->indexBufferName());
+        cache->size = numVertices;
     }
 
-    glPopClientAttrib();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    cache->isIndexed = isIndexed;
+    cache->alpha = lastAlpha;
+    cache->isBufferUpdateNeeded = false;
+    cache->isBufferWritten = true;
 }
 
 
-void GLSceneRendererImpl::writeVertexBuffers(SgMesh* mesh, ShapeCache* cache, bool hasTexture)
+void GLSceneRendererImpl::writeVertexBuffers(SgMesh* mesh, bool hasTexture)
 {
     SgVertexArray& orgVertices = *mesh->vertices();
     SgIndexArray& orgTriangleVertices = mesh->triangleVertices();
@@ -2004,69 +2423,30 @@ void GLSceneRendererImpl::writeVertexBuffers(SgMesh* mesh, ShapeCache* cache, bo
         }
     }
 
-    if(USE_VBO){
-        if(cache->vertexBufferName() == GL_INVALID_VALUE){
-            glGenBuffers(1, &cache->vertexBufferName());
-            glBindBuffer(GL_ARRAY_BUFFER, cache->vertexBufferName());
-            glBufferData(GL_ARRAY_BUFFER, vertices->size() * sizeof(Vector3f), vertices->data(), GL_STATIC_DRAW);
-        }
-    } else {
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glVertexPointer(3, GL_FLOAT, 0, vertices->data());
-    }
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, vertices->data());
     if(normals){
-        if(USE_VBO){
-            if(cache->normalBufferName() == GL_INVALID_VALUE){
-                glGenBuffers(1, &cache->normalBufferName());
-                glBindBuffer(GL_ARRAY_BUFFER, cache->normalBufferName());
-                glBufferData(GL_ARRAY_BUFFER, normals->size() * sizeof(Vector3f), normals->data(), GL_STATIC_DRAW);
-            }
-        } else {
-            glEnableClientState(GL_NORMAL_ARRAY);
-            glNormalPointer(GL_FLOAT, 0, normals->data());
-        }
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, 0, normals->data());
     }
     bool useColorArray = false;
     if(colors){
-        if(!USE_VBO){
-            glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
-            glEnable(GL_COLOR_MATERIAL);
-            glEnableClientState(GL_COLOR_ARRAY);
-            glColorPointer(4, GL_FLOAT, 0, &colors[0][0]);
-            useColorArray = true;
-        }
+        glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+        glEnable(GL_COLOR_MATERIAL);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glColorPointer(4, GL_FLOAT, 0, &colors[0][0]);
+        useColorArray = true;
     }
     if(hasTexture){
-        if(USE_VBO){
-            if(cache->texCoordBufferName() == GL_INVALID_VALUE){
-                glGenBuffers(1, &cache->texCoordBufferName());
-                glBindBuffer(GL_ARRAY_BUFFER, cache->texCoordBufferName());
-                glBufferData(GL_ARRAY_BUFFER, texCoords->size() * sizeof(Vector2f), texCoords->data(), GL_STATIC_DRAW);
-            }
-        } else {
-            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-            glTexCoordPointer(2, GL_FLOAT, 0, texCoords->data());
-        }
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, 0, texCoords->data());
         glEnable(GL_TEXTURE_2D);
     }
 
-    if(USE_VBO){
-        if(!triangleVertices){
-            cache->size = vertices->size();
-
-        } else if(cache->indexBufferName() == GL_INVALID_VALUE){
-            glGenBuffers(1, &cache->indexBufferName());
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cache->indexBufferName());
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangleVertices->size(), &triangleVertices->front(), GL_STATIC_DRAW);
-            cache->size = triangleVertices->size();
-        }
-            
+    if(USE_INDEXING){
+        glDrawElements(GL_TRIANGLES, triangleVertices->size(), GL_UNSIGNED_INT, &triangleVertices->front());
     } else {
-        if(USE_INDEXING){
-            glDrawElements(GL_TRIANGLES, triangleVertices->size(), GL_UNSIGNED_INT, &triangleVertices->front());
-        } else {
-            glDrawArrays(GL_TRIANGLES, 0, vertices->size());
-        }
+        glDrawArrays(GL_TRIANGLES, 0, vertices->size());
     }
 
     if(useColorArray){
@@ -2107,23 +2487,56 @@ void GLSceneRendererImpl::visitPointSet(SgPointSet* pointSet)
     if(!pointSet->hasVertices()){
         return;
     }
+    bool isInside;
+    if(isFrustumCullingActive && isCulled(pointSet, pointSet->boundingBox(), isInside)){
+        return;
+    }
+    if(!isCompiling){
+        ++numRenderedNodes;
+    }
+    
     const double s = pointSet->pointSize();
     if(s > 0.0){
         setPointSize(s);
     }
-    renderPlot(pointSet, *pointSet->vertices(), (GLenum)GL_POINTS);
+    ShapeCache* cache = 0;
+    if(isVertexBufferObjectEnabled && isVertexBufferObjectAvailable && !isCompiling){
+        cache = getBufferObjectCache(pointSet);
+        if(isPicking && cache->isBufferUpdateNeeded){
+            // The buffers are written with the colors and normals which are not given in picking
+            cache = 0;
+        }
+    }
+    renderPlot(pointSet, *pointSet->vertices(), (GLenum)GL_POINTS, cache);
     if(s > 0.0){
         setPointSize(s);
     }
 }
 
 
-void GLSceneRendererImpl::renderPlot(SgPlot* plot, SgVertexArray& expandedVertices, GLenum primitiveMode)
+/**
+   \param cache If this is given, the arrays are written to the buffer objects of the cache
+   when the plot has been updated, and the buffers are used for the rendering.
+*/
+void GLSceneRendererImpl::renderPlot(SgPlot* plot, SgVertexArray& expandedVertices, GLenum primitiveMode, ShapeCache* cache)
 {
     glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+    const bool doWriteBuffers = cache && cache->isBufferUpdateNeeded;
         
     glEnableClientState(GL_VERTEX_ARRAY);
-    glVertexPointer(3, GL_FLOAT, 0, expandedVertices.data());
+    if(!cache){
+        glVertexPointer(3, GL_FLOAT, 0, expandedVertices.data());
+    } else {
+        if(doWriteBuffers){
+            cache->writeBuffer(GL_ARRAY_BUFFER, cache->vertexBufferName(),
+                               expandedVertices.size() * sizeof(Vector3f), expandedVertices.data());
+            cache->size = expandedVertices.size();
+        } else {
+            glBindBuffer(GL_ARRAY_BUFFER, cache->vertexBufferName());
+        }
+        glVertexPointer(3, GL_FLOAT, 0, 0);
+    }
     
     SgMaterial* material = plot->material() ? plot->material() : defaultMaterial.get();
     
@@ -2139,38 +2552,55 @@ void GLSceneRendererImpl::renderPlot(SgPlot* plot, SgVertexArray& expandedVertic
         setLightModelTwoSide(true);
         renderMaterial(material);
         
-        const SgNormalArray& orgNormals = *plot->normals();
-        SgNormalArray& normals = buf->normals;
-        const SgIndexArray& normalIndices = plot->normalIndices();
-        if(normalIndices.empty()){
-            normals = orgNormals;
-        } else {
-            normals.clear();
-            normals.reserve(normalIndices.size());
-            for(int i=0; i < normalIndices.size(); ++i){
-                normals.push_back(orgNormals[normalIndices[i]]);
+        if(!cache || doWriteBuffers || cache->normalBufferName() == GL_INVALID_VALUE){
+            const SgNormalArray& orgNormals = *plot->normals();
+            SgNormalArray& normals = buf->normals;
+            const SgIndexArray& normalIndices = plot->normalIndices();
+            if(normalIndices.empty()){
+                normals = orgNormals;
+            } else {
+                normals.clear();
+                normals.reserve(normalIndices.size());
+                for(int i=0; i < normalIndices.size(); ++i){
+                    normals.push_back(orgNormals[normalIndices[i]]);
+                }
             }
+            if(cache){
+                cache->writeBuffer(GL_ARRAY_BUFFER, cache->normalBufferName(),
+                                   normals.size() * sizeof(Vector3f), normals.data());
+            }
+        } else {
+            glBindBuffer(GL_ARRAY_BUFFER, cache->normalBufferName());
         }
         glEnableClientState(GL_NORMAL_ARRAY);
-        glNormalPointer(GL_FLOAT, 0, normals.data());
+        glNormalPointer(GL_FLOAT, 0, cache ? 0 : buf->normals.data());
     }
 
     bool isColorMaterialEnabled = false;
 
     if(plot->hasColors() && !isPicking){
-        const SgColorArray& orgColors = *plot->colors();
         ColorArray& colors = buf->colors;
-        colors.clear();
-        colors.reserve(expandedVertices.size());
-        const SgIndexArray& colorIndices = plot->colorIndices();
-        if(colorIndices.empty()){
-            for(int i=0; i < orgColors.size(); ++i){
-                colors.push_back(createColorWithAlpha(orgColors[i]));
+        if(!cache || doWriteBuffers || cache->colorBufferName() == GL_INVALID_VALUE || cache->alpha != lastAlpha){
+            const SgColorArray& orgColors = *plot->colors();
+            colors.clear();
+            colors.reserve(expandedVertices.size());
+            const SgIndexArray& colorIndices = plot->colorIndices();
+            if(colorIndices.empty()){
+                for(int i=0; i < orgColors.size(); ++i){
+                    colors.push_back(createColorWithAlpha(orgColors[i]));
+                }
+            } else {
+                for(int i=0; i < colorIndices.size(); ++i){
+                    colors.push_back(createColorWithAlpha(orgColors[colorIndices[i]]));
+                }
             }
-        } else {
-            for(int i=0; i < colorIndices.size(); ++i){
-                colors.push_back(createColorWithAlpha(orgColors[colorIndices[i]]));
+            if(cache){
+                cache->writeBuffer(GL_ARRAY_BUFFER, cache->colorBufferName(),
+                                   colors.size() * sizeof(Vector4f), colors.front().data());
+                cache->alpha = lastAlpha;
             }
+        } else {
+            glBindBuffer(GL_ARRAY_BUFFER, cache->colorBufferName());
         }
         if(plot->hasNormals()){
             glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
@@ -2178,14 +2608,20 @@ void GLSceneRendererImpl::renderPlot(SgPlot* plot, SgVertexArray& expandedVertic
             isColorMaterialEnabled = true;
         }
         glEnableClientState(GL_COLOR_ARRAY);
-        glColorPointer(4, GL_FLOAT, 0, &colors[0][0]);
+        glColorPointer(4, GL_FLOAT, 0, cache ? 0 : &colors[0][0]);
         stateFlag.set(CURRENT_COLOR);
         //setColor(colors.back()); // set the last color
     }
     
     pushPickName(plot);
-    glDrawArrays(primitiveMode, 0, expandedVertices.size());
+    glDrawArrays(primitiveMode, 0, cache ? cache->size : expandedVertices.size());
     popPickName();
+
+    if(cache){
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        cache->isBufferUpdateNeeded = false;
+        cache->isBufferWritten = true;
+    }
     
     if(plot->hasNormals()){
         if(isColorMaterialEnabled){
@@ -2211,6 +2647,13 @@ void GLSceneRendererImpl::visitLineSet(SgLineSet* lineSet)
     if(!lineSet->hasVertices() || (n <= 0)){
         return;
     }
+    bool isInside;
+    if(isFrustumCullingActive && isCulled(lineSet, lineSet->boundingBox(), isInside)){
+        return;
+    }
+    if(!isCompiling){
+        ++numRenderedNodes;
+    }
 
     const SgVertexArray& orgVertices = *lineSet->vertices();
     SgVertexArray& vertices = buf->vertices;
@@ -2273,7 +2716,11 @@ void GLSceneRenderer::visitOverlay(SgOverlay* overlay)
     glLoadIdentity();
     glOrtho(v.left, v.right, v.bottom, v.top, v.zNear, v.zFar);
 
+    // The view volume of the overlay is different from that of the camera
+    const bool isCullingActive = impl->isFrustumCullingActive;
+    impl->isFrustumCullingActive = false;
     visitGroup(overlay);
+    impl->isFrustumCullingActive = isCullingActive;
     
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
@@ -2611,9 +3058,14 @@ void SgCustomGLNode::accept(SceneVisitor& visitor)
 {
     GLSceneRenderer* renderer = dynamic_cast<GLSceneRenderer*>(&visitor);
     if(renderer){
-        renderer->impl->pushPickName(this);
+        // The custom rendering may use the transforms which are not managed by the renderer
+        GLSceneRendererImpl* impl = renderer->impl;
+        const bool isCullingActive = impl->isFrustumCullingActive;
+        impl->isFrustumCullingActive = false;
+        impl->pushPickName(this);
         render(*renderer);
-        renderer->impl->popPickName();
+        impl->popPickName();
+        impl->isFrustumCullingActive = isCullingActive;
     } else {
         visitor.visitGroup(this);
     }
@@ -2628,6 +3080,15 @@ void SgCustomGLNode::render(GLSceneRenderer& renderer)
 }
 
 
+/**
+   The bounding box does not cover what the rendering function draws.
+*/
+bool SgCustomGLNode::isUnbounded() const
+{
+    return true;
+}
+
+
 void SgCustomGLNode::setRenderingFunction(RenderingFunction f)
 {
     renderingFunction = f;
@@ -2760,6 +3221,63 @@ void GLSceneRenderer::setNewDisplayListDoubleRenderingEnabled(bool on)
 }
 
 
+/**
+   The buffer objects are only used when OpenGL 1.5 or later is available.
+*/
+void GLSceneRenderer::enableVertexBufferObject(bool on)
+{
+    if(on != impl->isVertexBufferObjectEnabled){
+        impl->isVertexBufferObjectEnabled = on;
+        impl->sigRenderingRequest();
+    }
+}
+
+
+bool GLSceneRenderer::isVertexBufferObjectEnabled() const
+{
+    return impl->isVertexBufferObjectEnabled;
+}
+
+
+void GLSceneRenderer::enableRayCastPicking(bool on)
+{
+    impl->isRayCastPickingEnabled = on;
+    if(!on){
+        impl->rayPicker.reset();
+    }
+}
+
+
+bool GLSceneRenderer::isRayCastPickingEnabled() const
+{
+    return impl->isRayCastPickingEnabled;
+}
+
+
+void GLSceneRenderer::enableFrustumCulling(bool on)
+{
+    impl->isFrustumCullingEnabled = on;
+}
+
+
+bool GLSceneRenderer::isFrustumCullingEnabled() const
+{
+    return impl->isFrustumCullingEnabled;
+}
+
+
+int GLSceneRenderer::numCulledNodes() const
+{
+    return impl->numCulledNodes;
+}
+
+
+int GLSceneRenderer::numRenderedNodes() const
+{
+    return impl->numRenderedNodes;
+}
+
+
 void GLSceneRenderer::enableUnusedCacheCheck(bool on)
 {
     if(!on){
@@ -116,6 +116,43 @@ public:
     */
     virtual void enableUnusedCacheCheck(bool on);
 
+    /**
+       If this is enabled, the meshes are rendered with the vertex buffer objects cached
+       for each mesh instead of the display lists of the invariant groups. The buffers are
+       written again only for the meshes whose updates are notified, so editing a scene does
+       not cause the recompilation of the display lists. The default value is false.
+    */
+    void enableVertexBufferObject(bool on);
+    bool isVertexBufferObjectEnabled() const;
+
+    /**
+       If this is enabled, the pick() function casts the ray through the pixel against the
+       scene graph on the CPU instead of rendering the scene with the colors identifying
+       the objects. The triangles of the meshes are tested with the bounding volume hierarchies
+       built for the meshes, which are kept until the meshes are updated. This function
+       can be used without the OpenGL context, and the objects rendered by SgCustomGLNode
+       are not picked. The default value is false.
+    */
+    void enableRayCastPicking(bool on);
+    bool isRayCastPickingEnabled() const;
+
+    /**
+       If this is enabled, the groups and shapes whose bounding boxes are outside the view
+       volume of the current camera are skipped in the rendering. The descendants of a group
+       entirely inside the view volume are not tested. The default value is true.
+    */
+    void enableFrustumCulling(bool on);
+    bool isFrustumCullingEnabled() const;
+
+    /**
+       The statistics of the last rendering. The rendered nodes are the shapes, point sets
+       and line sets which are actually rendered, and the culled nodes are the nodes skipped
+       by the frustum culling, whose descendants are not counted. An invariant group
+       rendered with its display list is counted as one rendered node.
+    */
+    int numCulledNodes() const;
+    int numRenderedNodes() const;
+
     virtual void visitGroup(SgGroup* group);
     virtual void visitInvariantGroup(SgInvariantGroup* group);
     virtual void visitTransform(SgTransform* transform);
@@ -161,6 +198,7 @@ public:
     virtual SgObject* clone(SgCloneMap& cloneMap) const;
     virtual void accept(SceneVisitor& visitor);
     virtual void render(GLSceneRenderer& renderer);
+    virtual bool isUnbounded() const;
     void setRenderingFunction(RenderingFunction f);
 
 protected:
@@ -112,6 +112,9 @@ public:
         
     std::stack<StdioInfo> stdios;
     bool exitEventLoopRequested;
+    bool isStderrOutputEnabled;
+    // This is not affected by beginStdioRedirect
+    std::ostream stderrOut;
 
     MessageViewImpl(MessageView* self);
 
@@ -207,10 +210,13 @@ MessageViewImpl::MessageViewImpl(MessageView* self) :
     os(&sbuf),
     textSink_flush(this, true),
     sbuf_flush(textSink_flush),
-    os_flush(&sbuf_flush)
+    os_flush(&sbuf_flush),
+    stderrOut(std::cerr.rdbuf())
 {
     self->setDefaultLayoutArea(View::BOTTOM);
 
+    isStderrOutputEnabled = false;
+
     textEdit.setObjectName("TextEdit");
     textEdit.setFrameShape(QFrame::NoFrame);
     //textEdit.setReadOnly(true);
@@ -273,6 +279,12 @@ void MessageView::endStdioRedirect()
 }
 
 
+void MessageView::enableStderrOutput(bool on)
+{
+    impl->isStderrOutputEnabled = on;
+}
+
+
 void MessageView::put(const char* message)
 {
     impl->put(message, false, false, false);
@@ -432,6 +444,18 @@ void MessageViewImpl::put(int type, const QString& message, bool doLF, bool doNo
 
 void MessageViewImpl::doPut(const QString& message, bool doLF, bool doNotify, bool doFlush)
 {
+    if(isStderrOutputEnabled){
+        stderrOut << message.toLocal8Bit().constData();
+        if(doLF){
+            stderrOut << endl;
+        } else {
+            stderrOut.flush();
+        }
+        if(doFlush){
+            flush();
+        }
+        return;
+    }
     
     int scrollPos = textEdit.getScrollPos();
     bool enableScroll = (scrollPos > textEdit.maxScrollPos()-3*textEdit.scrollSingleStep());
@@ -80,6 +80,12 @@ public:
     void beginStdioRedirect();
     void endStdioRedirect();
 
+    /**
+       The messages are put into the standard error instead of the view when this is enabled.
+       This is used by the programs running without the main window.
+    */
+    void enableStderrOutput(bool on);
+
     static bool isFlushing();
     static SignalProxy<void()> sigFlushFinished();
 
@@ -124,6 +124,7 @@ public:
     PluginInfoArray pluginsToUnload;
     
     void clearUnusedPlugins();
+    void selectPlugins(const vector<string>& names);
     void scanPluginFilesInDefaultPath(const std::string& pathList);
     void scanPluginFilesInDirectoyOfExecFile();
     void scanPluginFiles(const std::string& pathString, bool isRecursive);
@@ -379,6 +380,39 @@ void PluginManagerImpl::clearUnusedPlugins()
 }
 
 
+/**
+   This function removes the scanned plugin files which have not been loaded yet
+   and are not the files of the plugins specified by the names.
+   It is used by the programs which only need a part of the plugins.
+*/
+void PluginManager::selectPlugins(const std::vector<std::string>& names)
+{
+    impl->selectPlugins(names);
+}
+
+
+void PluginManagerImpl::selectPlugins(const vector<string>& names)
+{
+    set<string> filenames;
+    for(size_t i=0; i < names.size(); ++i){
+        filenames.insert(str(fmt("%1%Cnoid%2%Plugin%3%.%4%") % DLL_PREFIX % names[i] % DEBUG_SUFFIX % DLL_SUFFIX));
+    }
+    
+    vector<PluginInfoPtr> oldList = allPluginInfos;
+    allPluginInfos.clear();
+
+    for(size_t i=0; i < oldList.size(); ++i){
+        PluginInfoPtr& info = oldList[i];
+        if(info->status != PluginManager::NOT_LOADED ||
+           filenames.find(getFilename(info->pathString)) != filenames.end()){
+            allPluginInfos.push_back(info);
+        } else {
+            pathToPluginInfoMap.erase(info->pathString);
+        }
+    }
+}
+
+
 void PluginManager::loadPlugins()
 {
     impl->loadPlugins();
@@ -6,6 +6,7 @@
 #define CNOID_BASE_PLUGIN_MANAGER_H
 
 #include <string>
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -29,6 +30,7 @@ public:
     void scanPluginFilesInDirectoyOfExecFile();
     void scanPluginFiles(const std::string& pathString);
     void clearUnusedPlugins();
+    void selectPlugins(const std::vector<std::string>& names);
     void loadPlugins();
     bool finalizePlugins();
 
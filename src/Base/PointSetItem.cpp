@@ -143,10 +143,10 @@ static bool loadPCD(PointSetItem* item, const std::string& filename, std::ostrea
 }
 
 
-static bool saveAsPCD(PointSetItem* item, const std::string& filename, std::ostream& os)
+static bool saveAsPCD(PointSetItem* item, const std::string& filename, std::ostream& os, PCDDataFormat dataFormat)
 {
     try {
-        cnoid::savePCD(item->pointSet(), filename, item->offsetPosition());
+        cnoid::savePCD(item->pointSet(), filename, item->offsetPosition(), dataFormat);
         return true;
     } catch (boost::exception& ex) {
         if(std::string const * message = boost::get_error_info<error_info_message>(ex)){
@@ -167,7 +167,11 @@ void PointSetItem::initializeClass(ExtensionManager* ext)
         im.addLoaderAndSaver<PointSetItem>(
             _("Point Cloud (PCD)"), "PCD-FILE", "pcd",
             boost::bind(::loadPCD, _1, _2, _3),
-            boost::bind(::saveAsPCD, _1, _2, _3),
+            boost::bind(::saveAsPCD, _1, _2, _3, PCD_ASCII),
+            ItemManager::PRIORITY_CONVERSION);
+        im.addSaver<PointSetItem>(
+            _("Point Cloud (Binary Compressed PCD)"), "PCD-BINARY-COMPRESSED-FILE", "pcd",
+            boost::bind(::saveAsPCD, _1, _2, _3, PCD_BINARY_COMPRESSED),
             ItemManager::PRIORITY_CONVERSION);
         
         initialized = true;
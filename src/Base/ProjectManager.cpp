@@ -48,7 +48,7 @@ public:
     template <class TObject>
     bool restoreObjectStates(Archive* projectArchive, Archive* states, const vector<TObject*>& objects);
         
-    void loadProject(const string& filename, bool isInvokingApplication);
+    bool loadProject(const string& filename, bool isInvokingApplication);
 
     template<class TObject>
     bool storeObjects(Archive& parentArchive, const char* key, vector<TObject*> objects);
@@ -82,6 +82,8 @@ public:
     typedef map<string, ArchiverInfo> ArchiverMap;
     typedef map<string, ArchiverMap> ArchiverMapMap;
     ArchiverMapMap archivers;
+
+    Signal<void(Archive& itemTreeArchive)> sigItemsAboutToBeRestored;
 };
 }
 
@@ -179,13 +181,13 @@ bool ProjectManagerImpl::restoreObjectStates
 }
 
 
-void ProjectManager::loadProject(const std::string& filename)
+bool ProjectManager::loadProject(const std::string& filename)
 {
-    impl->loadProject(filename, false);
+    return impl->loadProject(filename, false);
 }
 
 
-void ProjectManagerImpl::loadProject(const std::string& filename, bool isInvokingApplication)
+bool ProjectManagerImpl::loadProject(const std::string& filename, bool isInvokingApplication)
 {
     bool loaded = false;
     YAMLReader reader;
@@ -214,17 +216,20 @@ void ProjectManagerImpl::loadProject(const std::string& filename, bool isInvokin
 
             ViewManager::ViewStateInfo viewStateInfo = ViewManager::restoreViews(archive, "views");
 
+            // The main window does not exist in the programs running without the GUI
             MainWindow* mainWindow = MainWindow::instance();
-            if(isInvokingApplication){
-                if(perspectiveCheck->isChecked()){
-                    mainWindow->setInitialLayout(archive);
-                }
-                mainWindow->show();
-                messageView->flush();
-                mainWindow->repaint();
-            } else {
-                if(perspectiveCheck->isChecked()){
-                    mainWindow->restoreLayout(archive);
+            if(mainWindow){
+                if(isInvokingApplication){
+                    if(perspectiveCheck->isChecked()){
+                        mainWindow->setInitialLayout(archive);
+                    }
+                    mainWindow->show();
+                    messageView->flush();
+                    mainWindow->repaint();
+                } else {
+                    if(perspectiveCheck->isChecked()){
+                        mainWindow->restoreLayout(archive);
+                    }
                 }
             }
 
@@ -242,6 +247,7 @@ void ProjectManagerImpl::loadProject(const std::string& filename, bool isInvokin
             Archive* items = archive->findSubArchive("items");
             if(items->isValid()){
                 items->inheritSharedInfoFrom(*archive);
+                sigItemsAboutToBeRestored(*items);
                 itemTreeArchiver.restore(items, RootItem::mainInstance());
                 numArchivedItems = itemTreeArchiver.numArchivedItems();
                 numRestoredItems = itemTreeArchiver.numRestoredItems();
@@ -267,7 +273,7 @@ void ProjectManagerImpl::loadProject(const std::string& filename, bool isInvokin
             }
 
             Archive* barStates = archive->findSubArchive("toolbars");
-            if(barStates->isValid()){
+            if(barStates->isValid() && mainWindow){
                 vector<ToolBar*> toolBars;
                 mainWindow->getAllToolBars(toolBars);
                 if(restoreObjectStates(archive, barStates, toolBars)){
@@ -300,7 +306,9 @@ void ProjectManagerImpl::loadProject(const std::string& filename, bool isInvokin
             }
 
             if(loaded){
-                mainWindow->setProjectTitle(getBasename(filename));
+                if(mainWindow){
+                    mainWindow->setProjectTitle(getBasename(filename));
+                }
                 lastAccessedProjectFile = filename;
                 
                 if(numRestoredItems == numArchivedItems){
@@ -320,6 +328,8 @@ void ProjectManagerImpl::loadProject(const std::string& filename, bool isInvokin
         messageView->notify(str(fmt(_("Project \"%1%\" cannot be loaded.")) % filename));
         lastAccessedProjectFile.clear();
     }
+
+    return loaded;
 }
 
 
@@ -375,9 +385,11 @@ void ProjectManagerImpl::saveProject(const string& filename)
 
     bool stored = ViewManager::storeViewStates(archive, "views");
 
-    vector<ToolBar*> toolBars;
-    mainWindow->getAllToolBars(toolBars);
-    stored |= storeObjects(*archive, "toolbars", toolBars);
+    if(mainWindow){
+        vector<ToolBar*> toolBars;
+        mainWindow->getAllToolBars(toolBars);
+        stored |= storeObjects(*archive, "toolbars", toolBars);
+    }
 
     ArchiverMapMap::iterator p;
     for(p = archivers.begin(); p != archivers.end(); ++p){
@@ -407,7 +419,7 @@ void ProjectManagerImpl::saveProject(const string& filename)
         }
     }
 
-    if(perspectiveCheck->isChecked()){
+    if(perspectiveCheck->isChecked() && mainWindow){
         mainWindow->storeLayout(archive);
         stored = true;
     }
@@ -446,7 +458,13 @@ void ProjectManagerImpl::overwriteCurrentProject()
         openDialogToSaveProject();
     } else {
         saveProject(lastAccessedProjectFile);
-    } 
+    }
+}
+
+
+SignalProxy<void(Archive& itemTreeArchive)> ProjectManager::sigItemsAboutToBeRestored()
+{
+    return impl->sigItemsAboutToBeRestored;
 }
 
     
@@ -6,6 +6,7 @@
 #define CNOID_BASE_PROJECT_MANAGER_H_INCLUDED
 
 #include "Archive.h"
+#include <cnoid/Signal>
 #include <string>
 #include <boost/function.hpp>
 #include "exportdecl.h"
@@ -20,10 +21,20 @@ class CNOID_EXPORT ProjectManager
 public:
     static ProjectManager* instance();
         
-    void loadProject(const std::string& filename);
+    /**
+       @return true if the project has been loaded. The details of the errors are put into the message view.
+    */
+    bool loadProject(const std::string& filename);
     void saveProject(const std::string& filename);
     void overwriteCurrentProject();
 
+    /**
+       This signal is emitted just before the items of a project are restored.
+       A slot can prepare the data of the items in advance, such as loading the model files
+       in parallel, by scanning the given item tree archive.
+    */
+    SignalProxy<void(Archive& itemTreeArchive)> sigItemsAboutToBeRestored();
+
     static void initialize(ExtensionManager* em);
 
 private:
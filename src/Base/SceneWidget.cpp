@@ -127,7 +127,9 @@ public:
     CheckBox fpsCheck;
     PushButton fpsTestButton;
     CheckBox newDisplayListDoubleRenderingCheck;
+    CheckBox vertexBufferObjectCheck;
     CheckBox bufferForPickingCheck;
+    CheckBox rayCastPickingCheck;
 
     LazyCaller updateDefaultLightsLater;
 
@@ -311,7 +313,9 @@ public:
     void onEntityRemoved(SgNode* node);
 
     void onNewDisplayListDoubleRenderingToggled(bool on);
+    void onVertexBufferObjectToggled(bool on);
     void onBufferForPickingToggled(bool on);
+    void onRayCastPickingToggled(bool on);
         
     void updateLatestEvent(QKeyEvent* event);
     void updateLatestEvent(int x, int y, int modifiers);
@@ -768,6 +772,8 @@ void SceneWidgetImpl::renderFPS()
 {
     renderer.setColor(Vector4f(1.0f, 1.0f, 1.0f, 1.0f));
     renderText(20, 20, QString("FPS: %1").arg(fps));
+    renderText(20, 40, QString("Rendered: %1, Culled: %2")
+               .arg(renderer.numRenderedNodes()).arg(renderer.numCulledNodes()));
     fpsRendered = true;
     ++fpsCounter;
 }
@@ -960,6 +966,12 @@ void SceneWidgetImpl::onNewDisplayListDoubleRenderingToggled(bool on)
 }
 
 
+void SceneWidgetImpl::onVertexBufferObjectToggled(bool on)
+{
+    renderer.enableVertexBufferObject(on);
+}
+
+
 void SceneWidgetImpl::onBufferForPickingToggled(bool on)
 {
     if(!on){
@@ -972,6 +984,12 @@ void SceneWidgetImpl::onBufferForPickingToggled(bool on)
 }
 
 
+void SceneWidgetImpl::onRayCastPickingToggled(bool on)
+{
+    renderer.enableRayCastPicking(on);
+}
+
+
 void SceneWidgetImpl::updateLatestEvent(QKeyEvent* event)
 {
     latestEvent.modifiers_ = event->modifiers();
@@ -996,36 +1014,44 @@ void SceneWidgetImpl::updateLatestEvent(QMouseEvent* event)
 
 bool SceneWidgetImpl::updateLatestEventPath()
 {
-    if(setup->bufferForPickingCheck.isChecked()){
-        const QSize s = size();
-        if(buffer && (buffer->size() != s)){
-            buffer->makeCurrent();
-            delete buffer;
-            buffer = 0;
-        }
-        if(!buffer){
-            if(QGLPixelBuffer::hasOpenGLPbuffers()){
-                QGLFormat f = format();
-                f.setDoubleBuffer(false);
-                buffer = new QGLPixelBuffer(s, f, this);
+    bool picked;
+    
+    if(renderer.isRayCastPickingEnabled()){
+        // The ray casting does not need the OpenGL context
+        picked = renderer.pick(latestEvent.x(), latestEvent.y());
+
+    } else {
+        if(setup->bufferForPickingCheck.isChecked()){
+            const QSize s = size();
+            if(buffer && (buffer->size() != s)){
                 buffer->makeCurrent();
-                glEnable(GL_DEPTH_TEST);
+                delete buffer;
+                buffer = 0;
+            }
+            if(!buffer){
+                if(QGLPixelBuffer::hasOpenGLPbuffers()){
+                    QGLFormat f = format();
+                    f.setDoubleBuffer(false);
+                    buffer = new QGLPixelBuffer(s, f, this);
+                    buffer->makeCurrent();
+                    glEnable(GL_DEPTH_TEST);
+                }
             }
         }
-    }
 
-    if(buffer){
-        buffer->makeCurrent();
-    } else {
-        QGLWidget::makeCurrent();
-    }
+        if(buffer){
+            buffer->makeCurrent();
+        } else {
+            QGLWidget::makeCurrent();
+        }
 
-    bool picked = renderer.pick(latestEvent.x(), latestEvent.y());
+        picked = renderer.pick(latestEvent.x(), latestEvent.y());
 
-    if(buffer){
-        buffer->doneCurrent();
-    } else if(SHOW_IMAGE_FOR_PICKING){
-        swapBuffers();
+        if(buffer){
+            buffer->doneCurrent();
+        } else if(SHOW_IMAGE_FOR_PICKING){
+            swapBuffers();
+        }
     }
 
     latestEvent.nodePath_.clear();
@@ -2218,12 +2244,24 @@ void SceneWidget::setNewDisplayListDoubleRenderingEnabled(bool on)
 }
 
 
+void SceneWidget::setVertexBufferObjectEnabled(bool on)
+{
+    impl->setup->vertexBufferObjectCheck.setChecked(on);
+}
+
+
 void SceneWidget::setUseBufferForPicking(bool on)
 {
     impl->setup->bufferForPickingCheck.setChecked(on);
 }
 
 
+void SceneWidget::setRayCastPickingEnabled(bool on)
+{
+    impl->setup->rayCastPickingCheck.setChecked(on);
+}
+
+
 void SceneWidget::setBackgroundColor(const Vector3& color)
 {
     impl->renderer.setBackgroundColor(color.cast<float>());
@@ -2771,6 +2809,13 @@ SetupDialog::SetupDialog(SceneWidgetImpl* impl)
     hbox->addStretch();
     vbox->addLayout(hbox);
 
+    hbox = new QHBoxLayout();
+    vertexBufferObjectCheck.setText(_("Use vertex buffer objects instead of display lists"));
+    vertexBufferObjectCheck.sigToggled().connect(boost::bind(&SceneWidgetImpl::onVertexBufferObjectToggled, impl, _1));
+    hbox->addWidget(&vertexBufferObjectCheck);
+    hbox->addStretch();
+    vbox->addLayout(hbox);
+
     hbox = new QHBoxLayout();
     bufferForPickingCheck.setText(_("Use an OpenGL pixel buffer for picking"));
     bufferForPickingCheck.setChecked(true);
@@ -2779,6 +2824,13 @@ SetupDialog::SetupDialog(SceneWidgetImpl* impl)
     hbox->addStretch();
     vbox->addLayout(hbox);
 
+    hbox = new QHBoxLayout();
+    rayCastPickingCheck.setText(_("Pick objects by ray casting without rendering (the grids are not picked)"));
+    rayCastPickingCheck.sigToggled().connect(boost::bind(&SceneWidgetImpl::onRayCastPickingToggled, impl, _1));
+    hbox->addWidget(&rayCastPickingCheck);
+    hbox->addStretch();
+    vbox->addLayout(hbox);
+
     topVBox->addLayout(vbox);
 
     topVBox->addWidget(new HSeparator());
@@ -2819,7 +2871,9 @@ void SetupDialog::storeState(Archive& archive)
     archive.write("coordinateAxes", coordinateAxesCheck.isChecked());
     archive.write("showFPS", fpsCheck.isChecked());
     archive.write("enableNewDisplayListDoubleRendering", newDisplayListDoubleRenderingCheck.isChecked());
+    archive.write("useVertexBufferObjects", vertexBufferObjectCheck.isChecked());
     archive.write("useBufferForPicking", bufferForPickingCheck.isChecked());
+    archive.write("useRayCastPicking", rayCastPickingCheck.isChecked());
 }
 
 
@@ -2849,5 +2903,7 @@ void SetupDialog::restoreState(const Archive& archive)
     coordinateAxesCheck.setChecked(archive.get("coordinateAxes", coordinateAxesCheck.isChecked()));
     fpsCheck.setChecked(archive.get("showFPS", fpsCheck.isChecked()));
     newDisplayListDoubleRenderingCheck.setChecked(archive.get("enableNewDisplayListDoubleRendering", newDisplayListDoubleRenderingCheck.isChecked()));
+    vertexBufferObjectCheck.setChecked(archive.get("useVertexBufferObjects", vertexBufferObjectCheck.isChecked()));
     bufferForPickingCheck.setChecked(archive.get("useBufferForPicking", bufferForPickingCheck.isChecked()));
+    rayCastPickingCheck.setChecked(archive.get("useRayCastPicking", rayCastPickingCheck.isChecked()));
 }
@@ -85,7 +85,9 @@ public:
     void setCoordinateAxes(bool on);
     void setShowFPS(bool on);
     void setNewDisplayListDoubleRenderingEnabled(bool on);
+    void setVertexBufferObjectEnabled(bool on);
     void setUseBufferForPicking(bool on);
+    void setRayCastPickingEnabled(bool on);
        
     void setBackgroundColor(const Vector3& color);
     void setColor(const Vector4& color);
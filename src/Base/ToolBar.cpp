@@ -107,8 +107,10 @@ ToolBar::ToolBar(const QString& title)
     layoutPriority = 0;
     isStretchable_ = false;
 
-    connect(mainWindow, SIGNAL(iconSizeChanged(const QSize&)),
-            this, SLOT(changeIconSize(const QSize&)));
+    if(mainWindow){
+        connect(mainWindow, SIGNAL(iconSizeChanged(const QSize&)),
+                this, SLOT(changeIconSize(const QSize&)));
+    }
 }
 
 
@@ -165,7 +167,9 @@ ToolButton* ToolBar::addButton(const QIcon& icon, const QString& tooltip)
         button->setStyle(&cleanlooks);
     }
 #endif
-    button->setIconSize(mainWindow->iconSize());
+    if(mainWindow){
+        button->setIconSize(mainWindow->iconSize());
+    }
     button->setIcon(icon);
     button->setAutoRaise(true);
     button->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Expanding);
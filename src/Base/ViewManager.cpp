@@ -111,7 +111,7 @@ public:
             View* view = createView();
             view->setName(defaultInstanceName);
             view->setWindowTitle(translatedDefaultInstanceName.c_str());
-            if(doMountCreatedView){
+            if(doMountCreatedView && mainWindow){
                 mainWindow->viewArea()->addView(view);
             }
         }
@@ -144,7 +144,7 @@ public:
         View* view = findView(name);
         if(!view){
             view = createView(name);
-            if(doMountCreatedView){
+            if(doMountCreatedView && mainWindow){
                 mainWindow->viewArea()->addView(view);
             }
         }
@@ -396,23 +396,27 @@ void ViewManager::initializeClass(ExtensionManager* ext)
     if(!initialized){
         
         mainWindow = MainWindow::instance();
-        MenuManager& mm = ext->menuManager();
-        QWidget* viewMenu = mm.setPath("/View").current();
-
-        QAction* showViewAction = mm.findItem("Show View");
-        showViewMenu = new Menu(viewMenu);
-        showViewMenu->sigAboutToShow().connect(boost::bind(onViewMenuAboutToShow, showViewMenu));
-        showViewAction->setMenu(showViewMenu);
-
-        QAction* createViewAction = mm.setCurrent(viewMenu).findItem("Create View");
-        createViewMenu = new Menu(viewMenu);
-        createViewMenu->sigAboutToShow().connect(boost::bind(onViewMenuAboutToShow, createViewMenu));
-        createViewAction->setMenu(createViewMenu);
-
-        QAction* deleteViewAction = mm.setCurrent(viewMenu).findItem("Delete View");
-        deleteViewMenu = new Menu(viewMenu);
-        deleteViewMenu->sigAboutToShow().connect(boost::bind(onViewMenuAboutToShow, deleteViewMenu));
-        deleteViewAction->setMenu(deleteViewMenu);
+
+        // The views are not mounted and the view menus are not available without the main window
+        if(mainWindow){
+            MenuManager& mm = ext->menuManager();
+            QWidget* viewMenu = mm.setPath("/View").current();
+
+            QAction* showViewAction = mm.findItem("Show View");
+            showViewMenu = new Menu(viewMenu);
+            showViewMenu->sigAboutToShow().connect(boost::bind(onViewMenuAboutToShow, showViewMenu));
+            showViewAction->setMenu(showViewMenu);
+
+            QAction* createViewAction = mm.setCurrent(viewMenu).findItem("Create View");
+            createViewMenu = new Menu(viewMenu);
+            createViewMenu->sigAboutToShow().connect(boost::bind(onViewMenuAboutToShow, createViewMenu));
+            createViewAction->setMenu(createViewMenu);
+
+            QAction* deleteViewAction = mm.setCurrent(viewMenu).findItem("Delete View");
+            deleteViewMenu = new Menu(viewMenu);
+            deleteViewMenu->sigAboutToShow().connect(boost::bind(onViewMenuAboutToShow, deleteViewMenu));
+            deleteViewAction->setMenu(deleteViewMenu);
+        }
         
         initialized = true;
     }
@@ -474,7 +478,9 @@ View* ViewManager::registerClassSub
 
     if(itype == ViewManager::SINGLE_DEFAULT || itype == ViewManager::MULTI_DEFAULT){
         View* view = info->getOrCreateView();
-        mainWindow->viewArea()->addView(view);
+        if(mainWindow){
+            mainWindow->viewArea()->addView(view);
+        }
         return view;
     }
     return 0;
@@ -771,7 +777,7 @@ ViewManager::ViewStateInfo ViewManager::restoreViews(ArchivePtr archive, const s
                             viewsToRestoreState->push_back(ViewState(view, state));
                         }
 
-                        if(viewArchive->get("mounted", false)){
+                        if(viewArchive->get("mounted", false) && mainWindow){
                             mainWindow->viewArea()->addView(view);
                         }
                     }
@@ -16,8 +16,6 @@ namespace {
 
 const bool PUT_DEBUG_MESSAGE = true;
 
-bool pluginsInDefaultDirectoriesLoaded = false;
-
 #ifndef uint
 typedef unsigned int uint;
 #endif
@@ -84,13 +82,18 @@ void Body::initialize()
 
 Body::Body(const Body& org)
 {
+    initialize();
     copy(org);
 }
 
 
 void Body::copy(const Body& org)
 {
-    initialize();
+    if(impl->customizerInterface){
+        impl->installCustomizer(0);
+    }
+    clearDevices();
+    extraJoints_.clear();
 
     impl->centerOfMass = org.impl->centerOfMass;
     impl->mass = org.impl->mass;
@@ -511,10 +514,8 @@ void Body::setVirtualJointForces()
 */
 bool Body::installCustomizer()
 {
-    if(!pluginsInDefaultDirectoriesLoaded){
-        loadBodyCustomizers(bodyInterface());
-        pluginsInDefaultDirectoriesLoaded = true;
-    }
+    // This only loads the customizers in the default directories at the first call
+    loadBodyCustomizers(bodyInterface());
 		
     BodyCustomizerInterface* interface = findBodyCustomizer(impl->modelName);
 
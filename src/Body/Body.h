@@ -235,7 +235,10 @@ public:
     static void addCustomizerDirectory(const std::string& path);
     static BodyInterface* bodyInterface();
 
-protected:
+    /**
+       Replaces the contents of this body with the copy of the org body.
+       The links are created by createLink() so that the link type of this body is kept.
+    */
     void copy(const Body& org);
 
 private:
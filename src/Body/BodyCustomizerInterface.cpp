@@ -16,6 +16,8 @@
 #include <cstdlib>
 #include <iostream>
 #include <boost/tokenizer.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/locks.hpp>
 
 using namespace cnoid;
 using namespace std;
@@ -51,6 +53,9 @@ NameToInterfaceMap customizerRepository;
 bool pluginLoadingFunctionsCalled = false;
 
 set<string> customizerDirectories;
+
+// The customizers may be installed by the bodies loaded in several threads
+boost::recursive_mutex customizerMutex;
 }
 
 
@@ -125,6 +130,8 @@ static bool loadCustomizerDll(BodyInterface* bodyInterface, const std::string fi
 */
 int cnoid::loadBodyCustomizers(const std::string pathString, BodyInterface* bodyInterface)
 {
+    boost::lock_guard<boost::recursive_mutex> lock(customizerMutex);
+    
     pluginLoadingFunctionsCalled = true;
 	
     int numLoaded = 0;
@@ -170,6 +177,8 @@ int cnoid::loadBodyCustomizers(const std::string pathString)
 */
 int cnoid::loadBodyCustomizers(BodyInterface* bodyInterface)
 {
+    boost::lock_guard<boost::recursive_mutex> lock(customizerMutex);
+    
     int numLoaded = 0;
 
     if(!pluginLoadingFunctionsCalled){
@@ -218,6 +227,8 @@ int cnoid::loadBodyCustomizers()
 
 BodyCustomizerInterface* cnoid::findBodyCustomizer(std::string modelName)
 {
+    boost::lock_guard<boost::recursive_mutex> lock(customizerMutex);
+    
     BodyCustomizerInterface* customizerInterface = 0;
 
     NameToInterfaceMap::iterator p = customizerRepository.find(modelName);
@@ -231,5 +242,6 @@ BodyCustomizerInterface* cnoid::findBodyCustomizer(std::string modelName)
 
 void Body::addCustomizerDirectory(const std::string& path)
 {
+    boost::lock_guard<boost::recursive_mutex> lock(customizerMutex);
     customizerDirectories.insert(path);
 }
@@ -11,9 +11,11 @@
 #include <cnoid/YAMLReader>
 #include <cnoid/FileUtil>
 #include <cnoid/NullOut>
+#include <cnoid/SceneGraph>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/make_shared.hpp>
+#include <ctime>
 #include "gettext.h"
 
 using namespace std;
@@ -71,6 +73,58 @@ AbstractBodyLoaderPtr stlBodyLoaderFactory()
     return boost::make_shared<SceneLoaderAdapter>(new STLSceneLoader);
 }
 
+
+struct BodyPrototype
+{
+    BodyPtr body;
+    string modelFilename;
+    std::time_t fileTime;
+    std::time_t modelFileTime;
+    boost::uintmax_t fileSize;
+    boost::uintmax_t modelFileSize;
+    unsigned long lastUseCount;
+};
+typedef map<string, BodyPrototype> BodyPrototypeMap;
+BodyPrototypeMap bodyPrototypeMap;
+int maxNumBodyPrototypes = 32;
+unsigned long bodyPrototypeUseCounter = 0;
+boost::mutex bodyPrototypeMapMutex;
+
+/**
+   The file size is also checked because the resolution of the last write time is one second.
+*/
+bool getFileStatus(const string& filename, std::time_t& out_time, boost::uintmax_t& out_size)
+{
+    boost::system::error_code ec;
+    filesystem::path path(filename);
+    out_time = filesystem::last_write_time(path, ec);
+    if(!ec){
+        out_size = filesystem::file_size(path, ec);
+    }
+    return !ec;
+}
+
+/**
+   A file updated within the last write time resolution may be updated again without changing its status,
+   so such a file is not cached.
+*/
+bool isFileTimeSettled(std::time_t fileTime)
+{
+    return (std::time(0) - fileTime) >= 2;
+}
+
+void removeLeastRecentlyUsedBodyPrototypes(int maxNumPrototypes)
+{
+    while(bodyPrototypeMap.size() > (size_t)std::max(maxNumPrototypes, 0)){
+        BodyPrototypeMap::iterator lru = bodyPrototypeMap.begin();
+        for(BodyPrototypeMap::iterator p = lru; p != bodyPrototypeMap.end(); ++p){
+            if(p->second.lastUseCount < lru->second.lastUseCount){
+                lru = p;
+            }
+        }
+        bodyPrototypeMap.erase(lru);
+    }
+}
     
 struct FactoryRegistration
 {
@@ -103,6 +157,7 @@ public:
     bool isShapeLoadingEnabled;
     int defaultDivisionNumber;
     double defaultCreaseAngle;
+    bool isPrototypeCacheEnabled;
 
     typedef map<string, AbstractBodyLoaderPtr> LoaderMap;
     LoaderMap loaderMap;
@@ -110,6 +165,8 @@ public:
     BodyLoaderImpl();
     ~BodyLoaderImpl();
     bool load(BodyPtr& body, const std::string& filename);
+    bool loadWithoutCache(BodyPtr& body, const std::string& filename, string& out_modelFilename);
+    string getPrototypeKey(const std::string& filename);
 };
 }
 
@@ -127,6 +184,7 @@ BodyLoaderImpl::BodyLoaderImpl()
     isShapeLoadingEnabled = true;
     defaultDivisionNumber = -1;
     defaultCreaseAngle = -1.0;
+    isPrototypeCacheEnabled = false;
 }
 
 
@@ -178,6 +236,41 @@ void BodyLoader::setDefaultCreaseAngle(double theta)
 }
 
 
+void BodyLoader::setPrototypeCacheEnabled(bool on)
+{
+    impl->isPrototypeCacheEnabled = on;
+}
+
+
+void BodyLoader::setMaxNumPrototypes(int n)
+{
+    boost::lock_guard<boost::mutex> lock(bodyPrototypeMapMutex);
+    maxNumBodyPrototypes = n;
+    removeLeastRecentlyUsedBodyPrototypes(n);
+}
+
+
+int BodyLoader::maxNumPrototypes()
+{
+    boost::lock_guard<boost::mutex> lock(bodyPrototypeMapMutex);
+    return maxNumBodyPrototypes;
+}
+
+
+int BodyLoader::numPrototypes()
+{
+    boost::lock_guard<boost::mutex> lock(bodyPrototypeMapMutex);
+    return bodyPrototypeMap.size();
+}
+
+
+void BodyLoader::clearPrototypeCache()
+{
+    boost::lock_guard<boost::mutex> lock(bodyPrototypeMapMutex);
+    bodyPrototypeMap.clear();
+}
+
+
 bool BodyLoader::load(BodyPtr body, const std::string& filename)
 {
     return impl->load(body, filename);
@@ -194,13 +287,90 @@ BodyPtr BodyLoader::load(const std::string& filename)
 }
 
 
+string BodyLoaderImpl::getPrototypeKey(const std::string& filename)
+{
+    return str(boost::format("%1%:%2%:%3%:%4%")
+               % getAbsolutePathString(filesystem::path(filename))
+               % isShapeLoadingEnabled % defaultDivisionNumber % defaultCreaseAngle);
+}
+
+
 bool BodyLoaderImpl::load(BodyPtr& body, const std::string& filename)
+{
+    if(!isPrototypeCacheEnabled){
+        string modelFilename;
+        return loadWithoutCache(body, filename, modelFilename);
+    }
+
+    const string key = getPrototypeKey(filename);
+    std::time_t fileTime;
+    std::time_t modelFileTime;
+    boost::uintmax_t fileSize;
+    boost::uintmax_t modelFileSize;
+    
+    if(getFileStatus(filename, fileTime, fileSize)){
+        BodyPtr prototype;
+        {
+            boost::lock_guard<boost::mutex> lock(bodyPrototypeMapMutex);
+            BodyPrototypeMap::iterator p = bodyPrototypeMap.find(key);
+            if(p != bodyPrototypeMap.end()){
+                BodyPrototype& entry = p->second;
+                if(entry.fileTime == fileTime && entry.fileSize == fileSize &&
+                   getFileStatus(entry.modelFilename, modelFileTime, modelFileSize) &&
+                   entry.modelFileTime == modelFileTime && entry.modelFileSize == modelFileSize){
+                    prototype = entry.body;
+                    entry.lastUseCount = ++bodyPrototypeUseCounter;
+                } else {
+                    bodyPrototypeMap.erase(p);
+                }
+            }
+        }
+        if(prototype){
+            body->copy(*prototype);
+            SgCloneMap cloneMap;
+            cloneMap.setNonNodeCloning(false);
+            body->cloneShapes(cloneMap);
+            return true;
+        }
+    }
+
+    string modelFilename;
+    if(!loadWithoutCache(body, filename, modelFilename)){
+        return false;
+    }
+
+    // The file status is checked again so that a file updated while it is loaded is not cached
+    std::time_t loadedFileTime;
+    boost::uintmax_t loadedFileSize;
+    if(getFileStatus(filename, loadedFileTime, loadedFileSize) &&
+       loadedFileTime == fileTime && loadedFileSize == fileSize && isFileTimeSettled(fileTime) &&
+       getFileStatus(modelFilename, modelFileTime, modelFileSize) && isFileTimeSettled(modelFileTime)){
+        BodyPrototype entry;
+        entry.body = new Body(*body);
+        SgCloneMap cloneMap;
+        cloneMap.setNonNodeCloning(false);
+        entry.body->cloneShapes(cloneMap);
+        entry.modelFilename = modelFilename;
+        entry.fileTime = fileTime;
+        entry.modelFileTime = modelFileTime;
+        entry.fileSize = fileSize;
+        entry.modelFileSize = modelFileSize;
+        boost::lock_guard<boost::mutex> lock(bodyPrototypeMapMutex);
+        entry.lastUseCount = ++bodyPrototypeUseCounter;
+        bodyPrototypeMap[key] = entry;
+        removeLeastRecentlyUsedBodyPrototypes(maxNumBodyPrototypes);
+    }
+    
+    return true;
+}
+
+
+bool BodyLoaderImpl::loadWithoutCache(BodyPtr& body, const std::string& filename, string& modelFilename)
 {
     bool result = false;
 
     filesystem::path orgpath(filename);
     string ext = getExtension(orgpath);
-    string modelFilename;
     MappingPtr info;
 
     try {
@@ -31,6 +31,24 @@ public:
     BodyPtr load(const std::string& filename);
     AbstractBodyLoaderPtr lastActualBodyLoader() const;
 
+    /**
+       When this is enabled, the loaded models are kept as the prototypes shared by all the loaders
+       in the process. A model file which has already been loaded with the same options is not parsed
+       again unless the file is updated, and the links and the scene graph of the prototype are cloned
+       instead. The mesh data of the scene graph are shared with the prototype.
+       This is disabled by default.
+    */
+    void setPrototypeCacheEnabled(bool on);
+
+    /**
+       The least recently used prototypes are removed when the number of them exceeds this.
+       The default value is 32.
+    */
+    static void setMaxNumPrototypes(int n);
+    static int maxNumPrototypes();
+    static int numPrototypes();
+    static void clearPrototypeCache();
+
 private:
     BodyLoaderImpl* impl;
 };
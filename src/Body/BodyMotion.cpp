@@ -10,12 +10,145 @@
 #include <cnoid/Vector3Seq>
 #include <cnoid/YAMLReader>
 #include <cnoid/YAMLWriter>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/format.hpp>
+#include <fstream>
+#include <cstring>
 
 using namespace std;
 using namespace cnoid;
+using boost::uint32_t;
 
 namespace {
 //bool TRACE_FUNCTIONS = false;
+
+/*
+  The binary format consists of the following header and components.
+  The values are stored in the byte order of the machine which writes the file,
+  and the byte order mark is used to detect a file written in the different byte order.
+
+  Header:
+    char[8]  "CNOIDBMB"
+    uint32   version
+    uint32   byte order mark (0x01020304)
+    uint32   number of components
+
+  Component:
+    string   seq type ("MultiValueSeq", "MultiSE3Seq" or "Vector3Seq")
+    string   content ("JointPosition", "LinkPosition", "ZMP" or "RelativeZMP")
+    double   frame rate
+    uint32   number of frames
+    uint32   number of parts
+    uint32   number of scalar values per element (1, 7 (XYZQWQXQYQZ) or 3)
+    uint32   scalar size (4 for float or 8 for double)
+    string   part label x number of parts
+    padding  to the 8 byte boundary from the top of the file
+    scalar   values x frames x parts x elements
+
+  A string is stored as the uint32 length followed by the characters.
+*/
+
+const char binaryFormatSignature[] = "CNOIDBMB";
+const uint32_t binaryFormatVersion = 1;
+const uint32_t byteOrderMark = 0x01020304;
+
+class BinaryMotionWriter
+{
+public:
+    ofstream os;
+    bool isSinglePrecision;
+
+    template<typename T> void write(const T& value) {
+        os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void writeString(const string& s) {
+        write<uint32_t>(s.size());
+        os.write(s.data(), s.size());
+    }
+
+    void writeScalar(double value) {
+        if(isSinglePrecision){
+            write<float>(value);
+        } else {
+            write<double>(value);
+        }
+    }
+
+    void writeComponentHeader(
+        const string& type, const string& content, double frameRate,
+        int numFrames, int numParts, int numElements, const AbstractMultiSeq* multiSeq) {
+        
+        writeString(type);
+        writeString(content);
+        write<double>(frameRate);
+        write<uint32_t>(numFrames);
+        write<uint32_t>(numParts);
+        write<uint32_t>(numElements);
+        write<uint32_t>(isSinglePrecision ? sizeof(float) : sizeof(double));
+        for(int i=0; i < numParts; ++i){
+            writeString(multiSeq ? multiSeq->partLabel(i) : string());
+        }
+        const int padding = (8 - (static_cast<long>(os.tellp()) % 8)) % 8;
+        for(int i=0; i < padding; ++i){
+            os.put(0);
+        }
+    }
+};
+
+class BinaryMotionReader
+{
+public:
+    const char* current;
+    const char* end;
+    int scalarSize;
+
+    template<typename T> bool read(T& out_value) {
+        if(end - current < (ptrdiff_t)sizeof(T)){
+            return false;
+        }
+        memcpy(&out_value, current, sizeof(T));
+        current += sizeof(T);
+        return true;
+    }
+
+    bool readString(string& out_string) {
+        uint32_t size;
+        if(!read(size) || (uint32_t)(end - current) < size){
+            return false;
+        }
+        out_string.assign(current, size);
+        current += size;
+        return true;
+    }
+
+    void align(const char* top) {
+        current += (8 - ((current - top) % 8)) % 8;
+    }
+
+    bool hasValues(int numFrames, int numParts, int numElements) const {
+        return (end - current) >= (ptrdiff_t)numFrames * numParts * numElements * scalarSize;
+    }
+
+    /**
+       The frames are copied from the mapped memory without any parsing
+    */
+    void readScalars(double* out_values, int n) {
+        if(scalarSize == sizeof(double)){
+            memcpy(out_values, current, n * sizeof(double));
+            current += n * sizeof(double);
+        } else {
+            for(int i=0; i < n; ++i){
+                float value;
+                memcpy(&value, current, sizeof(float));
+                out_values[i] = value;
+                current += sizeof(float);
+            }
+        }
+    }
+};
+
 }
 
 
@@ -151,19 +284,212 @@ void BodyMotion::setExtraSeq(AbstractSeqPtr seq)
 }
 
 
+namespace cnoid {
+
+/**
+   This class reads the frames of the components directly from the YAML parser
+   so that the nodes of the individual numbers are not created.
+   A component is read in this way when its type, content, frame rate, number of parts
+   and format precede the frames. Otherwise its frames are loaded into the document.
+*/
+class BodyMotionFramesReceiver : public YAMLReader::NumericListingReceiver
+{
+public:
+    struct Component {
+        AbstractSeq* seq;
+        string message;
+    };
+    typedef map<const Mapping*, Component> ComponentMap;
+    ComponentMap components;
+
+    BodyMotionFramesReceiver(BodyMotion& motion) : motion(motion) { }
+
+    virtual bool startListing(const Mapping& mapping);
+    virtual void putElement(const double* values, int size, const std::vector<int>& subElementSizes);
+    virtual void endListing();
+
+private:
+    enum TargetType { JOINT_POSITION, LINK_POSITION, VECTOR3 };
+
+    BodyMotion& motion;
+    TargetType targetType;
+    Component* current;
+    MultiValueSeq* valueSeq;
+    MultiSE3Seq* se3Seq;
+    Vector3Seq* vector3Seq;
+    int numParts;
+    bool isWfirst;
+    int frameIndex;
+    int numAllocatedFrames;
+};
+
+}
+
+
+bool BodyMotionFramesReceiver::startListing(const Mapping& mapping)
+{
+    string type;
+    string content;
+    double frameRate;
+    
+    if(!mapping.read("type", type) || !mapping.read("frameRate", frameRate)){
+        return false;
+    }
+    if(!mapping.read("content", content)){
+        mapping.read("purpose", content);
+    }
+
+    AbstractSeq* seq;
+    
+    if(type == "MultiValueSeq" && content == "JointPosition"){
+        if(!mapping.read("numParts", numParts)){
+            return false;
+        }
+        valueSeq = motion.jointPosSeq().get();
+        valueSeq->setDimension(0, numParts);
+        targetType = JOINT_POSITION;
+        seq = valueSeq;
+
+    } else if((type == "MultiSE3Seq" || type == "MultiSe3Seq" || type == "MultiAffine3Seq")
+              && content == "LinkPosition"){
+        string format;
+        if(!mapping.read("numParts", numParts) || !mapping.read("format", format)){
+            return false;
+        }
+        if(format == "XYZQWQXQYQZ"){
+            isWfirst = true;
+        } else if(format == "XYZQXQYQZQW"){
+            isWfirst = false;
+        } else {
+            return false;
+        }
+        se3Seq = motion.linkPosSeq().get();
+        se3Seq->setDimension(0, numParts);
+        targetType = LINK_POSITION;
+        seq = se3Seq;
+
+    } else if(type == "Vector3Seq"){
+        bool isRelativeZmp = false;
+        if(content == "RelativeZMP" || content == "RelativeZmp"){
+            isRelativeZmp = true;
+        } else if(content != "ZMP"){
+            return false;
+        }
+        ZMPSeqPtr zmpSeq = motion.getOrCreateExtraSeq<ZMPSeq>("ZMP");
+        if(isRelativeZmp){
+            zmpSeq->setRootRelative(true);
+        }
+        vector3Seq = zmpSeq.get();
+        vector3Seq->setNumFrames(0);
+        targetType = VECTOR3;
+        seq = vector3Seq;
+
+    } else {
+        return false;
+    }
+
+    seq->setFrameRate(frameRate);
+
+    current = &components[&mapping];
+    current->seq = seq;
+    frameIndex = 0;
+    numAllocatedFrames = 0;
+
+    int numFrames;
+    if(mapping.read("numFrames", numFrames) && numFrames > 0){
+        seq->setNumFrames(numFrames);
+        numAllocatedFrames = numFrames;
+    }
+
+    return true;
+}
+
+
+void BodyMotionFramesReceiver::putElement(const double* values, int size, const std::vector<int>& subElementSizes)
+{
+    if(!current->message.empty()){
+        return;
+    }
+    if(frameIndex >= numAllocatedFrames){
+        numAllocatedFrames = std::max(numAllocatedFrames * 2, 256);
+        current->seq->setNumFrames(numAllocatedFrames);
+    }
+
+    if(targetType == JOINT_POSITION){
+        MultiValueSeq::Frame frame = valueSeq->frame(frameIndex);
+        const int n = std::min(size, numParts);
+        std::copy(values, values + n, frame.begin());
+        std::fill(frame.begin() + n, frame.end(), 0.0);
+
+    } else if(targetType == LINK_POSITION){
+        const int numLinks = subElementSizes.size();
+        bool isValid = (size == numLinks * 7);
+        for(int i=0; isValid && i < numLinks; ++i){
+            isValid = (subElementSizes[i] == 7);
+        }
+        if(!isValid){
+            current->message =
+                str(boost::format("Frame %1% of LinkPosition does not consist of the 7 values of the links.")
+                    % frameIndex);
+            return;
+        }
+        MultiSE3Seq::Frame frame = se3Seq->frame(frameIndex);
+        const int n = std::min(numLinks, numParts);
+        std::fill(frame.begin() + n, frame.end(), SE3(Vector3::Zero(), Quat::Identity()));
+        for(int i=0; i < n; ++i){
+            const double* v = values + i * 7;
+            SE3& x = frame[i];
+            x.translation() << v[0], v[1], v[2];
+            if(isWfirst){
+                x.rotation() = Quat(v[3], v[4], v[5], v[6]);
+            } else {
+                x.rotation() = Quat(v[6], v[3], v[4], v[5]);
+            }
+        }
+
+    } else if(targetType == VECTOR3){
+        if(size < 3){
+            current->message =
+                str(boost::format("Frame %1% of Vector3Seq does not have three values.") % frameIndex);
+            return;
+        }
+        (*vector3Seq)[frameIndex] << values[0], values[1], values[2];
+    }
+
+    ++frameIndex;
+}
+
+
+void BodyMotionFramesReceiver::endListing()
+{
+    current->seq->setNumFrames(frameIndex);
+}
+
+
+/**
+   The frames of the components are read by BodyMotionFramesReceiver while the file is parsed.
+*/
 bool BodyMotion::loadStandardYAMLformat(const std::string& filename)
 {
     bool result = false;
     clearSeqMessage();
+    setDimension(0, 1, 1);
+
     YAMLReader reader;
     reader.expectRegularMultiListing();
+    BodyMotionFramesReceiver framesReceiver(*this);
+    reader.setNumericListingReceiver("frames", &framesReceiver);
     
     try {
-        result = read(*reader.loadDocument(filename)->toMapping());
+        result = readComponents(*reader.loadDocument(filename)->toMapping(), &framesReceiver);
     } catch(const ValueNode::Exception& ex){
         addSeqMessage(ex.message());
     }
 
+    if(!result){
+        setDimension(0, 1, 1);
+    }
+
     return result;
 }
 
@@ -171,7 +497,12 @@ bool BodyMotion::loadStandardYAMLformat(const std::string& filename)
 bool BodyMotion::read(const Mapping& archive)
 {
     setDimension(0, 1, 1);
+    return readComponents(archive, 0);
+}
+
 
+bool BodyMotion::readComponents(const Mapping& archive, BodyMotionFramesReceiver* framesReceiver)
+{
     bool result = true;
     bool loaded = false;
     ZMPSeqPtr zmpSeq;
@@ -190,6 +521,22 @@ bool BodyMotion::read(const Mapping& archive)
                 if(!component.read("content", content)){
                     component.read("purpose", content);
                 }
+                if(framesReceiver){
+                    BodyMotionFramesReceiver::ComponentMap::iterator p =
+                        framesReceiver->components.find(&component);
+                    if(p != framesReceiver->components.end()){
+                        const BodyMotionFramesReceiver::Component& received = p->second;
+                        if(!received.message.empty()){
+                            addSeqMessage(received.message);
+                            result = false;
+                            break;
+                        }
+                        if(received.seq == jointPosSeq_.get() || received.seq == linkPosSeq_.get()){
+                            loaded = true;
+                        }
+                        continue;
+                    }
+                }
                 if(type == "MultiValueSeq" && content == "JointPosition"){
                     result &= jointPosSeq_->readSeq(component);
                     if(result){
@@ -292,6 +639,212 @@ bool BodyMotion::saveAsStandardYAMLformat(const std::string& filename)
 }
 
 
+/**
+   Save the motion in the binary format, which can be loaded much faster than the YAML format.
+   The joint positions, link positions and ZMP are saved and the other extra seqs are ignored.
+   @param useSinglePrecision The values are stored as float instead of double when this is true.
+*/
+bool BodyMotion::saveAsBinaryFormat(const std::string& filename, bool useSinglePrecision)
+{
+    clearSeqMessage();
+
+    BinaryMotionWriter writer;
+    writer.isSinglePrecision = useSinglePrecision;
+    writer.os.open(filename.c_str(), ios::out | ios::binary);
+    if(!writer.os){
+        addSeqMessage(filename + " cannot be opened.");
+        return false;
+    }
+
+    ZMPSeqPtr zmpSeq = extraSeq<ZMPSeq>(ZMPSeq::key());
+    if(zmpSeq && zmpSeq->numFrames() == 0){
+        zmpSeq.reset();
+    }
+    const int numJointPosFrames = jointPosSeq_->numFrames();
+    const int numLinkPosFrames = linkPosSeq_->numFrames();
+
+    writer.os.write(binaryFormatSignature, 8);
+    writer.write<uint32_t>(binaryFormatVersion);
+    writer.write<uint32_t>(byteOrderMark);
+    writer.write<uint32_t>((numJointPosFrames > 0) + (numLinkPosFrames > 0) + (zmpSeq ? 1 : 0));
+
+    if(numJointPosFrames > 0){
+        const int numParts = jointPosSeq_->numParts();
+        writer.writeComponentHeader(
+            "MultiValueSeq", "JointPosition", jointPosSeq_->frameRate(),
+            numJointPosFrames, numParts, 1, jointPosSeq_.get());
+        for(int i=0; i < numJointPosFrames; ++i){
+            MultiValueSeq::Frame frame = jointPosSeq_->frame(i);
+            if(useSinglePrecision){
+                for(int j=0; j < numParts; ++j){
+                    writer.writeScalar(frame[j]);
+                }
+            } else {
+                writer.os.write(reinterpret_cast<const char*>(frame.begin()), numParts * sizeof(double));
+            }
+        }
+    }
+
+    if(numLinkPosFrames > 0){
+        const int numParts = linkPosSeq_->numParts();
+        writer.writeComponentHeader(
+            "MultiSE3Seq", "LinkPosition", linkPosSeq_->frameRate(),
+            numLinkPosFrames, numParts, 7, linkPosSeq_.get());
+        for(int i=0; i < numLinkPosFrames; ++i){
+            MultiSE3Seq::Frame frame = linkPosSeq_->frame(i);
+            for(int j=0; j < numParts; ++j){
+                const Vector3& p = frame[j].translation();
+                const Quat& q = frame[j].rotation();
+                writer.writeScalar(p.x());
+                writer.writeScalar(p.y());
+                writer.writeScalar(p.z());
+                writer.writeScalar(q.w());
+                writer.writeScalar(q.x());
+                writer.writeScalar(q.y());
+                writer.writeScalar(q.z());
+            }
+        }
+    }
+
+    if(zmpSeq){
+        const int numFrames = zmpSeq->numFrames();
+        writer.writeComponentHeader(
+            "Vector3Seq", zmpSeq->isRootRelative() ? "RelativeZMP" : "ZMP", zmpSeq->frameRate(),
+            numFrames, 1, 3, 0);
+        for(int i=0; i < numFrames; ++i){
+            const Vector3& zmp = (*zmpSeq)[i];
+            for(int j=0; j < 3; ++j){
+                writer.writeScalar(zmp[j]);
+            }
+        }
+    }
+
+    if(!writer.os){
+        addSeqMessage(filename + " cannot be written.");
+        return false;
+    }
+    
+    return true;
+}
+
+
+/**
+   The file is mapped to the memory and the frames are directly copied into the seqs.
+*/
+bool BodyMotion::loadBinaryFormat(const std::string& filename)
+{
+    clearSeqMessage();
+    setDimension(0, 1, 1);
+
+    boost::iostreams::mapped_file_source file;
+    try {
+        file.open(filename);
+    } catch(const std::exception&){
+        addSeqMessage(filename + " cannot be opened.");
+        return false;
+    }
+
+    BinaryMotionReader reader;
+    reader.current = file.data();
+    reader.end = file.data() + file.size();
+    
+    char signature[8];
+    uint32_t version, mark, numComponents;
+    if(!reader.read(signature) || memcmp(signature, binaryFormatSignature, 8) != 0 ||
+       !reader.read(version) || !reader.read(mark) || !reader.read(numComponents)){
+        addSeqMessage(filename + " is not a body motion file of the binary format.");
+        return false;
+    }
+    if(version != binaryFormatVersion){
+        addSeqMessage(filename + " has an unsupported version of the binary format.");
+        return false;
+    }
+    if(mark != byteOrderMark){
+        addSeqMessage(filename + " has a different byte order.");
+        return false;
+    }
+
+    bool loaded = false;
+    
+    vector<string> labels;
+    
+    for(uint32_t i=0; i < numComponents; ++i){
+        string type, content;
+        double frameRate;
+        uint32_t numFrames, numParts, numElements, scalarSize;
+        bool isValid =
+            reader.readString(type) && reader.readString(content) && reader.read(frameRate) &&
+            reader.read(numFrames) && reader.read(numParts) && reader.read(numElements) &&
+            reader.read(scalarSize) && (scalarSize == sizeof(float) || scalarSize == sizeof(double));
+        if(isValid){
+            // Each label has at least its length field
+            isValid = (reader.end - reader.current) / (ptrdiff_t)sizeof(uint32_t) >= (ptrdiff_t)numParts;
+        }
+        if(isValid){
+            labels.resize(numParts);
+        }
+        for(uint32_t j=0; isValid && j < numParts; ++j){
+            isValid = reader.readString(labels[j]);
+        }
+        if(isValid){
+            reader.align(file.data());
+            reader.scalarSize = scalarSize;
+            isValid = reader.hasValues(numFrames, numParts, numElements);
+        }
+        if(!isValid){
+            addSeqMessage(filename + " is broken.");
+            setDimension(0, 1, 1);
+            return false;
+        }
+
+        if(type == "MultiValueSeq" && content == "JointPosition" && numElements == 1){
+            jointPosSeq_->setFrameRate(frameRate);
+            jointPosSeq_->setDimension(numFrames, numParts);
+            for(uint32_t j=0; j < numParts; ++j){
+                jointPosSeq_->setPartLabel(j, labels[j]);
+            }
+            for(uint32_t j=0; j < numFrames; ++j){
+                reader.readScalars(jointPosSeq_->frame(j).begin(), numParts);
+            }
+            loaded = true;
+
+        } else if(type == "MultiSE3Seq" && content == "LinkPosition" && numElements == 7){
+            linkPosSeq_->setFrameRate(frameRate);
+            linkPosSeq_->setDimension(numFrames, numParts);
+            for(uint32_t j=0; j < numParts; ++j){
+                linkPosSeq_->setPartLabel(j, labels[j]);
+            }
+            double v[7];
+            for(uint32_t j=0; j < numFrames; ++j){
+                MultiSE3Seq::Frame frame = linkPosSeq_->frame(j);
+                for(uint32_t k=0; k < numParts; ++k){
+                    reader.readScalars(v, 7);
+                    frame[k].set(Vector3(v[0], v[1], v[2]), Quat(v[3], v[4], v[5], v[6]));
+                }
+            }
+            loaded = true;
+
+        } else if(type == "Vector3Seq" && (content == "ZMP" || content == "RelativeZMP") &&
+                  numParts == 1 && numElements == 3){
+            ZMPSeqPtr zmpSeq = getOrCreateExtraSeq<ZMPSeq>(ZMPSeq::key());
+            zmpSeq->setFrameRate(frameRate);
+            zmpSeq->setNumFrames(numFrames);
+            zmpSeq->setRootRelative(content == "RelativeZMP");
+            for(uint32_t j=0; j < numFrames; ++j){
+                reader.readScalars((*zmpSeq)[j].data(), 3);
+            }
+            loaded = true;
+
+        } else {
+            // skip the unknown component
+            reader.current += (ptrdiff_t)numFrames * numParts * numElements * scalarSize;
+        }
+    }
+
+    return loaded;
+}
+
+
 void BodyMotion::clearExtraSeq(const std::string& contentName)
 {
     if(extraSeqs.erase(contentName) > 0){
@@ -15,6 +15,8 @@
 
 namespace cnoid {
 
+class BodyMotionFramesReceiver;
+
 class CNOID_EXPORT BodyMotion : public AbstractMultiSeq
 {
 public:
@@ -84,6 +86,9 @@ public:
     bool loadStandardYAMLformat(const std::string& filename);
     bool saveAsStandardYAMLformat(const std::string& filename);
 
+    bool loadBinaryFormat(const std::string& filename);
+    bool saveAsBinaryFormat(const std::string& filename, bool useSinglePrecision = false);
+
     typedef std::map<std::string, AbstractSeqPtr> ExtraSeqMap;
     typedef ExtraSeqMap::const_iterator ConstSeqIterator;
         
@@ -129,6 +134,8 @@ private:
     ExtraSeqMap extraSeqs;
 
     Signal<void()> sigExtraSeqsChanged_;
+
+    bool readComponents(const Mapping& archive, BodyMotionFramesReceiver* framesReceiver);
 };
 
 typedef boost::shared_ptr<BodyMotion> BodyMotionPtr;
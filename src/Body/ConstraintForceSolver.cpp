@@ -17,6 +17,7 @@
 #include <cnoid/IdPair>
 #include <cnoid/EigenUtil>
 #include <cnoid/AISTCollisionDetector>
+#include <Eigen/Cholesky>
 #include <boost/format.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/random.hpp>
@@ -70,6 +71,10 @@ static const double THRESH_TO_SWITCH_REL_ERROR = 1.0e-8;
 
 static const bool USE_PREVIOUS_LCP_SOLUTION = true;
 
+// A contact point is regarded as the same point as that of the previous step
+// within this distance in the warm start
+static const double WARM_START_CONTACT_MATCHING_DISTANCE = 0.005;
+
 static const bool ENABLE_CONTACT_DEPTH_CORRECTION = true;
 
 // normal setting
@@ -128,6 +133,10 @@ public:
     WorldBase& world;
 
     bool isConstraintForceOutputMode;
+    bool areConstraintIslandsEnabled;
+    bool isWarmStartEnabled;
+    bool isMassMatrixAssemblyEnabled;
+    int solveCounter;
         
     struct ConstraintPoint {
         int globalIndex;
@@ -145,6 +154,14 @@ public:
     };
     typedef std::vector<ConstraintPoint> ConstraintPointArray;
 
+    // The constraint force of a constraint point solved in the previous step
+    struct PrevConstraintForce {
+        Vector3 point;
+        double normalForce;
+        Vector3 frictionForce; // force applied to the second link
+    };
+    typedef std::vector<PrevConstraintForce> PrevConstraintForceArray;
+
     struct LinkData
     {
         Vector3 dvo;
@@ -157,9 +174,17 @@ public:
         int numberToCheckAccelCalcSkip;
         int parentIndex;
         DyLink* link;
+
+        // for assembling the acceleration matrix from the mass matrix
+        int dofIndex; // -1 for the root link and a fixed joint
+        double cm;    // the composite rigid body inertia of the subtree around the origin
+        Vector3 cmc;
+        Matrix3 cIww;
     };
     typedef std::vector<LinkData> LinkDataArray;
 
+    class LinkPair;
+
     struct BodyData
     {
         DyBodyPtr body;
@@ -168,6 +193,7 @@ public:
         bool isTestForceBeingApplied;
         int geometryId;
         LinkDataArray linksData;
+        int numDofs; // the dimension of the mass matrix
 
         Vector3 dpf;
         Vector3 dptau;
@@ -179,13 +205,34 @@ public:
            the forward dynamics is calculated by ABM.
         */
         ForwardDynamicsCBMPtr forwardDynamicsCBM;
+
+        // the constrained link pairs including this body
+        std::vector<LinkPair*> linkPairs;
     };
 
     std::vector<BodyData> bodiesData;
 
+    std::vector<CollisionPair> collisionPairs;
+
     class LinkPair
     {
     public:
+        LinkPair()
+            : isSameBodyPair(false),
+              isNonContactConstraint(false),
+              muStatic(0.0),
+              muDynamic(0.0),
+              contactCullingDistance(0.0),
+              contactCullingDepth(0.0),
+              epsilon(0.0),
+              prevConstraintForcesCounter(-1) {
+            for(int i=0; i < 2; ++i){
+                bodyIndex[i] = 0;
+                bodyData[i] = 0;
+                link[i] = 0;
+                linkData[i] = 0;
+            }
+        }
         virtual ~LinkPair() { }
         bool isSameBodyPair;
         int bodyIndex[2];
@@ -199,6 +246,10 @@ public:
         double contactCullingDistance;
         double contactCullingDepth;
         double epsilon;
+
+        // for the warm start
+        PrevConstraintForceArray prevConstraintForces;
+        int prevConstraintForcesCounter;
     };
     typedef boost::shared_ptr<LinkPair> LinkPairPtr;
 
@@ -238,6 +289,12 @@ public:
 
     std::vector<LinkPair*> constrainedLinkPairs;
 
+    // all the constrained link pairs, which are kept here while the pairs of each island are solved
+    std::vector<LinkPair*> allConstrainedLinkPairs;
+
+    // the bodies whose default accelerations are calculated
+    std::vector<BodyData*> constrainedBodies;
+
     int globalNumConstraintVectors;
 
     int globalNumContactNormalVectors;
@@ -251,9 +308,41 @@ public:
 
     typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> MatrixX;
     typedef VectorXd VectorX;
+
+    /**
+       A set of the constrained link pairs which are connected via non-static bodies.
+       The constraint forces of the different islands do not affect each other,
+       so the LCP of each island can be solved separately.
+    */
+    struct ConstraintIsland
+    {
+        std::vector<LinkPair*> linkPairs;
+        std::vector<BodyData*> bodies;
+    };
+    std::vector<ConstraintIsland> constraintIslands;
+
+    /**
+       The solution of an island solved in the previous step, which is used as the initial solution.
+       The island indices change between the steps, so the solution is stored for the index of the
+       first body of the island and it is only used for the island which has the same bodies.
+    */
+    struct IslandSolution
+    {
+        IslandSolution() : solveCounter(-1) { }
+        std::vector<BodyData*> bodies;
+        VectorX solution;
+        int solveCounter;
+    };
+    std::vector<IslandSolution> islandSolutions;
+    int numConstraintIslands;
+    std::vector<int> bodyIndexToIslandRoot;
+    std::vector<int> bodyIndexToIslandIndex;
         
     // Mlcp * solution + b   _|_  solution
+    // The matrix and the vectors are only reallocated when they grow,
+    // and their top left parts whose size is dimLCP are used.
 
+    int dimLCP;
     MatrixX Mlcp;
 
     // constant acceleration term when no external force is applied
@@ -266,6 +355,14 @@ public:
     // contact force solution: normal forces at contact points
     VectorX solution;
 
+    // buffers for assembling the acceleration matrix from the mass matrix of each body
+    MatrixXd massMatrix;
+    Eigen::LDLT<MatrixXd> massMatrixLDLT;
+    MatrixXd transposedJacobian;
+    MatrixXd invMassMatrixTransposedJacobian;
+    MatrixXd bodyAccelerationMatrix;
+    std::vector<int> constraintRowIndices;
+
     // random number generator
     boost::variate_generator<boost::mt19937, boost::uniform_real<> > randomAngle;
 
@@ -280,14 +377,18 @@ public:
     double contactCorrectionDepth;
     double contactCorrectionVelocityRatio;
 
-    int numGaussSeidelTotalLoops;
-    int numGaussSeidelTotalCalls;
+    long long numGaussSeidelTotalLoops;
+    long long numGaussSeidelTotalCalls;
     int numGaussSeidelTotalLoopsMax;
 
     void initBody(const DyBodyPtr& body, BodyData& bodyData);
     void initExtraJoints(int bodyIndex);
     void init2Dconstraint(int bodyIndex);
     void setConstraintPoints();
+    int extractConstraintIslands();
+    int findIslandRoot(int bodyIndex);
+    void solveConstraintIslands();
+    void solveConstraints(bool doResetSolution);
     void extractConstraintPoints(const CollisionPair& collisionPair);
     bool setContactConstraintPoint(LinkPair& linkPair, const Collision& collision);
     void setFrictionVectors(ConstraintPoint& constraintPoint);
@@ -299,20 +400,24 @@ public:
     void setAccelCalcSkipInformation();
     void setDefaultAccelerationVector();
     void setAccelerationMatrix();
+    void setAccelerationMatrixFromMassMatrices();
+    void calcMassMatrixOfBody(BodyData& bodyData);
+    void addTransposedJacobianColumn
+    (BodyData& bodyData, LinkPair& linkPair, const Vector3& point, const Vector3* directions, int column);
     void initABMForceElementsWithNoExtForce(BodyData& bodyData);
     void calcABMForceElementsWithTestForce(BodyData& bodyData, DyLink* linkToApplyForce, const Vector3& f, const Vector3& tau);
     void calcAccelsABM(BodyData& bodyData, int constraintIndex);
     void calcAccelsMM(BodyData& bodyData, int constraintIndex);
 
     void extractRelAccelsOfConstraintPoints
-    (Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, int testForceIndex, int constraintIndex);
+    (Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, LinkPair& testForceLinkPair, int testForceIndex, int constraintIndex);
+    void extractRelAccelsFromLinkPair
+    (Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, LinkPair& linkPair, int testForceIndex, int maxConstraintIndexToExtract);
 
     void extractRelAccelsFromLinkPairCase1
     (Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, LinkPair& linkPair, int testForceIndex, int constraintIndex);
     void extractRelAccelsFromLinkPairCase2
     (Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, LinkPair& linkPair, int iTestForce, int iDefault, int testForceIndex, int constraintIndex);
-    void extractRelAccelsFromLinkPairCase3
-    (Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, LinkPair& linkPair, int testForceIndex, int constraintIndex);
 
     void copySymmetricElementsOfAccelerationMatrix
     (Eigen::Block<MatrixX>& Knn, Eigen::Block<MatrixX>& Ktn, Eigen::Block<MatrixX>& Knt, Eigen::Block<MatrixX>& Ktt);
@@ -321,6 +426,8 @@ public:
 		
     void setConstantVectorAndMuBlock();
     void addConstraintForceToLinks();
+    void setInitialSolutionFromPrevConstraintForces();
+    void storePrevConstraintForces();
     void addConstraintForceToLink(LinkPair* linkPair, int ipair);
 
     void solveMCPByProjectedGaussSeidel
@@ -404,6 +511,9 @@ CFSImpl::CFSImpl(WorldBase& world) :
     contactCorrectionVelocityRatio = DEFAULT_CONTACT_CORRECTION_VELOCITY_RATIO;
 
     isConstraintForceOutputMode = false;
+    areConstraintIslandsEnabled = false;
+    isWarmStartEnabled = false;
+    isMassMatrixAssemblyEnabled = false;
     is2Dmode = false;
 }
 
@@ -426,12 +536,16 @@ void CFSImpl::initBody(const DyBodyPtr& body, BodyData& bodyData)
     bodyData.isStatic = body->isStaticModel();
 
     LinkDataArray& linksData = bodyData.linksData;
+    int dofIndex = body->rootLink()->isFreeJoint() ? 6 : 0;
     const int n = body->numLinks();
     for(int i=0; i < n; ++i){
         DyLink* link = body->link(i);
-        linksData[link->index()].link = link;
-        linksData[link->index()].parentIndex = link->parent() ? link->parent()->index() : -1;
+        LinkData& linkData = linksData[link->index()];
+        linkData.link = link;
+        linkData.parentIndex = link->parent() ? link->parent()->index() : -1;
+        linkData.dofIndex = (link->parent() && !link->isFixedJoint()) ? dofIndex++ : -1;
     }
+    bodyData.numDofs = dofIndex;
 }
 
 
@@ -539,11 +653,10 @@ void CFSImpl::initialize(void)
         //os << setprecision(50);
     }
 
-    if(CFS_MCP_DEBUG){
-        numGaussSeidelTotalCalls = 0;
-        numGaussSeidelTotalLoops = 0;
-        numGaussSeidelTotalLoopsMax = 0;
-    }
+    numGaussSeidelTotalCalls = 0;
+    numGaussSeidelTotalLoops = 0;
+    numGaussSeidelTotalLoopsMax = 0;
+    solveCounter = 0;
 
     int numBodies = world.numBodies();
 
@@ -594,6 +707,9 @@ void CFSImpl::initialize(void)
     prevGlobalNumConstraintVectors = 0;
     prevGlobalNumFrictionVectors = 0;
     numUnconverged = 0;
+    numConstraintIslands = 0;
+    islandSolutions.clear();
+    dimLCP = 0;
 
     randomAngle.engine().seed();
 }
@@ -616,6 +732,8 @@ void CFSImpl::solve()
         os << "Time: " << world.currentTime() << std::endl;
     }
 
+    ++solveCounter;
+
     for(size_t i=0; i < bodiesData.size(); ++i){
         BodyData& data = bodiesData[i];
         data.hasConstrainedLinks = false;
@@ -646,71 +764,271 @@ void CFSImpl::solve()
         }
         if(CFS_DEBUG_VERBOSE) putContactPoints();
 
-        const bool constraintsSizeChanged = ((globalNumFrictionVectors   != prevGlobalNumFrictionVectors) ||
-                                             (globalNumConstraintVectors != prevGlobalNumConstraintVectors));
+        if(areConstraintIslandsEnabled && extractConstraintIslands() > 1){
+            solveConstraintIslands();
 
-        if(constraintsSizeChanged){
-            initMatrices();
+        } else {
+            constrainedBodies.clear();
+            for(size_t i=0; i < bodiesData.size(); ++i){
+                if(bodiesData[i].hasConstrainedLinks){
+                    constrainedBodies.push_back(&bodiesData[i]);
+                }
+            }
+            const bool constraintsSizeChanged = ((globalNumFrictionVectors   != prevGlobalNumFrictionVectors) ||
+                                                 (globalNumConstraintVectors != prevGlobalNumConstraintVectors));
+            if(constraintsSizeChanged){
+                initMatrices();
+            }
+            solveConstraints(constraintsSizeChanged);
+            numConstraintIslands = 0;
         }
+    }
 
-        if(areThereImpacts){
-            solveImpactConstraints();
-        }
+    if(numConstraintIslands > 1){
+        // The matrices have the size of the last island
+        prevGlobalNumConstraintVectors = -1;
+        prevGlobalNumFrictionVectors = -1;
+    } else {
+        prevGlobalNumConstraintVectors = globalNumConstraintVectors;
+        prevGlobalNumFrictionVectors = globalNumFrictionVectors;
+    }
+}
 
-        if(SKIP_REDUNDANT_ACCEL_CALC){
-            setAccelCalcSkipInformation();
-        }
 
-        setDefaultAccelerationVector();
-        setAccelerationMatrix();
+void CFSImpl::solveConstraints(bool doResetSolution)
+{
+    if(areThereImpacts){
+        solveImpactConstraints();
+    }
+
+    if(SKIP_REDUNDANT_ACCEL_CALC){
+        setAccelCalcSkipInformation();
+    }
 
-        clearSingularPointConstraintsOfClosedLoopConnections();
+    setDefaultAccelerationVector();
+    setAccelerationMatrix();
+
+    clearSingularPointConstraintsOfClosedLoopConnections();
 		
-        setConstantVectorAndMuBlock();
+    setConstantVectorAndMuBlock();
 
-        if(CFS_DEBUG_VERBOSE){
-            debugPutVector(an0, "an0");
-            debugPutVector(at0, "at0");
-            debugPutMatrix(Mlcp, "Mlcp");
-            debugPutVector(b.head(globalNumConstraintVectors), "b1");
-            debugPutVector(b.segment(globalNumConstraintVectors, globalNumFrictionVectors), "b2");
-        }
+    if(CFS_DEBUG_VERBOSE){
+        debugPutVector(an0, "an0");
+        debugPutVector(at0, "at0");
+        debugPutMatrix(Mlcp, "Mlcp");
+        debugPutVector(b.head(globalNumConstraintVectors), "b1");
+        debugPutVector(b.segment(globalNumConstraintVectors, globalNumFrictionVectors), "b2");
+    }
 
-        bool isConverged;
+    bool isConverged;
 #ifdef USE_PIVOTING_LCP
-        isConverged = callPathLCPSolver(Mlcp, b, solution);
+    isConverged = callPathLCPSolver(Mlcp, b, solution);
 #else
-        if(!USE_PREVIOUS_LCP_SOLUTION || constraintsSizeChanged){
-            solution.setZero();
-        }
-        solveMCPByProjectedGaussSeidel(Mlcp, b, solution);
-        isConverged = true;
+    if(isWarmStartEnabled){
+        setInitialSolutionFromPrevConstraintForces();
+    } else if(!USE_PREVIOUS_LCP_SOLUTION || doResetSolution){
+        solution.head(dimLCP).setZero();
+    }
+    solveMCPByProjectedGaussSeidel(Mlcp, b, solution);
+    if(isWarmStartEnabled){
+        storePrevConstraintForces();
+    }
+    isConverged = true;
 #endif
 
-        if(!isConverged){
-            ++numUnconverged;
-            if(CFS_DEBUG)
-                os << "LCP didn't converge" << numUnconverged << std::endl;
-        } else {
-            if(CFS_DEBUG)
-                os << "LCP converged" << std::endl;
-            if(CFS_DEBUG_LCPCHECK){
-                // checkLCPResult(Mlcp, b, solution);
-                checkMCPResult(Mlcp, b, solution);
+    if(!isConverged){
+        ++numUnconverged;
+        if(CFS_DEBUG)
+            os << "LCP didn't converge" << numUnconverged << std::endl;
+    } else {
+        if(CFS_DEBUG)
+            os << "LCP converged" << std::endl;
+        if(CFS_DEBUG_LCPCHECK){
+            // checkLCPResult(Mlcp, b, solution);
+            checkMCPResult(Mlcp, b, solution);
+        }
+
+        addConstraintForceToLinks();
+    }
+}
+
+
+int CFSImpl::findIslandRoot(int bodyIndex)
+{
+    while(bodyIndexToIslandRoot[bodyIndex] != bodyIndex){
+        int& parent = bodyIndexToIslandRoot[bodyIndex];
+        parent = bodyIndexToIslandRoot[parent];
+        bodyIndex = parent;
+    }
+    return bodyIndex;
+}
+
+
+/**
+   The constrained link pairs are grouped into the islands by the union-find of
+   the non-static bodies. Static bodies do not propagate the constraint forces,
+   so they do not connect the islands.
+   \return the number of the islands
+*/
+int CFSImpl::extractConstraintIslands()
+{
+    const int numBodies = bodiesData.size();
+    bodyIndexToIslandRoot.resize(numBodies);
+    for(int i=0; i < numBodies; ++i){
+        bodyIndexToIslandRoot[i] = i;
+    }
+
+    const int numLinkPairs = constrainedLinkPairs.size();
+    for(int i=0; i < numLinkPairs; ++i){
+        LinkPair* linkPair = constrainedLinkPairs[i];
+        int roots[2];
+        for(int j=0; j < 2; ++j){
+            const int bodyIndex = linkPair->bodyIndex[j];
+            if(bodyIndex >= 0 && !bodiesData[bodyIndex].isStatic){
+                roots[j] = findIslandRoot(bodyIndex);
+            } else {
+                roots[j] = -1;
+            }
+        }
+        if(roots[0] >= 0 && roots[1] >= 0 && roots[0] != roots[1]){
+            bodyIndexToIslandRoot[roots[1]] = roots[0];
+        }
+    }
+
+    for(size_t i=0; i < constraintIslands.size(); ++i){
+        constraintIslands[i].linkPairs.clear();
+        constraintIslands[i].bodies.clear();
+    }
+    numConstraintIslands = 0;
+    bodyIndexToIslandIndex.assign(numBodies, -1);
+
+    for(int i=0; i < numLinkPairs; ++i){
+        LinkPair* linkPair = constrainedLinkPairs[i];
+        int islandIndex = -1;
+        for(int j=0; j < 2; ++j){
+            const int bodyIndex = linkPair->bodyIndex[j];
+            if(bodyIndex >= 0 && !bodiesData[bodyIndex].isStatic){
+                int& index = bodyIndexToIslandIndex[findIslandRoot(bodyIndex)];
+                if(index < 0){
+                    index = numConstraintIslands++;
+                    if((int)constraintIslands.size() < numConstraintIslands){
+                        constraintIslands.resize(numConstraintIslands);
+                    }
+                }
+                islandIndex = index;
+                break;
+            }
+        }
+        if(islandIndex < 0){
+            // a pair of static bodies does not interact with any other pairs
+            islandIndex = numConstraintIslands++;
+            if((int)constraintIslands.size() < numConstraintIslands){
+                constraintIslands.resize(numConstraintIslands);
             }
+        }
+        constraintIslands[islandIndex].linkPairs.push_back(linkPair);
+    }
 
-            addConstraintForceToLinks();
+    for(int i=0; i < numBodies; ++i){
+        if(bodiesData[i].hasConstrainedLinks && !bodiesData[i].isStatic){
+            const int islandIndex = bodyIndexToIslandIndex[findIslandRoot(i)];
+            if(islandIndex >= 0){
+                constraintIslands[islandIndex].bodies.push_back(&bodiesData[i]);
+            }
         }
     }
 
-    prevGlobalNumConstraintVectors = globalNumConstraintVectors;
-    prevGlobalNumFrictionVectors = globalNumFrictionVectors;
+    return numConstraintIslands;
+}
+
+
+/**
+   The constraint points of each island are renumbered so that the indices
+   start from zero in the island, and the LCP of the island is solved with the
+   matrices whose size is that of the island. The contact constraints precede the
+   non-contact constraints in the numbering as well as the global numbering.
+*/
+void CFSImpl::solveConstraintIslands()
+{
+    constrainedLinkPairs.swap(allConstrainedLinkPairs);
+    const int totalNumConstraintVectors = globalNumConstraintVectors;
+    const int totalNumContactNormalVectors = globalNumContactNormalVectors;
+    const int totalNumFrictionVectors = globalNumFrictionVectors;
+
+    for(int i=0; i < numConstraintIslands; ++i){
+
+        ConstraintIsland& island = constraintIslands[i];
+        constrainedLinkPairs.swap(island.linkPairs);
+        constrainedBodies.swap(island.bodies);
+
+        int numConstraintVectors = 0;
+        int numFrictionVectors = 0;
+        for(size_t j=0; j < constrainedLinkPairs.size(); ++j){
+            LinkPair* linkPair = constrainedLinkPairs[j];
+            if(!linkPair->isNonContactConstraint){
+                ConstraintPointArray& constraintPoints = linkPair->constraintPoints;
+                for(size_t k=0; k < constraintPoints.size(); ++k){
+                    ConstraintPoint& constraint = constraintPoints[k];
+                    constraint.globalIndex = numConstraintVectors++;
+                    constraint.globalFrictionIndex = numFrictionVectors;
+                    numFrictionVectors += constraint.numFrictionVectors;
+                }
+            }
+        }
+        globalNumContactNormalVectors = numConstraintVectors;
+        for(size_t j=0; j < constrainedLinkPairs.size(); ++j){
+            LinkPair* linkPair = constrainedLinkPairs[j];
+            if(linkPair->isNonContactConstraint){
+                ConstraintPointArray& constraintPoints = linkPair->constraintPoints;
+                for(size_t k=0; k < constraintPoints.size(); ++k){
+                    constraintPoints[k].globalIndex = numConstraintVectors++;
+                }
+            }
+        }
+        globalNumConstraintVectors = numConstraintVectors;
+        globalNumFrictionVectors = numFrictionVectors;
+
+        initMatrices();
+
+        IslandSolution* prevSolution = 0;
+        if(!constrainedBodies.empty()){
+            if(islandSolutions.size() < bodiesData.size()){
+                islandSolutions.resize(bodiesData.size());
+            }
+            prevSolution = &islandSolutions[constrainedBodies.front() - &bodiesData.front()];
+        }
+        const bool isSolutionAvailable =
+            prevSolution &&
+            prevSolution->solveCounter == solveCounter - 1 &&
+            prevSolution->bodies == constrainedBodies &&
+            prevSolution->solution.size() == dimLCP;
+        if(isSolutionAvailable){
+            solution.head(dimLCP) = prevSolution->solution;
+        }
+        solveConstraints(!isSolutionAvailable);
+        if(prevSolution){
+            prevSolution->bodies = constrainedBodies;
+            prevSolution->solution = solution.head(dimLCP);
+            prevSolution->solveCounter = solveCounter;
+        }
+
+        constrainedLinkPairs.swap(island.linkPairs);
+        constrainedBodies.swap(island.bodies);
+    }
+
+    constrainedLinkPairs.swap(allConstrainedLinkPairs);
+    globalNumConstraintVectors = totalNumConstraintVectors;
+    globalNumContactNormalVectors = totalNumContactNormalVectors;
+    globalNumFrictionVectors = totalNumFrictionVectors;
 }
 
 
 void CFSImpl::setConstraintPoints()
 {
-    collisionDetector->detectCollisions(boost::bind(&CFSImpl::extractConstraintPoints, this, _1));
+    const int numCollisionPairs = collisionDetector->detectCollisions(collisionPairs);
+    for(int i=0; i < numCollisionPairs; ++i){
+        extractConstraintPoints(collisionPairs[i]);
+    }
 
     globalNumContactNormalVectors = globalNumConstraintVectors;
 
@@ -1042,11 +1360,13 @@ void CFSImpl::initMatrices()
     const int n = globalNumConstraintVectors;
     const int m = globalNumFrictionVectors;
 
-    const int dimLCP = usePivotingLCP ? (n + m + m) : (n + m);
+    dimLCP = usePivotingLCP ? (n + m + m) : (n + m);
 
-    Mlcp.resize(dimLCP, dimLCP);
-    b.resize(dimLCP);
-    solution.resize(dimLCP);
+    if(Mlcp.rows() < dimLCP){
+        Mlcp.resize(dimLCP, dimLCP);
+        b.resize(dimLCP);
+        solution.resize(dimLCP);
+    }
 
     if(usePivotingLCP){
         Mlcp.block(0, n + m, n, m).setZero();
@@ -1054,34 +1374,50 @@ void CFSImpl::initMatrices()
         Mlcp.block(n + m, n, m, m) = -MatrixX::Identity(m, m);
         Mlcp.block(n + m, n + m, m, m).setZero();
         Mlcp.block(n, n + m, m, m).setIdentity();
-        b.tail(m).setZero();
+        b.segment(n + m, m).setZero();
 
     } else {
         frictionIndexToContactIndex.resize(m);
-        contactIndexToMu.resize(globalNumContactNormalVectors);
-        mcpHi.resize(globalNumContactNormalVectors);
+        if(contactIndexToMu.size() < globalNumContactNormalVectors){
+            contactIndexToMu.resize(globalNumContactNormalVectors);
+            mcpHi.resize(globalNumContactNormalVectors);
+        }
     }
 
-    an0.resize(n);
-    at0.resize(m);
+    if(an0.size() < n){
+        an0.resize(n);
+    }
+    if(at0.size() < m){
+        at0.resize(m);
+    }
 }
 
 
 void CFSImpl::setAccelCalcSkipInformation()
 {
     // clear skip check numbers
-    for(size_t i=0; i < bodiesData.size(); ++i){
-        BodyData& bodyData = bodiesData[i];
-        if(bodyData.hasConstrainedLinks){
-            LinkDataArray& linksData = bodyData.linksData;
-            for(size_t j=0; j < linksData.size(); ++j){
-                linksData[j].numberToCheckAccelCalcSkip = numeric_limits<int>::max();
+    for(size_t i=0; i < constrainedBodies.size(); ++i){
+        LinkDataArray& linksData = constrainedBodies[i]->linksData;
+        for(size_t j=0; j < linksData.size(); ++j){
+            linksData[j].numberToCheckAccelCalcSkip = numeric_limits<int>::max();
+        }
+    }
+    // The static bodies are not included in the bodies of an island
+    const int numLinkPairs = constrainedLinkPairs.size();
+    for(int i=0; i < numLinkPairs; ++i){
+        LinkPair* linkPair = constrainedLinkPairs[i];
+        for(int j=0; j < 2; ++j){
+            BodyData* bodyData = linkPair->bodyData[j];
+            if(bodyData->isStatic){
+                LinkDataArray& linksData = bodyData->linksData;
+                for(size_t k=0; k < linksData.size(); ++k){
+                    linksData[k].numberToCheckAccelCalcSkip = numeric_limits<int>::max();
+                }
             }
         }
     }
 
     // add the number of contact points to skip check numbers of the links from a contact target to the root
-    int numLinkPairs = constrainedLinkPairs.size();
     for(int i=0; i < numLinkPairs; ++i){
         LinkPair* linkPair = constrainedLinkPairs[i];
         int constraintIndex = linkPair->constraintPoints.front().globalIndex;
@@ -1104,9 +1440,9 @@ void CFSImpl::setAccelCalcSkipInformation()
 void CFSImpl::setDefaultAccelerationVector()
 {
     // calculate accelerations with no constraint force
-    for(size_t i=0; i < bodiesData.size(); ++i){
-        BodyData& bodyData = bodiesData[i];
-        if(bodyData.hasConstrainedLinks && ! bodyData.isStatic){
+    for(size_t i=0; i < constrainedBodies.size(); ++i){
+        BodyData& bodyData = *constrainedBodies[i];
+        if(!bodyData.isStatic){
 
             if(bodyData.forwardDynamicsCBM){
                 bodyData.forwardDynamicsCBM->sumExternalForces();
@@ -1162,6 +1498,40 @@ void CFSImpl::setAccelerationMatrix()
     Eigen::Block<MatrixX> Knt = Mlcp.block(n, 0, m, n);
     Eigen::Block<MatrixX> Ktt = Mlcp.block(n, n, m, m);
 
+    // Only the elements of the link pairs including the bodies to which a test force is
+    // applied are non-zero, so the other elements are cleared here and they are skipped
+    // in extracting the accelerations.
+    Mlcp.topLeftCorner(n + m, n + m).setZero();
+
+    for(size_t i=0; i < constrainedLinkPairs.size(); ++i){
+        LinkPair* linkPair = constrainedLinkPairs[i];
+        linkPair->bodyData[0]->linkPairs.clear();
+        linkPair->bodyData[1]->linkPairs.clear();
+    }
+    for(size_t i=0; i < constrainedLinkPairs.size(); ++i){
+        LinkPair* linkPair = constrainedLinkPairs[i];
+        linkPair->bodyData[0]->linkPairs.push_back(linkPair);
+        if(!linkPair->isSameBodyPair){
+            linkPair->bodyData[1]->linkPairs.push_back(linkPair);
+        }
+    }
+
+    if(isMassMatrixAssemblyEnabled){
+        // The mass matrix of a body including high-gain mode joints is not available
+        bool isMassMatrixAvailable = true;
+        for(size_t i=0; i < constrainedBodies.size(); ++i){
+            BodyData& bodyData = *constrainedBodies[i];
+            if(!bodyData.isStatic && bodyData.forwardDynamicsCBM){
+                isMassMatrixAvailable = false;
+                break;
+            }
+        }
+        if(isMassMatrixAvailable){
+            setAccelerationMatrixFromMassMatrices();
+            return;
+        }
+    }
+
     for(size_t i=0; i < constrainedLinkPairs.size(); ++i){
 
         LinkPair& linkPair = *constrainedLinkPairs[i];
@@ -1196,7 +1566,7 @@ void CFSImpl::setAccelerationMatrix()
                     }
                 }
             }
-            extractRelAccelsOfConstraintPoints(Knn, Knt, constraintIndex, constraintIndex);
+            extractRelAccelsOfConstraintPoints(Knn, Knt, linkPair, constraintIndex, constraintIndex);
 
             // apply test friction force
             for(int l=0; l < constraint.numFrictionVectors; ++l){
@@ -1221,7 +1591,7 @@ void CFSImpl::setAccelerationMatrix()
                         }
                     }
                 }
-                extractRelAccelsOfConstraintPoints(Ktn, Ktt, constraint.globalFrictionIndex + l, constraintIndex);
+                extractRelAccelsOfConstraintPoints(Ktn, Ktt, linkPair, constraint.globalFrictionIndex + l, constraintIndex);
             }
 
             linkPair.bodyData[0]->isTestForceBeingApplied = false;
@@ -1235,6 +1605,165 @@ void CFSImpl::setAccelerationMatrix()
 }
 
 
+/**
+   This function assembles the same matrix as the above test force method by summing
+   J * M^-1 * J^T of the constrained bodies, where M is the mass matrix of a body and
+   J^T is the matrix which maps the constraint vectors of the body to its generalized forces.
+   The matrix of a body only has the elements of the constraints of its link pairs.
+*/
+void CFSImpl::setAccelerationMatrixFromMassMatrices()
+{
+    const int n = globalNumConstraintVectors;
+
+    for(size_t i=0; i < constrainedBodies.size(); ++i){
+
+        BodyData& bodyData = *constrainedBodies[i];
+        if(bodyData.isStatic || bodyData.numDofs == 0){
+            continue;
+        }
+
+        std::vector<LinkPair*>& linkPairs = bodyData.linkPairs;
+        int numRows = 0;
+        for(size_t j=0; j < linkPairs.size(); ++j){
+            ConstraintPointArray& constraintPoints = linkPairs[j]->constraintPoints;
+            for(size_t k=0; k < constraintPoints.size(); ++k){
+                numRows += 1 + constraintPoints[k].numFrictionVectors;
+            }
+        }
+        if(numRows == 0){
+            continue;
+        }
+
+        transposedJacobian.resize(bodyData.numDofs, numRows);
+        transposedJacobian.setZero();
+        constraintRowIndices.resize(numRows);
+
+        int column = 0;
+        for(size_t j=0; j < linkPairs.size(); ++j){
+            LinkPair& linkPair = *linkPairs[j];
+            ConstraintPointArray& constraintPoints = linkPair.constraintPoints;
+            for(size_t k=0; k < constraintPoints.size(); ++k){
+                ConstraintPoint& constraint = constraintPoints[k];
+                constraintRowIndices[column] = constraint.globalIndex;
+                addTransposedJacobianColumn(
+                    bodyData, linkPair, constraint.point, constraint.normalTowardInside, column++);
+                for(int l=0; l < constraint.numFrictionVectors; ++l){
+                    constraintRowIndices[column] = n + constraint.globalFrictionIndex + l;
+                    addTransposedJacobianColumn(
+                        bodyData, linkPair, constraint.point, constraint.frictionVector[l], column++);
+                }
+            }
+        }
+
+        calcMassMatrixOfBody(bodyData);
+        massMatrixLDLT.compute(massMatrix);
+        invMassMatrixTransposedJacobian = massMatrixLDLT.solve(transposedJacobian);
+        bodyAccelerationMatrix.noalias() = transposedJacobian.transpose() * invMassMatrixTransposedJacobian;
+
+        for(int j=0; j < numRows; ++j){
+            const int row = constraintRowIndices[j];
+            for(int k=0; k < numRows; ++k){
+                Mlcp(row, constraintRowIndices[k]) += bodyAccelerationMatrix(j, k);
+            }
+        }
+    }
+}
+
+
+/**
+   The mass matrix is calculated by the composite rigid body method with the spatial
+   vectors around the origin, which are the same as those used in ABM. The generalized
+   coordinates are the spatial acceleration of the root link when it is a free joint
+   and the joint accelerations.
+*/
+void CFSImpl::calcMassMatrixOfBody(BodyData& bodyData)
+{
+    LinkDataArray& linksData = bodyData.linksData;
+    const int numLinks = linksData.size();
+
+    for(int i=0; i < numLinks; ++i){
+        LinkData& data = linksData[i];
+        DyLink* link = data.link;
+        const double m = link->m();
+        const Matrix3 c_hat = hat(link->wc());
+        data.cm = m;
+        data.cmc = m * link->wc();
+        data.cIww.noalias() = m * c_hat * c_hat.transpose() + link->R() * link->I() * link->R().transpose();
+    }
+    for(int i = numLinks - 1; i > 0; --i){
+        LinkData& data = linksData[i];
+        LinkData& parentData = linksData[data.parentIndex];
+        parentData.cm += data.cm;
+        parentData.cmc += data.cmc;
+        parentData.cIww += data.cIww;
+    }
+
+    massMatrix.resize(bodyData.numDofs, bodyData.numDofs);
+
+    const bool isFreeRoot = linksData[0].link->isFreeJoint();
+    if(isFreeRoot){
+        LinkData& rootData = linksData[0];
+        const Matrix3 cmc_hat = hat(rootData.cmc);
+        massMatrix.block<3, 3>(0, 0) = Matrix3::Identity() * rootData.cm;
+        massMatrix.block<3, 3>(0, 3) = -cmc_hat;
+        massMatrix.block<3, 3>(3, 0) = cmc_hat;
+        massMatrix.block<3, 3>(3, 3) = rootData.cIww;
+    }
+
+    for(int i=1; i < numLinks; ++i){
+        LinkData& data = linksData[i];
+        if(data.dofIndex < 0){
+            continue;
+        }
+        DyLink* link = data.link;
+
+        // the spatial force to accelerate the subtree by the unit joint acceleration
+        const Vector3 f = data.cm * link->sv() + link->sw().cross(data.cmc);
+        const Vector3 tau = data.cmc.cross(link->sv()) + data.cIww * link->sw();
+
+        const int k = data.dofIndex;
+        massMatrix(k, k) = link->sv().dot(f) + link->sw().dot(tau) + link->Jm2();
+
+        for(DyLink* parent = link->parent(); parent->parent(); parent = parent->parent()){
+            const int j = linksData[parent->index()].dofIndex;
+            if(j >= 0){
+                massMatrix(j, k) = massMatrix(k, j) = parent->sv().dot(f) + parent->sw().dot(tau);
+            }
+        }
+        if(isFreeRoot){
+            massMatrix.block<3, 1>(0, k) = f;
+            massMatrix.block<3, 1>(3, k) = tau;
+            massMatrix.block<1, 3>(k, 0) = f.transpose();
+            massMatrix.block<1, 3>(k, 3) = tau.transpose();
+        }
+    }
+}
+
+
+void CFSImpl::addTransposedJacobianColumn
+(BodyData& bodyData, LinkPair& linkPair, const Vector3& point, const Vector3* directions, int column)
+{
+    for(int i=0; i < 2; ++i){
+        if(linkPair.bodyData[i] == &bodyData){
+            const Vector3& f = directions[i];
+            const Vector3 tau = point.cross(f);
+            DyLink* link = linkPair.link[i];
+            while(link->parent()){
+                const int dofIndex = bodyData.linksData[link->index()].dofIndex;
+                if(dofIndex >= 0){
+                    transposedJacobian(dofIndex, column) += link->sv().dot(f) + link->sw().dot(tau);
+                }
+                link = link->parent();
+            }
+            if(link->isFreeJoint()){
+                transposedJacobian.block<3, 1>(0, column) += f;
+                transposedJacobian.block<3, 1>(3, column) += tau;
+            }
+        }
+    }
+}
+
+
 void CFSImpl::initABMForceElementsWithNoExtForce(BodyData& bodyData)
 {
     bodyData.dpf.setZero();
@@ -1397,31 +1926,47 @@ void CFSImpl::calcAccelsMM(BodyData& bodyData, int constraintIndex)
 
 
 void CFSImpl::extractRelAccelsOfConstraintPoints
-(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, int testForceIndex, int constraintIndex)
+(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, LinkPair& testForceLinkPair, int testForceIndex, int constraintIndex)
 {
     int maxConstraintIndexToExtract = ASSUME_SYMMETRIC_MATRIX ? constraintIndex : globalNumConstraintVectors;
 
+    BodyData* bodyData0 = testForceLinkPair.bodyData[0];
+    BodyData* bodyData1 = testForceLinkPair.bodyData[1];
 
-    for(size_t i=0; i < constrainedLinkPairs.size(); ++i){
+    if(bodyData0->isTestForceBeingApplied){
+        std::vector<LinkPair*>& linkPairs = bodyData0->linkPairs;
+        for(size_t i=0; i < linkPairs.size(); ++i){
+            extractRelAccelsFromLinkPair(Kxn, Kxt, *linkPairs[i], testForceIndex, maxConstraintIndexToExtract);
+        }
+    }
+    if(bodyData1->isTestForceBeingApplied && bodyData1 != bodyData0){
+        std::vector<LinkPair*>& linkPairs = bodyData1->linkPairs;
+        for(size_t i=0; i < linkPairs.size(); ++i){
+            LinkPair& linkPair = *linkPairs[i];
+            // skip the pairs which have already been processed in the above loop
+            if(!bodyData0->isTestForceBeingApplied ||
+               (linkPair.bodyData[0] != bodyData0 && linkPair.bodyData[1] != bodyData0)){
+                extractRelAccelsFromLinkPair(Kxn, Kxt, linkPair, testForceIndex, maxConstraintIndexToExtract);
+            }
+        }
+    }
+}
 
-        LinkPair& linkPair = *constrainedLinkPairs[i];
 
-        BodyData& bodyData0 = *linkPair.bodyData[0];
-        BodyData& bodyData1 = *linkPair.bodyData[1];
+void CFSImpl::extractRelAccelsFromLinkPair
+(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, LinkPair& linkPair, int testForceIndex, int maxConstraintIndexToExtract)
+{
+    BodyData& bodyData0 = *linkPair.bodyData[0];
+    BodyData& bodyData1 = *linkPair.bodyData[1];
 
-        if(bodyData0.isTestForceBeingApplied){
-            if(bodyData1.isTestForceBeingApplied){
-                extractRelAccelsFromLinkPairCase1(Kxn, Kxt, linkPair, testForceIndex, maxConstraintIndexToExtract);
-            } else {
-                extractRelAccelsFromLinkPairCase2(Kxn, Kxt, linkPair, 0, 1, testForceIndex, maxConstraintIndexToExtract);
-            }
+    if(bodyData0.isTestForceBeingApplied){
+        if(bodyData1.isTestForceBeingApplied){
+            extractRelAccelsFromLinkPairCase1(Kxn, Kxt, linkPair, testForceIndex, maxConstraintIndexToExtract);
         } else {
-            if(bodyData1.isTestForceBeingApplied){
-                extractRelAccelsFromLinkPairCase2(Kxn, Kxt, linkPair, 1, 0, testForceIndex, maxConstraintIndexToExtract);
-            } else {
-                extractRelAccelsFromLinkPairCase3(Kxn, Kxt, linkPair, testForceIndex, maxConstraintIndexToExtract);
-            }
+            extractRelAccelsFromLinkPairCase2(Kxn, Kxt, linkPair, 0, 1, testForceIndex, maxConstraintIndexToExtract);
         }
+    } else {
+        extractRelAccelsFromLinkPairCase2(Kxn, Kxt, linkPair, 1, 0, testForceIndex, maxConstraintIndexToExtract);
     }
 }
 
@@ -1504,29 +2049,6 @@ void CFSImpl::extractRelAccelsFromLinkPairCase2
 }
 
 
-void CFSImpl::extractRelAccelsFromLinkPairCase3
-(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, LinkPair& linkPair, int testForceIndex, int maxConstraintIndexToExtract)
-{
-    ConstraintPointArray& constraintPoints = linkPair.constraintPoints;
-
-    for(size_t i=0; i < constraintPoints.size(); ++i){
-
-        ConstraintPoint& constraint = constraintPoints[i];
-        int constraintIndex = constraint.globalIndex;
-
-        if(ASSUME_SYMMETRIC_MATRIX && constraintIndex > maxConstraintIndexToExtract){
-            break;
-        }
-
-        Kxn(constraintIndex, testForceIndex) = 0.0;
-
-        for(int j=0; j < constraint.numFrictionVectors; ++j){
-            Kxt(constraint.globalFrictionIndex + j, testForceIndex) = 0.0;
-        }
-    }
-}
-
-
 void CFSImpl::copySymmetricElementsOfAccelerationMatrix
 (Eigen::Block<MatrixX>& Knn, Eigen::Block<MatrixX>& Ktn, Eigen::Block<MatrixX>& Knt, Eigen::Block<MatrixX>& Ktt)
 {
@@ -1566,9 +2088,9 @@ void CFSImpl::copySymmetricElementsOfAccelerationMatrix
 
 void CFSImpl::clearSingularPointConstraintsOfClosedLoopConnections()
 {
-    for(int i = 0; i < Mlcp.rows(); ++i){
+    for(int i = 0; i < dimLCP; ++i){
         if(Mlcp(i, i) < 1.0e-4){
-            for(int j=0; j < Mlcp.rows(); ++j){
+            for(int j=0; j < dimLCP; ++j){
                 Mlcp(j, i) = 0.0;
             }
             Mlcp(i, i) = numeric_limits<double>::max();
@@ -1705,6 +2227,82 @@ void CFSImpl::addConstraintForceToLink(LinkPair* linkPair, int ipair)
 }
 
 
+/**
+   The initial solution of the iterative solver is set from the constraint forces of
+   the previous step. The contact points are matched with those of the previous step
+   in the same link pair by the distance, and the friction forces are projected onto the
+   current friction vectors. The points of the non-contact constraints are matched by the order.
+*/
+void CFSImpl::setInitialSolutionFromPrevConstraintForces()
+{
+    static const double maxSquaredDistance =
+        WARM_START_CONTACT_MATCHING_DISTANCE * WARM_START_CONTACT_MATCHING_DISTANCE;
+    
+    solution.head(dimLCP).setZero();
+
+    for(size_t i=0; i < constrainedLinkPairs.size(); ++i){
+
+        LinkPair& linkPair = *constrainedLinkPairs[i];
+        if(linkPair.prevConstraintForcesCounter != solveCounter - 1){
+            continue;
+        }
+        const PrevConstraintForceArray& prevForces = linkPair.prevConstraintForces;
+        ConstraintPointArray& constraintPoints = linkPair.constraintPoints;
+
+        if(linkPair.isNonContactConstraint){
+            const size_t n = std::min(constraintPoints.size(), prevForces.size());
+            for(size_t j=0; j < n; ++j){
+                solution(constraintPoints[j].globalIndex) = prevForces[j].normalForce;
+            }
+        } else {
+            for(size_t j=0; j < constraintPoints.size(); ++j){
+                ConstraintPoint& constraint = constraintPoints[j];
+                const PrevConstraintForce* matched = 0;
+                double minSquaredDistance = maxSquaredDistance;
+                for(size_t k=0; k < prevForces.size(); ++k){
+                    const double d2 = (prevForces[k].point - constraint.point).squaredNorm();
+                    if(d2 <= minSquaredDistance){
+                        matched = &prevForces[k];
+                        minSquaredDistance = d2;
+                    }
+                }
+                if(matched){
+                    solution(constraint.globalIndex) = matched->normalForce;
+                    for(int k=0; k < constraint.numFrictionVectors; ++k){
+                        solution(globalNumConstraintVectors + constraint.globalFrictionIndex + k) =
+                            matched->frictionForce.dot(constraint.frictionVector[k][1]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+void CFSImpl::storePrevConstraintForces()
+{
+    for(size_t i=0; i < constrainedLinkPairs.size(); ++i){
+
+        LinkPair& linkPair = *constrainedLinkPairs[i];
+        ConstraintPointArray& constraintPoints = linkPair.constraintPoints;
+        PrevConstraintForceArray& prevForces = linkPair.prevConstraintForces;
+        prevForces.resize(constraintPoints.size());
+
+        for(size_t j=0; j < constraintPoints.size(); ++j){
+            ConstraintPoint& constraint = constraintPoints[j];
+            PrevConstraintForce& prevForce = prevForces[j];
+            prevForce.point = constraint.point;
+            prevForce.normalForce = solution(constraint.globalIndex);
+            prevForce.frictionForce.setZero();
+            for(int k=0; k < constraint.numFrictionVectors; ++k){
+                prevForce.frictionForce +=
+                    solution(globalNumConstraintVectors + constraint.globalFrictionIndex + k) * constraint.frictionVector[k][1];
+            }
+        }
+        linkPair.prevConstraintForcesCounter = solveCounter;
+    }
+}
+
 
 void CFSImpl::solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b, VectorX& x)
 {
@@ -1723,6 +2321,7 @@ void CFSImpl::solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b,
         os << "Iteration ";
     }
 
+    const int size = globalNumConstraintVectors + globalNumFrictionVectors;
     double error = 0.0;
     VectorXd x0;
     int i = 0;
@@ -1733,19 +2332,19 @@ void CFSImpl::solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b,
             solveMCPByProjectedGaussSeidelMainStep(M, b, x);
         }
 
-        x0 = x;
+        x0 = x.head(size);
         solveMCPByProjectedGaussSeidelMainStep(M, b, x);
 
         if(true){
-            double n = x.norm();
+            double n = x.head(size).norm();
             if(n > THRESH_TO_SWITCH_REL_ERROR){
-                error = (x - x0).norm() / x.norm();
+                error = (x.head(size) - x0).norm() / n;
             } else {
-                error = (x - x0).norm();
+                error = (x.head(size) - x0).norm();
             }
         } else {
             error = 0.0;
-            for(int j=0; j < x.size(); ++j){
+            for(int j=0; j < size; ++j){
                 double d = fabs(x(j) - x0(j));
                 if(d > THRESH_TO_SWITCH_REL_ERROR){
                     d /= x(j);
@@ -1764,16 +2363,17 @@ void CFSImpl::solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b,
         }
     }
 
+    const int numLoops = loopBlockSize * i;
+    numGaussSeidelTotalLoops += numLoops;
+    numGaussSeidelTotalCalls++;
+    numGaussSeidelTotalLoopsMax = std::max(numGaussSeidelTotalLoopsMax, numLoops);
+
     if(CFS_MCP_DEBUG){
 
         if(i == numBlockLoops){
             os << "not stopped" << ", error = " << error << endl;
         }
         
-        int n = loopBlockSize * i;
-        numGaussSeidelTotalLoops += n;
-        numGaussSeidelTotalCalls++;
-        numGaussSeidelTotalLoopsMax = std::max(numGaussSeidelTotalLoopsMax, n);
         os << ", avarage = " << (numGaussSeidelTotalLoops / numGaussSeidelTotalCalls);
         os << ", max = " << numGaussSeidelTotalLoopsMax;
         os << endl;
@@ -2027,9 +2627,9 @@ void CFSImpl::checkLCPResult(MatrixX& M, VectorX& b, VectorX& x)
     os << "check LCP result\n";
     os << "-------------------------------\n";
 
-    VectorX z = M * x + b;
+    const int n = dimLCP;
+    VectorX z = M.topLeftCorner(n, n) * x.head(n) + b.head(n);
 
-    int n = x.size();
     for(int i=0; i < n; ++i){
         os << "(" << x(i) << ", " << z(i) << ")";
 
@@ -2057,7 +2657,7 @@ void CFSImpl::checkMCPResult(MatrixX& M, VectorX& b, VectorX& x)
     os << "check MCP result\n";
     os << "-------------------------------\n";
 
-    VectorX z = M * x + b;
+    VectorX z = M.topLeftCorner(dimLCP, dimLCP) * x.head(dimLCP) + b.head(dimLCP);
 
     for(int i=0; i < globalNumConstraintVectors; ++i){
         os << "(" << x(i) << ", " << z(i) << ")";
@@ -2104,7 +2704,7 @@ void CFSImpl::checkMCPResult(MatrixX& M, VectorX& b, VectorX& x)
 #ifdef USE_PIVOTING_LCP
 bool CFSImpl::callPathLCPSolver(MatrixX& Mlcp, VectorX& b, VectorX& solution)
 {
-    int size = solution.size();
+    int size = dimLCP;
     int square = size * size;
     std::vector<double> lb(size + 1, 0.0);
     std::vector<double> ub(size + 1, 1.0e20);
@@ -2267,6 +2867,60 @@ void ConstraintForceSolver::enableConstraintForceOutput(bool on)
 }
 
 
+/**
+   When this is enabled, the constraints are decomposed into the islands which do not
+   interact with each other, and the LCP of each island is solved separately.
+   This is disabled by default because the convergence of the iterative solver is then
+   tested for each island, which changes the results from those of the whole LCP.
+*/
+void ConstraintForceSolver::enableConstraintIslands(bool on)
+{
+    impl->areConstraintIslandsEnabled = on;
+}
+
+
+/**
+   When this is enabled, the iterative solver starts from the constraint forces
+   of the previous step matched with the current constraint points.
+   This is disabled by default, and the solution of the previous step is then used
+   as it is while the number of the constraints does not change.
+*/
+void ConstraintForceSolver::enableWarmStart(bool on)
+{
+    impl->isWarmStartEnabled = on;
+}
+
+
+/**
+   When this is enabled, the acceleration matrix of the LCP is assembled from the mass matrix
+   of each constrained body instead of applying a test force to each constraint vector and
+   calculating the accelerations by ABM. The test force method is still used when a constrained
+   body includes high-gain mode joints. This is disabled by default.
+*/
+void ConstraintForceSolver::enableMassMatrixAssembly(bool on)
+{
+    impl->isMassMatrixAssemblyEnabled = on;
+}
+
+
+/**
+   The total number of the Gauss-Seidel iterations since the initialization
+*/
+long long ConstraintForceSolver::gaussSeidelTotalNumIterations()
+{
+    return impl->numGaussSeidelTotalLoops;
+}
+
+
+/**
+   The number of the calls to the Gauss-Seidel solver since the initialization
+*/
+long long ConstraintForceSolver::gaussSeidelNumCalls()
+{
+    return impl->numGaussSeidelTotalCalls;
+}
+
+
 void ConstraintForceSolver::set2Dmode(bool on)
 {
     impl->is2Dmode = on;
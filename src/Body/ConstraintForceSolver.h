@@ -51,6 +51,12 @@ public:
 
     void set2Dmode(bool on);
     void enableConstraintForceOutput(bool on);
+    void enableConstraintIslands(bool on);
+    void enableWarmStart(bool on);
+    void enableMassMatrixAssembly(bool on);
+
+    long long gaussSeidelTotalNumIterations();
+    long long gaussSeidelNumCalls();
 
 
     void initialize(void);
@@ -7,6 +7,8 @@
 #include "ForwardDynamicsABM.h"
 #include "ForwardDynamicsCBM.h"
 #include <cnoid/EigenUtil>
+#include <cnoid/ThreadPool>
+#include <boost/bind.hpp>
 #include <string>
 #include <iostream>
 
@@ -29,6 +31,7 @@ WorldBase::WorldBase()
     isEulerMethod =false;
     sensorsAreEnabled = false;
     numRegisteredLinkPairs = 0;
+    numThreads_ = 1;
 }
 
 
@@ -136,14 +139,38 @@ void WorldBase::calcNextState()
     }
     const int n = bodyInfoArray.size();
 
-    for(int i=0; i < n; ++i){
-        BodyInfo& info = bodyInfoArray[i];
-        info.forwardDynamics->calcNextState();
+    if(threadPool && n > 1){
+        for(int i=0; i < n; ++i){
+            ForwardDynamics* forwardDynamics = bodyInfoArray[i].forwardDynamics.get();
+            threadPool->start(boost::bind(&ForwardDynamics::calcNextState, forwardDynamics));
+        }
+        threadPool->wait();
+    } else {
+        for(int i=0; i < n; ++i){
+            BodyInfo& info = bodyInfoArray[i];
+            info.forwardDynamics->calcNextState();
+        }
     }
     currentTime_ += timeStep_;
 }
 
 
+void WorldBase::setNumThreads(int n)
+{
+    if(n < 1){
+        n = 1;
+    }
+    if(n != numThreads_){
+        numThreads_ = n;
+        if(n == 1){
+            threadPool.reset();
+        } else {
+            threadPool.reset(new ThreadPool(n));
+        }
+    }
+}
+
+
 int WorldBase::addBody(const DyBodyPtr& body)
 {
     if(!body->name().empty()){
@@ -7,6 +7,7 @@
 #define CNOID_BODY_DYWORLD_H_INCLUDED
 
 #include "ForwardDynamics.h"
+#include <boost/scoped_ptr.hpp>
 #include <map>
 #include "exportdecl.h"
 
@@ -15,6 +16,7 @@ namespace cnoid {
 class DyLink;
 class DyBody;
 typedef ref_ptr<DyBody> DyBodyPtr;
+class ThreadPool;
 
 class CNOID_EXPORT WorldBase
 {
@@ -136,6 +138,19 @@ public:
     */
     void setRungeKuttaMethod();
 
+    /**
+       @brief set the number of threads used for the forward dynamics computation
+       @param n the number of threads. The bodies are computed serially when n is 1.
+       @note The forward dynamics of each body is computed by one thread,
+       so the results are same as those of the serial computation.
+    */
+    void setNumThreads(int n);
+
+    /**
+       @brief get the number of threads used for the forward dynamics computation
+    */
+    int numThreads() const { return numThreads_; }
+
     /**
        @brief initialize this world. This must be called after all bodies are registered.
     */
@@ -190,6 +205,9 @@ private:
     LinkPairKeyToIndexMap linkPairKeyToIndexMap;
 
     int numRegisteredLinkPairs;
+
+    int numThreads_;
+    boost::scoped_ptr<ThreadPool> threadPool;
 		
 };
 
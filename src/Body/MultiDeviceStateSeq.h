@@ -12,9 +12,10 @@
 
 namespace cnoid {
 
-class CNOID_EXPORT MultiDeviceStateSeq : public MultiSeq<DeviceStatePtr>
+class CNOID_EXPORT MultiDeviceStateSeq
+    : public MultiSeq<DeviceStatePtr, std::allocator<DeviceStatePtr>, ChunkedDeque2D<DeviceStatePtr> >
 {
-    typedef MultiSeq<DeviceStatePtr> BaseSeqType;
+    typedef MultiSeq<DeviceStatePtr, std::allocator<DeviceStatePtr>, ChunkedDeque2D<DeviceStatePtr> > BaseSeqType;
             
 public:
     typedef boost::shared_ptr<MultiDeviceStateSeq> Ptr;
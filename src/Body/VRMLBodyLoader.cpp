@@ -18,6 +18,8 @@
 #include <boost/function.hpp>
 #include <boost/format.hpp>
 #include <boost/dynamic_bitset.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 #include "gettext.h"
 
 using namespace std;
@@ -133,6 +135,9 @@ struct ProtoInfo
 typedef map<string, ProtoInfo> ProtoInfoMap;
 ProtoInfoMap protoInfoMap;
 
+// The loaders may be created in several threads
+boost::mutex staticMapInitializationMutex;
+
 void throwExceptionOfIllegalField(VRMLProto* proto, const std::string& name, const char* label)
 {
     throw invalid_argument(
@@ -281,6 +286,8 @@ VRMLBodyLoaderImpl::VRMLBodyLoaderImpl()
     isVerbose = false;
     body = 0;
     os_ = &nullout();
+
+    boost::lock_guard<boost::mutex> lock(staticMapInitializationMutex);
     
     if(protoInfoMap.empty()){
         protoInfoMap["Humanoid"] = ProtoInfo(PROTO_HUMANOID, &VRMLBodyLoaderImpl::checkHumanoidProto);
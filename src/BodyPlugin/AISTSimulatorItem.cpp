@@ -13,6 +13,7 @@
 #include <cnoid/DyBody>
 #include <cnoid/ForwardDynamicsCBM>
 #include <cnoid/ConstraintForceSolver>
+#include <cnoid/CollisionDetector>
 #include <cnoid/LeggedBodyHelper>
 #include <cnoid/FloatingNumberString>
 #include <cnoid/EigenUtil>
@@ -146,11 +147,17 @@ public:
     FloatingNumberString contactCullingDepth;
     FloatingNumberString errorCriterion;
     int maxNumIterations;
+    bool areConstraintIslandsEnabled;
+    bool isWarmStartEnabled;
+    bool isMassMatrixAssemblyEnabled;
     FloatingNumberString contactCorrectionDepth;
     FloatingNumberString contactCorrectionVelocityRatio;
     double epsilon;
     bool is2Dmode;
     bool isKinematicWalkingEnabled;
+    int numCollisionDetectionThreads;
+    int numDynamicsThreads;
+    bool isGeometryCacheEnabled;
 
     typedef std::map<Body*, int> BodyIndexMap;
     BodyIndexMap bodyIndexMap;
@@ -208,11 +215,17 @@ AISTSimulatorItemImpl::AISTSimulatorItemImpl(AISTSimulatorItem* self)
     
     errorCriterion = cfs.gaussSeidelErrorCriterion();
     maxNumIterations = cfs.gaussSeidelMaxNumIterations();
+    areConstraintIslandsEnabled = false;
+    isWarmStartEnabled = false;
+    isMassMatrixAssemblyEnabled = false;
     contactCorrectionDepth = cfs.contactCorrectionDepth();
     contactCorrectionVelocityRatio = cfs.contactCorrectionVelocityRatio();
 
     isKinematicWalkingEnabled = false;
     is2Dmode = false;
+    numCollisionDetectionThreads = 1;
+    numDynamicsThreads = 1;
+    isGeometryCacheEnabled = true;
 }
 
 
@@ -236,11 +249,17 @@ AISTSimulatorItemImpl::AISTSimulatorItemImpl(AISTSimulatorItem* self, const AIST
     contactCullingDepth = org.contactCullingDepth;
     errorCriterion = org.errorCriterion;
     maxNumIterations = org.maxNumIterations;
+    areConstraintIslandsEnabled = org.areConstraintIslandsEnabled;
+    isWarmStartEnabled = org.isWarmStartEnabled;
+    isMassMatrixAssemblyEnabled = org.isMassMatrixAssemblyEnabled;
     contactCorrectionDepth = org.contactCorrectionDepth;
     contactCorrectionVelocityRatio = org.contactCorrectionVelocityRatio;
     epsilon = org.epsilon;
     isKinematicWalkingEnabled = org.isKinematicWalkingEnabled;
     is2Dmode = org.is2Dmode;
+    numCollisionDetectionThreads = org.numCollisionDetectionThreads;
+    numDynamicsThreads = org.numDynamicsThreads;
+    isGeometryCacheEnabled = org.isGeometryCacheEnabled;
 }
 
 
@@ -304,6 +323,24 @@ void AISTSimulatorItem::setMaxNumIterations(int value)
 }
 
 
+void AISTSimulatorItem::setConstraintIslandsEnabled(bool on)
+{
+    impl->areConstraintIslandsEnabled = on;
+}
+
+
+void AISTSimulatorItem::setWarmStartEnabled(bool on)
+{
+    impl->isWarmStartEnabled = on;
+}
+
+
+void AISTSimulatorItem::setMassMatrixAssemblyEnabled(bool on)
+{
+    impl->isMassMatrixAssemblyEnabled = on;
+}
+
+
 void AISTSimulatorItem::setContactCorrectionDepth(double value)
 {
     impl->contactCorrectionDepth = value;
@@ -334,6 +371,24 @@ void AISTSimulatorItem::setKinematicWalkingEnabled(bool on)
 }
 
 
+void AISTSimulatorItem::setNumCollisionDetectionThreads(int n)
+{
+    impl->numCollisionDetectionThreads = n;
+}
+
+
+void AISTSimulatorItem::setNumDynamicsThreads(int n)
+{
+    impl->numDynamicsThreads = n;
+}
+
+
+void AISTSimulatorItem::setGeometryCacheEnabled(bool on)
+{
+    impl->isGeometryCacheEnabled = on;
+}
+
+
 ItemPtr AISTSimulatorItem::doDuplicate() const
 {
     return new AISTSimulatorItem(*this);
@@ -388,11 +443,15 @@ bool AISTSimulatorItemImpl::initializeSimulation(const std::vector<SimulationBod
     world.enableSensors(true);
     world.setTimeStep(self->worldTimeStep());
     world.setCurrentTime(0.0);
+    world.setNumThreads(numDynamicsThreads);
 
     ConstraintForceSolver& cfs = world.constraintForceSolver;
 
     cfs.setGaussSeidelErrorCriterion(errorCriterion.value());
     cfs.setGaussSeidelMaxNumIterations(maxNumIterations);
+    cfs.enableConstraintIslands(areConstraintIslandsEnabled);
+    cfs.enableWarmStart(isWarmStartEnabled);
+    cfs.enableMassMatrixAssembly(isMassMatrixAssemblyEnabled);
     cfs.setContactDepthCorrection(
         contactCorrectionDepth.value(), contactCorrectionVelocityRatio.value());
 
@@ -406,7 +465,10 @@ bool AISTSimulatorItemImpl::initializeSimulation(const std::vector<SimulationBod
     cfs.setContactCullingDistance(contactCullingDistance.value());
     cfs.setContactCullingDepth(contactCullingDepth.value());
     cfs.setCoefficientOfRestitution(epsilon);
-    cfs.setCollisionDetector(self->collisionDetector());
+    CollisionDetectorPtr collisionDetector = self->collisionDetector();
+    collisionDetector->setNumThreads(numCollisionDetectionThreads);
+    collisionDetector->enableGeometryCache(isGeometryCacheEnabled);
+    cfs.setCollisionDetector(collisionDetector);
     
     if(is2Dmode){
         cfs.set2Dmode(true);
@@ -539,6 +601,9 @@ void AISTSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
     putProperty(_("Error criterion"), errorCriterion,
                 boost::bind(&FloatingNumberString::setPositiveValue, boost::ref(errorCriterion), _1));
     putProperty.min(1.0)(_("Max iterations"), maxNumIterations, changeProperty(maxNumIterations));
+    putProperty(_("Constraint islands"), areConstraintIslandsEnabled, changeProperty(areConstraintIslandsEnabled));
+    putProperty(_("Warm start"), isWarmStartEnabled, changeProperty(isWarmStartEnabled));
+    putProperty(_("Mass matrix assembly"), isMassMatrixAssemblyEnabled, changeProperty(isMassMatrixAssemblyEnabled));
     putProperty(_("CC depth"), contactCorrectionDepth,
                 boost::bind(&FloatingNumberString::setNonNegativeValue, boost::ref(contactCorrectionDepth), _1));
     putProperty(_("CC v-ratio"), contactCorrectionVelocityRatio,
@@ -546,6 +611,11 @@ void AISTSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
     putProperty(_("Kinematic walking"), isKinematicWalkingEnabled,
                 changeProperty(isKinematicWalkingEnabled));
     putProperty(_("2D mode"), is2Dmode, changeProperty(is2Dmode));
+    putProperty.min(1)(_("Collision detection threads"), numCollisionDetectionThreads,
+                       changeProperty(numCollisionDetectionThreads));
+    putProperty.min(1)(_("Dynamics threads"), numDynamicsThreads,
+                       changeProperty(numDynamicsThreads));
+    putProperty(_("Geometry cache"), isGeometryCacheEnabled, changeProperty(isGeometryCacheEnabled));
 }
 
 
@@ -571,10 +641,16 @@ bool AISTSimulatorItemImpl::store(Archive& archive)
     archive.write("contactCullingDepth", contactCullingDepth);
     archive.write("errorCriterion", errorCriterion);
     archive.write("maxNumIterations", maxNumIterations);
+    archive.write("constraintIslands", areConstraintIslandsEnabled);
+    archive.write("warmStart", isWarmStartEnabled);
+    archive.write("massMatrixAssembly", isMassMatrixAssemblyEnabled);
     archive.write("contactCorrectionDepth", contactCorrectionDepth);
     archive.write("contactCorrectionVelocityRatio", contactCorrectionVelocityRatio);
     archive.write("kinematicWalking", isKinematicWalkingEnabled);
     archive.write("2Dmode", is2Dmode);
+    archive.write("collisionDetectionThreads", numCollisionDetectionThreads);
+    archive.write("dynamicsThreads", numDynamicsThreads);
+    archive.write("geometryCache", isGeometryCacheEnabled);
     return true;
 }
 
@@ -602,9 +678,15 @@ bool AISTSimulatorItemImpl::restore(const Archive& archive)
     contactCullingDepth = archive.get("contactCullingDepth", contactCullingDepth.string());
     errorCriterion = archive.get("errorCriterion", errorCriterion.string());
     archive.read("maxNumIterations", maxNumIterations);
+    archive.read("constraintIslands", areConstraintIslandsEnabled);
+    archive.read("warmStart", isWarmStartEnabled);
+    archive.read("massMatrixAssembly", isMassMatrixAssemblyEnabled);
     contactCorrectionDepth = archive.get("contactCorrectionDepth", contactCorrectionDepth.string());
     contactCorrectionVelocityRatio = archive.get("contactCorrectionVelocityRatio", contactCorrectionVelocityRatio.string());
     archive.read("kinematicWalking", isKinematicWalkingEnabled);
     archive.read("2Dmode", is2Dmode);
+    archive.read("collisionDetectionThreads", numCollisionDetectionThreads);
+    archive.read("dynamicsThreads", numDynamicsThreads);
+    archive.read("geometryCache", isGeometryCacheEnabled);
     return true;
 }
@@ -35,11 +35,17 @@ public:
     void setContactCullingDepth(double value);        
     void setErrorCriterion(double value);        
     void setMaxNumIterations(int value);
+    void setConstraintIslandsEnabled(bool on);
+    void setWarmStartEnabled(bool on);
+    void setMassMatrixAssemblyEnabled(bool on);
     void setContactCorrectionDepth(double value);
     void setContactCorrectionVelocityRatio(double value);
     void setEpsilon(double epsilon);
     void set2Dmode(bool on);
     void setKinematicWalkingEnabled(bool on); 
+    void setNumCollisionDetectionThreads(int n);
+    void setNumDynamicsThreads(int n);
+    void setGeometryCacheEnabled(bool on);
 
 protected:
     virtual SimulationBodyPtr createSimulationBody(BodyPtr orgBody);
@@ -28,10 +28,14 @@
 #include <cnoid/PinDragIK>
 #include <cnoid/PenetrationBlocker>
 #include <cnoid/FileUtil>
+#include <cnoid/ProjectManager>
+#include <cnoid/ThreadPool>
 #include <boost/bind.hpp>
 #include <boost/make_shared.hpp>
 #include <bitset>
 #include <deque>
+#include <set>
+#include <sstream>
 #include <iostream>
 #include <algorithm>
 #include "gettext.h"
@@ -61,6 +65,76 @@ bool loadBodyItem(BodyItem* item, const std::string& filename)
     }
     return false;
 }
+
+
+void collectModelFiles(Archive& archive, set<string>& modelFiles)
+{
+    string className;
+    string pluginName;
+    if(archive.read("class", className) && className == "BodyItem" &&
+       archive.read("plugin", pluginName) && pluginName == "Body"){
+        Archive* data = archive.findSubArchive("data");
+        if(data->isValid()){
+            data->inheritSharedInfoFrom(archive);
+            string modelFile;
+            if(data->readRelocatablePath("modelFile", modelFile)){
+                modelFiles.insert(modelFile);
+            }
+        }
+    }
+    ListingPtr children = archive.findListing("children");
+    if(children->isValid()){
+        for(int i=0; i < children->size(); ++i){
+            Archive* childArchive = dynamic_cast<Archive*>(children->at(i)->toMapping());
+            if(childArchive){
+                childArchive->inheritSharedInfoFrom(archive);
+                collectModelFiles(*childArchive, modelFiles);
+            }
+        }
+    }
+}
+
+
+void loadModelFileIntoPrototypeCache(const string& filename)
+{
+    // The model which cannot be loaded here is loaded again in the main thread to output the messages
+    ostringstream os;
+    BodyLoader loader;
+    loader.setMessageSink(os);
+    loader.setPrototypeCacheEnabled(true);
+    loader.load(filename);
+}
+
+
+/**
+   The distinct model files of the body items in a project are loaded in parallel
+   before the items are restored one by one in the main thread. The loaded models
+   are kept in the prototype cache of BodyLoader, so the restoration of the body items
+   only clones them.
+*/
+void onItemsAboutToBeRestored(Archive& itemTreeArchive)
+{
+    set<string> modelFiles;
+    try {
+        collectModelFiles(itemTreeArchive, modelFiles);
+    } catch(const ValueNode::Exception&){
+        // The error is reported when the item is actually restored
+        return;
+    }
+    
+    // The models beyond the cache capacity would only evict the ones loaded before
+    const int numModelFiles = std::min((int)modelFiles.size(), BodyLoader::maxNumPrototypes());
+    const int numThreads = std::min(numModelFiles, (int)boost::thread::hardware_concurrency());
+    if(numThreads >= 2){
+        ThreadPool threadPool(numThreads);
+        set<string>::iterator p = modelFiles.begin();
+        for(int i=0; i < numModelFiles; ++i, ++p){
+            threadPool.start(boost::bind(loadModelFileIntoPrototypeCache, *p));
+        }
+        threadPool.wait();
+    }
+}
+
     
 void onSigOptionsParsed(boost::program_options::variables_map& variables)
 {
@@ -169,6 +243,8 @@ void BodyItem::initializeClass(ExtensionManager* ext)
             _("OpenHRP Model File"), "OpenHRP-VRML-MODEL", "wrl;yaml;dae;stl", boost::bind(loadBodyItem, _1, _2));
         ext->optionManager().addOption("hrpmodel", boost::program_options::value< vector<string> >(), "load an OpenHRP model file");
         ext->optionManager().sigOptionsParsed().connect(onSigOptionsParsed);
+        bodyLoader.setPrototypeCacheEnabled(true);
+        ProjectManager::instance()->sigItemsAboutToBeRestored().connect(onItemsAboutToBeRestored);
 
         linkVisibilityCheck = ext->menuManager().setPath("/Options/Scene View").addCheckItem(_("Show selected links only"));
 
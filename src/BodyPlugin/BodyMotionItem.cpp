@@ -89,6 +89,18 @@ static bool saveAsStandardYamlFormat(BodyMotionItem* item, const std::string& fi
     return fileIoSub(item, os, item->motion()->saveAsStandardYAMLformat(filename), false);
 }
 
+
+static bool loadBinaryFormat(BodyMotionItem* item, const std::string& filename, std::ostream& os)
+{
+    return fileIoSub(item, os, item->motion()->loadBinaryFormat(filename), true);
+}
+
+
+static bool saveAsBinaryFormat(BodyMotionItem* item, const std::string& filename, std::ostream& os)
+{
+    return fileIoSub(item, os, item->motion()->saveAsBinaryFormat(filename), false);
+}
+
 static bool bodyMotionItemPreFilter(BodyMotionItem* protoItem, Item* parentItem)
 {
     BodyItemPtr bodyItem = dynamic_cast<BodyItem*>(parentItem);
@@ -151,6 +163,10 @@ void BodyMotionItem::initializeClass(ExtensionManager* ext)
         _("Body Motion"), "BODY-MOTION-YAML", "yaml",
         boost::bind(loadStandardYamlFormat, _1, _2, _3),  boost::bind(saveAsStandardYamlFormat, _1, _2, _3));
 
+    im.addLoaderAndSaver<BodyMotionItem>(
+        _("Body Motion (Binary)"), "BODY-MOTION-BINARY", "bmb",
+        boost::bind(loadBinaryFormat, _1, _2, _3),  boost::bind(saveAsBinaryFormat, _1, _2, _3));
+
     initialized = true;
 }
 
@@ -23,6 +23,7 @@
 #include "SimulationBar.h"
 #include "AISTSimulatorItem.h"
 #include "GLVisionSimulatorItem.h"
+#include "RayCastRangeSensorSimulatorItem.h"
 #include "BodyMotionEngine.h"
 #include "EditableSceneBody.h"
 #include "HrpsysFileIO.h"
@@ -54,6 +55,7 @@ public:
         SimulatorItem::initializeClass(this);
         AISTSimulatorItem::initializeClass(this);
         GLVisionSimulatorItem::initializeClass(this);
+        RayCastRangeSensorSimulatorItem::initializeClass(this);
 
         BodyMotionEngine::initialize(this);
         //initializeFilterDialogs(*this);
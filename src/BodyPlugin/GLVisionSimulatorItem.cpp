@@ -83,6 +83,29 @@ bool updateNames(const string& nameListString, string& newNameListString, vector
 }
 
 
+/**
+   The scene, the OpenGL context and the renderer used for rendering the images of vision sensors.
+   Each sensor has its own context by default. When the shared scene is enabled, all the sensors
+   share one context, and each sensor only sets the viewport and the camera before rendering.
+*/
+class RenderingContext : public Referenced
+{
+public:
+    SgGroupPtr sceneGroup;
+    vector<SceneBodyPtr> sceneBodies;
+    QGLPixelBuffer* pixelBuffer;
+    GLSceneRenderer renderer;
+    SgUpdate modified;
+
+    RenderingContext() : pixelBuffer(0), modified(SgUpdate::MODIFIED) { }
+    void initializeScene(GLVisionSimulatorItemImpl* simImpl, const vector<SimulationBody*>& simBodies);
+    void initializeGL(GLVisionSimulatorItemImpl* simImpl, int width, int height);
+    void updateScene();
+    ~RenderingContext();
+};
+typedef ref_ptr<RenderingContext> RenderingContextPtr;
+
+
 class VisionRenderer : public Referenced
 {
 public:
@@ -111,11 +134,8 @@ public:
     RangeSensorPtr rangeSensorForRendering;
     double depthError;
         
-    SgGroupPtr sceneGroup;
-    vector<SceneBodyPtr> sceneBodies;
-
-    QGLPixelBuffer* pixelBuffer;
-    GLSceneRenderer renderer;
+    RenderingContextPtr context;
+    SgCamera* sceneCamera;
     int pixelWidth;
     int pixelHeight;
     boost::shared_ptr<Image> tmpImage;
@@ -126,9 +146,9 @@ public:
 
     VisionRenderer(GLVisionSimulatorItemImpl* simImpl, VisionSensor* sensor, SimulationBody* simBody, int bodyIndex);
     bool initialize(const vector<SimulationBody*>& simBodies);
-    void initializeScene(const vector<SimulationBody*>& simBodies);
     SgCamera* initializeCamera();
     void updateScene(bool updateSensorForRenderingThread);
+    void render();
     void renderInCurrenThread(bool doStoreResultToTmpDataBuffer);
     void startConcurrentRendering();
     void concurrentRenderingLoop();
@@ -165,6 +185,11 @@ public:
     bool isBestEffortMode;
     bool isQueueRenderingTerminationRequested;
 
+    // for the rendering with the shared scene
+    RenderingContextPtr sharedContext;
+    vector<VisionRenderer*> renderersToStart;
+    int numRenderersInQueue;
+
     // for the single vision simulator thread rendering
     boost::thread queueThread;
     boost::condition_variable queueCondition;
@@ -182,9 +207,11 @@ public:
     bool useThreadProperty;
     bool useThreadsForSensorsProperty;
     bool isBestEffortModeProperty;
+    bool isSharedSceneEnabled;
     bool shootAllSceneObjects;
     bool isHeadLightEnabled;
     bool areAdditionalLightsEnabled;
+    bool isVertexBufferObjectEnabled;
     double maxFrameRate;
     double maxLatency;
     SgCloneMap cloneMap;
@@ -196,6 +223,7 @@ public:
     bool initializeSimulation(SimulatorItem* simulatorItem);
     void addTargetSensor(SimulationBody* simBody, int bodyIndex, VisionSensor* sensor);
     void onPreDynamics();
+    void startRenderingWithSharedScene();
     void queueRenderingLoop();
     void onPostDynamics();
     void getVisionDataInThreadsForSensors();
@@ -236,8 +264,10 @@ GLVisionSimulatorItemImpl::GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self
     useThreadProperty = true;
     useThreadsForSensorsProperty = true;
     isBestEffortModeProperty = false;
+    isSharedSceneEnabled = false;
     isHeadLightEnabled = true;
     areAdditionalLightsEnabled = true;
+    isVertexBufferObjectEnabled = false;
     shootAllSceneObjects = false;
 }
 
@@ -266,9 +296,11 @@ GLVisionSimulatorItemImpl::GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self
     useThreadProperty = org.useThreadProperty;
     useThreadsForSensorsProperty = org.useThreadsForSensorsProperty;
     isBestEffortModeProperty = org.isBestEffortModeProperty;
+    isSharedSceneEnabled = org.isSharedSceneEnabled;
     shootAllSceneObjects = org.shootAllSceneObjects;
     isHeadLightEnabled = org.isHeadLightEnabled;
     areAdditionalLightsEnabled = org.areAdditionalLightsEnabled;
+    isVertexBufferObjectEnabled = org.isVertexBufferObjectEnabled;
     maxFrameRate = org.maxFrameRate;
     maxLatency = org.maxLatency;
 }
@@ -322,7 +354,8 @@ bool GLVisionSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorIte
 
     useThread = useThreadProperty;
     if(useThread){
-        if(useThreadsForSensorsProperty){
+        // The shared context can only be current in one thread
+        if(useThreadsForSensorsProperty && !isSharedSceneEnabled){
             useQueueThreadForAllSensors = false;
             useThreadsForSensors = true;
         } else {
@@ -336,6 +369,7 @@ bool GLVisionSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorIte
     
     isBestEffortMode = isBestEffortModeProperty;
     renderersInRendering.clear();
+    numRenderersInQueue = 0;
 
     cloneMap.clear();
 #ifdef CNOID_REFERENCED_USE_ATOMIC_COUNTER
@@ -389,6 +423,13 @@ bool GLVisionSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorIte
         //! todo restore the previous focus here
     }
 #endif
+
+    if(isSharedSceneEnabled){
+        sharedContext = new RenderingContext;
+        sharedContext->initializeScene(this, simBodies);
+    } else {
+        sharedContext = 0;
+    }
     
     vector<VisionRendererPtr>::iterator p = visionRenderers.begin();
     while(p != visionRenderers.end()){
@@ -402,6 +443,17 @@ bool GLVisionSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorIte
         }
     }
 
+    if(sharedContext && !visionRenderers.empty()){
+        // Each sensor renders its image at the lower left corner of the shared buffer
+        int width = 1;
+        int height = 1;
+        for(size_t i=0; i < visionRenderers.size(); ++i){
+            width = std::max(width, visionRenderers[i]->pixelWidth);
+            height = std::max(height, visionRenderers[i]->pixelHeight);
+        }
+        sharedContext->initializeGL(this, width, height);
+    }
+
     if(!visionRenderers.empty()){
         simulatorItem->addPreDynamicsFunction(boost::bind(&GLVisionSimulatorItemImpl::onPreDynamics, this));
         simulatorItem->addPostDynamicsFunction(boost::bind(&GLVisionSimulatorItemImpl::onPostDynamics, this));
@@ -453,32 +505,28 @@ VisionRenderer::VisionRenderer(GLVisionSimulatorItemImpl* simImpl, VisionSensor*
         rangeSensorForRendering = rangeSensor;
     }
 
-    pixelBuffer = 0;
+    sceneCamera = 0;
 }
 
 
 bool VisionRenderer::initialize(const vector<SimulationBody*>& simBodies)
 {
-    initializeScene(simBodies);
+    if(simImpl->sharedContext){
+        context = simImpl->sharedContext;
+    } else {
+        context = new RenderingContext;
+        context->initializeScene(simImpl, simBodies);
+    }
 
-    SgCamera* sceneCamera = initializeCamera();
+    sceneCamera = initializeCamera();
 
     if(!sceneCamera){
         return false;
     }
-    
-    renderer.sceneRoot()->addChild(sceneGroup);
-    
-    pixelBuffer = new QGLPixelBuffer(pixelWidth, pixelHeight, simImpl->glFormat);
-    pixelBuffer->makeCurrent();
 
-    renderer.initializeGL();
-    renderer.setViewport(0, 0, pixelWidth, pixelHeight);
-    renderer.initializeRendering();
-    renderer.headLight()->on(simImpl->isHeadLightEnabled);
-    renderer.enableAdditionalLights(simImpl->areAdditionalLightsEnabled);
-    renderer.setCurrentCamera(sceneCamera);
-    pixelBuffer->doneCurrent();
+    if(!simImpl->sharedContext){
+        context->initializeGL(simImpl, pixelWidth, pixelHeight);
+    }
 
     isRendering = false;
     elapsedTime = cycleTime + 1.0e-6;
@@ -503,7 +551,7 @@ bool VisionRenderer::initialize(const vector<SimulationBody*>& simBodies)
 /**
    \todo use cache of the cloned scene graph nodes
 */
-void VisionRenderer::initializeScene(const vector<SimulationBody*>& simBodies)
+void RenderingContext::initializeScene(GLVisionSimulatorItemImpl* simImpl, const vector<SimulationBody*>& simBodies)
 {
     sceneGroup = new SgGroup;
 
@@ -539,13 +587,50 @@ void VisionRenderer::initializeScene(const vector<SimulationBody*>& simBodies)
             }
         }
     }
+
+    renderer.sceneRoot()->addChild(sceneGroup);
+}
+
+
+void RenderingContext::initializeGL(GLVisionSimulatorItemImpl* simImpl, int width, int height)
+{
+    pixelBuffer = new QGLPixelBuffer(width, height, simImpl->glFormat);
+    pixelBuffer->makeCurrent();
+
+    renderer.initializeGL();
+    renderer.setViewport(0, 0, width, height);
+    renderer.initializeRendering();
+    renderer.headLight()->on(simImpl->isHeadLightEnabled);
+    renderer.enableAdditionalLights(simImpl->areAdditionalLightsEnabled);
+    renderer.enableVertexBufferObject(simImpl->isVertexBufferObjectEnabled);
+    pixelBuffer->doneCurrent();
+}
+
+
+void RenderingContext::updateScene()
+{
+    for(size_t i=0; i < sceneBodies.size(); ++i){
+        SceneBody* sceneBody = sceneBodies[i];
+        // The update is notified so that the bounding boxes used for the frustum culling are invalidated
+        sceneBody->updateLinkPositions(modified);
+        sceneBody->updateSceneDevices();
+    }
+}
+
+
+RenderingContext::~RenderingContext()
+{
+    if(pixelBuffer){
+        pixelBuffer->makeCurrent();
+        delete pixelBuffer;
+    }
 }
 
 
 SgCamera* VisionRenderer::initializeCamera()
 {
     SgCamera* sceneCamera = 0;
-    SceneBody* sceneBody = sceneBodies[bodyIndex];
+    SceneBody* sceneBody = context->sceneBodies[bodyIndex];
 
     if(camera){
         SceneDevice* sceneDevice = sceneBody->getSceneDevice(sensor);
@@ -616,6 +701,11 @@ void GLVisionSimulatorItemImpl::onPreDynamics()
 {
     currentTime = simulatorItem->currentTime();
 
+    if(sharedContext){
+        startRenderingWithSharedScene();
+        return;
+    }
+
     boost::mutex* pQueueMutex = 0;
     
     for(size_t i=0; i < visionRenderers.size(); ++i){
@@ -651,6 +741,65 @@ void GLVisionSimulatorItemImpl::onPreDynamics()
 }
 
 
+/**
+   The sensors to render in this step are rendered in a batch after the shared scene is updated once.
+   The scene is not updated until the previous batch is finished in the queue thread.
+*/
+void GLVisionSimulatorItemImpl::startRenderingWithSharedScene()
+{
+    renderersToStart.clear();
+    for(size_t i=0; i < visionRenderers.size(); ++i){
+        VisionRenderer* renderer = visionRenderers[i];
+        if(renderer->elapsedTime >= renderer->cycleTime && !renderer->isRendering){
+            renderersToStart.push_back(renderer);
+        }
+    }
+
+    if(!renderersToStart.empty()){
+        boost::unique_lock<boost::mutex> lock(queueMutex, boost::defer_lock);
+        if(useQueueThreadForAllSensors){
+            lock.lock();
+            if(numRenderersInQueue > 0){
+                if(isBestEffortMode){
+                    // The sensors are started in the later step
+                    renderersToStart.clear();
+                } else {
+                    while(numRenderersInQueue > 0){
+                        queueCondition.wait(lock);
+                    }
+                }
+            }
+        }
+        if(!renderersToStart.empty()){
+            sharedContext->updateScene();
+        }
+        for(size_t i=0; i < renderersToStart.size(); ++i){
+            VisionRenderer* renderer = renderersToStart[i];
+            renderer->onsetTime = currentTime;
+            renderer->isRendering = true;
+            if(useQueueThreadForAllSensors){
+                renderer->sensorForRendering->copyStateFrom(*renderer->sensor);
+                rendererQueue.push(renderer);
+                ++numRenderersInQueue;
+            } else {
+                // The result must be read before the next sensor is rendered in the shared buffer
+                renderer->renderInCurrenThread(true);
+            }
+            renderer->elapsedTime -= renderer->cycleTime;
+            renderersInRendering.push_back(renderer);
+        }
+        if(lock.owns_lock()){
+            lock.unlock();
+            queueCondition.notify_all();
+        }
+    }
+
+    for(size_t i=0; i < visionRenderers.size(); ++i){
+        visionRenderers[i]->elapsedTime += worldTimeStep;
+    }
+}
+
+
 void GLVisionSimulatorItemImpl::queueRenderingLoop()
 {
     VisionRenderer* renderer = 0;
@@ -675,6 +824,7 @@ void GLVisionSimulatorItemImpl::queueRenderingLoop()
         {
             boost::unique_lock<boost::mutex> lock(queueMutex);
             renderer->isRenderingFinished = true;
+            --numRenderersInQueue;
         }
         queueCondition.notify_all();
     }
@@ -686,26 +836,31 @@ exitRenderingQueueLoop:
 
 void VisionRenderer::updateScene(bool updateSensorForRenderingThread)
 {
-    for(size_t i=0; i < sceneBodies.size(); ++i){
-        SceneBody* sceneBody = sceneBodies[i];
-        sceneBody->updateLinkPositions();
-        sceneBody->updateSceneDevices();
-    }
+    context->updateScene();
     if(updateSensorForRenderingThread){
         sensorForRendering->copyStateFrom(*sensor);
     }
 }
 
 
-void VisionRenderer::renderInCurrenThread(bool doStoreResultToTmpDataBuffer)
+void VisionRenderer::render()
 {
-    pixelBuffer->makeCurrent();
+    GLSceneRenderer& renderer = context->renderer;
+    renderer.setViewport(0, 0, pixelWidth, pixelHeight);
+    renderer.setCurrentCamera(sceneCamera);
     renderer.render();
     renderer.flush();
+}
+
+
+void VisionRenderer::renderInCurrenThread(bool doStoreResultToTmpDataBuffer)
+{
+    context->pixelBuffer->makeCurrent();
+    render();
     if(doStoreResultToTmpDataBuffer){
         storeResultToTmpDataBuffer();
     }
-    pixelBuffer->doneCurrent();
+    context->pixelBuffer->doneCurrent();
 }
 
 
@@ -723,7 +878,7 @@ void VisionRenderer::startConcurrentRendering()
 
 void VisionRenderer::concurrentRenderingLoop()
 {
-    pixelBuffer->makeCurrent();
+    context->pixelBuffer->makeCurrent();
     
     while(true){
         {
@@ -739,8 +894,7 @@ void VisionRenderer::concurrentRenderingLoop()
                 renderingCondition.wait(lock);
             }
         }
-        renderer.render();
-        renderer.flush();
+        render();
         storeResultToTmpDataBuffer();
     
         {
@@ -751,7 +905,7 @@ void VisionRenderer::concurrentRenderingLoop()
     }
     
 exitConcurrentRenderingLoop:
-    pixelBuffer->doneCurrent();
+    context->pixelBuffer->doneCurrent();
     return;
 }
 
@@ -784,7 +938,12 @@ void GLVisionSimulatorItemImpl::onPostDynamics()
     } else {
         for(size_t i=0; i < renderersInRendering.size(); ++i){
             VisionRenderer* renderer = renderersInRendering[i];
-            renderer->updateVisionData();
+            if(sharedContext){
+                renderer->copyVisionData();
+            } else {
+                renderer->updateVisionData();
+            }
+            renderer->isRendering = false;
         }
         renderersInRendering.clear();
     }
@@ -899,7 +1058,7 @@ void VisionRenderer::copyVisionData()
 
 void VisionRenderer::updateVisionData()
 {
-    pixelBuffer->makeCurrent();
+    context->pixelBuffer->makeCurrent();
     bool updated = false;
     if(camera){
         if(rangeCamera){
@@ -910,7 +1069,7 @@ void VisionRenderer::updateVisionData()
     } else if(rangeSensor){
         updated = getRangeSensorData(rangeSensor->newRangeData());
     }
-    pixelBuffer->doneCurrent();
+    context->pixelBuffer->doneCurrent();
     
     if(updated){
         sensor->setDelay(simImpl->currentTime - onsetTime);
@@ -954,7 +1113,7 @@ bool VisionRenderer::getRangeCameraData(Image& image, vector<Vector3f>& points)
 
     float* depthBuf = (float*)alloca(pixelWidth * pixelHeight * sizeof(float));
     glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, depthBuf);
-    const Matrix4f Pinv = renderer.projectionMatrix().inverse().cast<float>();
+    const Matrix4f Pinv = context->renderer.projectionMatrix().inverse().cast<float>();
     const float fw = pixelWidth;
     const float fh = pixelHeight;
     Vector4f n;
@@ -1024,7 +1183,7 @@ bool VisionRenderer::getRangeSensorData(vector<double>& rangeData)
     const double pitchStep = rangeSensorForRendering->pitchStep();
     const double maxTanPitchAngle = tan(pitchRange / 2.0);
 
-    const Matrix4 Pinv = renderer.projectionMatrix().inverse();
+    const Matrix4 Pinv = context->renderer.projectionMatrix().inverse();
     const double Pinv_32 = Pinv(3, 2);
     const double Pinv_33 = Pinv(3, 3);
     const double fw = pixelWidth;
@@ -1094,6 +1253,7 @@ void GLVisionSimulatorItemImpl::finalizeSimulation()
     }
         
     visionRenderers.clear();
+    sharedContext = 0;
 }
 
 
@@ -1107,10 +1267,6 @@ VisionRenderer::~VisionRenderer()
         renderingCondition.notify_all();
         renderingThread.join();
     }
-    if(pixelBuffer){
-        pixelBuffer->makeCurrent();
-        delete pixelBuffer;
-    }
 }
     
 
@@ -1131,12 +1287,14 @@ void GLVisionSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty
     putProperty(_("Use thread"), useThreadProperty, changeProperty(useThreadProperty));
     putProperty(_("Threads for sensors"), useThreadsForSensorsProperty, changeProperty(useThreadsForSensorsProperty));
     putProperty(_("Best effort"), isBestEffortModeProperty, changeProperty(isBestEffortModeProperty));
+    putProperty(_("Shared scene"), isSharedSceneEnabled, changeProperty(isSharedSceneEnabled));
     putProperty(_("All scene objects"), shootAllSceneObjects, changeProperty(shootAllSceneObjects));
     putProperty.min(1.0)(_("Precision ratio of range sensors"),
                          rangeSensorPrecisionRatio, changeProperty(rangeSensorPrecisionRatio));
     putProperty.reset()(_("Depth error"), depthError, changeProperty(depthError));
     putProperty.reset()(_("Head light"), isHeadLightEnabled, changeProperty(isHeadLightEnabled));
     putProperty.reset()(_("Additional lights"), areAdditionalLightsEnabled, changeProperty(areAdditionalLightsEnabled));
+    putProperty(_("Vertex buffer objects"), isVertexBufferObjectEnabled, changeProperty(isVertexBufferObjectEnabled));
 }
 
 
@@ -1158,11 +1316,13 @@ bool GLVisionSimulatorItemImpl::store(Archive& archive)
     archive.write("useThread", useThreadProperty);
     archive.write("useThreadsForSensors", useThreadsForSensorsProperty);
     archive.write("bestEffort", isBestEffortModeProperty);
+    archive.write("useSharedScene", isSharedSceneEnabled);
     archive.write("allSceneObjects", shootAllSceneObjects);
     archive.write("rangeSensorPrecisionRatio", rangeSensorPrecisionRatio);
     archive.write("depthError", depthError);
     archive.write("enableHeadLight", isHeadLightEnabled);    
     archive.write("enableAdditionalLights", areAdditionalLightsEnabled);
+    archive.write("useVertexBufferObjects", isVertexBufferObjectEnabled);
     return true;
 }
 
@@ -1193,10 +1353,12 @@ bool GLVisionSimulatorItemImpl::restore(const Archive& archive)
     }
 
     archive.read("bestEffort", isBestEffortModeProperty);
+    archive.read("useSharedScene", isSharedSceneEnabled);
     archive.read("allSceneObjects", shootAllSceneObjects);
     archive.read("rangeSensorPrecisionRatio", rangeSensorPrecisionRatio);
     archive.read("depthError", depthError);
     archive.read("enableHeadLight", isHeadLightEnabled);
     archive.read("enableAdditionalLights", areAdditionalLightsEnabled);
+    archive.read("useVertexBufferObjects", isVertexBufferObjectEnabled);
     return true;
 }
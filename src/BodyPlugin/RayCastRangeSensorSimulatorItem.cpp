@@ -0,0 +1,550 @@
+/*!
+  @file
+  @author Shin'ichiro Nakaoka
+*/
+
+#include "RayCastRangeSensorSimulatorItem.h"
+#include "SimulatorItem.h"
+#include <cnoid/ItemManager>
+#include <cnoid/MessageView>
+#include <cnoid/Archive>
+#include <cnoid/ValueTreeUtil>
+#include <cnoid/Body>
+#include <cnoid/RangeSensor>
+#include <cnoid/ColdetModel>
+#include <cnoid/MeshExtractor>
+#include <cnoid/ThreadPool>
+#include <boost/scoped_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/tokenizer.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <set>
+#include <limits>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+
+namespace {
+
+// The rays of a sensor are divided into the chunks of this size to balance the load of the threads
+const int NUM_RAYS_PER_CHUNK = 256;
+
+string getNameListString(const vector<string>& names)
+{
+    string nameList;
+    if(!names.empty()){
+        size_t n = names.size() - 1;
+        for(size_t i=0; i < n; ++i){
+            nameList += names[i];
+            nameList += ", ";
+        }
+        nameList += names.back();
+    }
+    return nameList;
+}
+
+bool updateNames(const string& nameListString, string& newNameListString, vector<string>& names)
+{
+    using boost::tokenizer;
+    using boost::char_separator;
+
+    names.clear();
+    char_separator<char> sep(",");
+    tokenizer< char_separator<char> > tok(nameListString, sep);
+    for(tokenizer< char_separator<char> >::iterator p = tok.begin(); p != tok.end(); ++p){
+        string name = boost::trim_copy(*p);
+        if(!name.empty()){
+            names.push_back(name);
+        }
+    }
+    newNameListString = nameListString;
+    return true;
+}
+
+
+struct LinkModel
+{
+    Link* link;
+    ColdetModelPtr model;
+    Vector3 localCenter;
+    double radius;
+    Vector3 center; // in the world coordinate
+};
+
+
+class RangeSensorCaster : public Referenced
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+    RangeSensorPtr rangeSensor;
+    SimulationBody* simBody;
+    double elapsedTime;
+    double cycleTime;
+
+    // The directions of the rays in the sensor coordinate
+    vector<Vector3> rayDirections;
+
+    // The following members are only referred to by the threads during the scan
+    Position T_sensor;
+    vector<LinkModel*> targetModels;
+    boost::shared_ptr<RangeSensor::RangeData> rangeData;
+
+    RangeSensorCaster(RangeSensor* rangeSensor, SimulationBody* simBody);
+    void castRays(int begin, int end, double depthError);
+};
+typedef ref_ptr<RangeSensorCaster> RangeSensorCasterPtr;
+
+}
+
+namespace cnoid {
+
+class RayCastRangeSensorSimulatorItemImpl
+{
+public:
+    RayCastRangeSensorSimulatorItem* self;
+    ostream& os;
+    SimulatorItem* simulatorItem;
+    double worldTimeStep;
+    vector<LinkModel> linkModels;
+    vector<RangeSensorCasterPtr> casters;
+    vector<RangeSensorCaster*> castersInScanning;
+    boost::scoped_ptr<ThreadPool> threadPool;
+    MeshExtractor meshExtractor;
+
+    vector<string> bodyNames;
+    string bodyNameListString;
+    vector<string> sensorNames;
+    string sensorNameListString;
+    bool isEnabled;
+    bool isVisionDataRecordingEnabled;
+    double maxFrameRate;
+    int numThreads;
+    double depthError;
+
+    RayCastRangeSensorSimulatorItemImpl(RayCastRangeSensorSimulatorItem* self);
+    RayCastRangeSensorSimulatorItemImpl(RayCastRangeSensorSimulatorItem* self, const RayCastRangeSensorSimulatorItemImpl& org);
+    bool initializeSimulation(SimulatorItem* simulatorItem);
+    void addLinkModels(Body* body);
+    void addMesh(ColdetModel* model);
+    void startScan(RangeSensorCaster* caster);
+    void onPreDynamics();
+    void onPostDynamics();
+    void finalizeSimulation();
+    void doPutProperties(PutPropertyFunction& putProperty);
+    bool store(Archive& archive);
+    bool restore(const Archive& archive);
+};
+
+}
+
+
+void RayCastRangeSensorSimulatorItem::initializeClass(ExtensionManager* ext)
+{
+    ext->itemManager().registerClass<RayCastRangeSensorSimulatorItem>(N_("RayCastRangeSensorSimulatorItem"));
+    ext->itemManager().addCreationPanel<RayCastRangeSensorSimulatorItem>();
+}
+
+
+RayCastRangeSensorSimulatorItem::RayCastRangeSensorSimulatorItem()
+{
+    impl = new RayCastRangeSensorSimulatorItemImpl(this);
+}
+
+
+RayCastRangeSensorSimulatorItemImpl::RayCastRangeSensorSimulatorItemImpl(RayCastRangeSensorSimulatorItem* self)
+    : self(self),
+      os(MessageView::instance()->cout())
+{
+    simulatorItem = 0;
+    isEnabled = true;
+    isVisionDataRecordingEnabled = false;
+    maxFrameRate = 1000.0;
+    numThreads = std::max(1, (int)boost::thread::hardware_concurrency());
+    depthError = 0.0;
+}
+
+
+RayCastRangeSensorSimulatorItem::RayCastRangeSensorSimulatorItem(const RayCastRangeSensorSimulatorItem& org)
+    : SubSimulatorItem(org)
+{
+    impl = new RayCastRangeSensorSimulatorItemImpl(this, *org.impl);
+}
+
+
+RayCastRangeSensorSimulatorItemImpl::RayCastRangeSensorSimulatorItemImpl
+(RayCastRangeSensorSimulatorItem* self, const RayCastRangeSensorSimulatorItemImpl& org)
+    : self(self),
+      os(MessageView::instance()->cout()),
+      bodyNames(org.bodyNames),
+      sensorNames(org.sensorNames)
+{
+    simulatorItem = 0;
+    bodyNameListString = getNameListString(bodyNames);
+    sensorNameListString = getNameListString(sensorNames);
+    isEnabled = org.isEnabled;
+    isVisionDataRecordingEnabled = org.isVisionDataRecordingEnabled;
+    maxFrameRate = org.maxFrameRate;
+    numThreads = org.numThreads;
+    depthError = org.depthError;
+}
+
+
+RayCastRangeSensorSimulatorItem::~RayCastRangeSensorSimulatorItem()
+{
+    delete impl;
+}
+
+
+bool RayCastRangeSensorSimulatorItem::isEnabled()
+{
+    return impl->isEnabled;
+}
+
+
+ItemPtr RayCastRangeSensorSimulatorItem::doDuplicate() const
+{
+    return new RayCastRangeSensorSimulatorItem(*this);
+}
+
+
+bool RayCastRangeSensorSimulatorItem::initializeSimulation(SimulatorItem* simulatorItem)
+{
+    return impl->initializeSimulation(simulatorItem);
+}
+
+
+bool RayCastRangeSensorSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorItem)
+{
+    this->simulatorItem = simulatorItem;
+    worldTimeStep = simulatorItem->worldTimeStep();
+    linkModels.clear();
+    casters.clear();
+    castersInScanning.clear();
+
+    std::set<string> bodyNameSet(bodyNames.begin(), bodyNames.end());
+    std::set<string> sensorNameSet(sensorNames.begin(), sensorNames.end());
+
+    const vector<SimulationBody*>& simBodies = simulatorItem->simulationBodies();
+    for(size_t i=0; i < simBodies.size(); ++i){
+        SimulationBody* simBody = simBodies[i];
+        Body* body = simBody->body();
+        addLinkModels(body);
+        if(bodyNameSet.empty() || bodyNameSet.find(body->name()) != bodyNameSet.end()){
+            DeviceList<RangeSensor> sensors = body->devices<RangeSensor>();
+            for(size_t j=0; j < sensors.size(); ++j){
+                RangeSensor* sensor = sensors[j];
+                if(sensorNameSet.empty() || sensorNameSet.find(sensor->name()) != sensorNameSet.end()){
+                    os << (format(_("%1% detected range sensor \"%2%\" of %3% as a target."))
+                           % self->name() % sensor->name() % body->name()) << endl;
+                    RangeSensorCaster* caster = new RangeSensorCaster(sensor, simBody);
+                    const double frameRate = std::max(0.1, std::min(sensor->frameRate(), maxFrameRate));
+                    caster->cycleTime = 1.0 / frameRate;
+                    caster->elapsedTime = caster->cycleTime + 1.0e-6;
+                    if(isVisionDataRecordingEnabled){
+                        sensor->setRangeDataAsState(true);
+                    }
+                    casters.push_back(caster);
+                }
+            }
+        }
+    }
+
+    if(casters.empty()){
+        os << (format(_("%1% has no target sensors")) % self->name()) << endl;
+        return false;
+    }
+
+    if(numThreads > 1){
+        threadPool.reset(new ThreadPool(numThreads));
+    }
+
+    simulatorItem->addPreDynamicsFunction(boost::bind(&RayCastRangeSensorSimulatorItemImpl::onPreDynamics, this));
+    simulatorItem->addPostDynamicsFunction(boost::bind(&RayCastRangeSensorSimulatorItemImpl::onPostDynamics, this));
+
+    return true;
+}
+
+
+void RayCastRangeSensorSimulatorItemImpl::addLinkModels(Body* body)
+{
+    for(int i=0; i < body->numLinks(); ++i){
+        Link* link = body->link(i);
+        SgNode* shape = link->shape();
+        if(shape){
+            ColdetModelPtr model = boost::make_shared<ColdetModel>();
+            if(meshExtractor.extract(shape, boost::bind(&RayCastRangeSensorSimulatorItemImpl::addMesh, this, model.get()))){
+                model->setName(link->name());
+                model->build();
+                if(model->isValid()){
+                    linkModels.push_back(LinkModel());
+                    LinkModel& linkModel = linkModels.back();
+                    linkModel.link = link;
+                    linkModel.model = model;
+                    vector<Vector3> rootBox;
+                    model->getBoundingBoxData(0, rootBox);
+                    if(rootBox.size() >= 2){
+                        linkModel.localCenter = rootBox[0];
+                        linkModel.radius = rootBox[1].norm();
+                    } else {
+                        linkModel.localCenter.setZero();
+                        linkModel.radius = std::numeric_limits<double>::max();
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+void RayCastRangeSensorSimulatorItemImpl::addMesh(ColdetModel* model)
+{
+    SgMesh* mesh = meshExtractor.currentMesh();
+    const Affine3& T = meshExtractor.currentTransform();
+
+    const int vertexIndexTop = model->getNumVertices();
+
+    const SgVertexArray& vertices = *mesh->vertices();
+    const int numVertices = vertices.size();
+    for(int i=0; i < numVertices; ++i){
+        const Vector3 v = T * vertices[i].cast<Affine3::Scalar>();
+        model->addVertex(v.x(), v.y(), v.z());
+    }
+
+    const int numTriangles = mesh->numTriangles();
+    for(int i=0; i < numTriangles; ++i){
+        SgMesh::TriangleRef tri = mesh->triangle(i);
+        model->addTriangle(vertexIndexTop + tri[0], vertexIndexTop + tri[1], vertexIndexTop + tri[2]);
+    }
+}
+
+
+/**
+   The yaw angle rotates the ray around the Y axis and the pitch angle around the X axis of
+   the sensor coordinate, where the sensor looks at the -Z direction. The order of the data is
+   same as that of GLVisionSimulatorItem.
+*/
+RangeSensorCaster::RangeSensorCaster(RangeSensor* rangeSensor, SimulationBody* simBody)
+    : rangeSensor(rangeSensor),
+      simBody(simBody)
+{
+    const double yawRange = rangeSensor->yawRange();
+    const int yawResolution = rangeSensor->yawResolution();
+    const double yawStep = rangeSensor->yawStep();
+    const double pitchRange = rangeSensor->pitchRange();
+    const int pitchResolution = rangeSensor->pitchResolution();
+    const double pitchStep = rangeSensor->pitchStep();
+
+    rayDirections.reserve(yawResolution * pitchResolution);
+    for(int pitch=0; pitch < pitchResolution; ++pitch){
+        const double pitchAngle = pitch * pitchStep - pitchRange / 2.0;
+        const double cosPitchAngle = cos(pitchAngle);
+        const double sinPitchAngle = sin(pitchAngle);
+        for(int yaw=0; yaw < yawResolution; ++yaw){
+            const double yawAngle = yaw * yawStep - yawRange / 2.0;
+            rayDirections.push_back(
+                Vector3(-sin(yawAngle) * cosPitchAngle, sinPitchAngle, -cos(yawAngle) * cosPitchAngle));
+        }
+    }
+}
+
+
+/**
+   The rays start from the points of the minimum distance so that the shapes closer than
+   the minimum distance are ignored like the near clipping plane of the rendering.
+   The back faces are culled by the ray collider, so the shape enclosing the sensor
+   such as its housing does not block the rays.
+*/
+void RangeSensorCaster::castRays(int begin, int end, double depthError)
+{
+    const double minDistance = rangeSensor->minDistance();
+    const double maxDistance = rangeSensor->maxDistance();
+    const Matrix3 R = T_sensor.linear();
+    const Vector3 p = T_sensor.translation();
+    const int numTargetModels = targetModels.size();
+    RangeSensor::RangeData& data = *rangeData;
+
+    for(int i=begin; i < end; ++i){
+        const Vector3 dir = R * rayDirections[i];
+        const Vector3 origin = p + dir * minDistance;
+        double nearest = std::numeric_limits<double>::max();
+        for(int j=0; j < numTargetModels; ++j){
+            // zero is returned when the ray does not hit the model
+            const double d = targetModels[j]->model->computeDistanceWithRay(origin.data(), dir.data());
+            if(d > 0.0 && d < nearest){
+                nearest = d;
+            }
+        }
+        const double distance = minDistance + nearest;
+        if(distance <= maxDistance){
+            data[i] = distance + depthError;
+        } else {
+            data[i] = std::numeric_limits<double>::infinity();
+        }
+    }
+}
+
+
+void RayCastRangeSensorSimulatorItemImpl::onPreDynamics()
+{
+    bool areModelsUpdated = false;
+
+    for(size_t i=0; i < casters.size(); ++i){
+        RangeSensorCaster* caster = casters[i];
+        if(caster->elapsedTime >= caster->cycleTime){
+            if(!areModelsUpdated){
+                for(size_t j=0; j < linkModels.size(); ++j){
+                    LinkModel& linkModel = linkModels[j];
+                    const Position& T = linkModel.link->T();
+                    linkModel.model->setPosition(T);
+                    linkModel.center = T * linkModel.localCenter;
+                }
+                areModelsUpdated = true;
+            }
+            startScan(caster);
+            caster->elapsedTime -= caster->cycleTime;
+        }
+        caster->elapsedTime += worldTimeStep;
+    }
+}
+
+
+/**
+   The models whose bounding spheres are out of the maximum distance are excluded before the scan.
+   The scan is done in the threads while the dynamics is computed, and the data is output in
+   onPostDynamics().
+*/
+void RayCastRangeSensorSimulatorItemImpl::startScan(RangeSensorCaster* caster)
+{
+    RangeSensor* sensor = caster->rangeSensor;
+    caster->T_sensor = sensor->link()->T() * sensor->T_local();
+    const Vector3 p = caster->T_sensor.translation();
+    const double maxDistance = sensor->maxDistance();
+
+    caster->targetModels.clear();
+    for(size_t i=0; i < linkModels.size(); ++i){
+        LinkModel& linkModel = linkModels[i];
+        if((linkModel.center - p).norm() - linkModel.radius <= maxDistance){
+            caster->targetModels.push_back(&linkModel);
+        }
+    }
+
+    const int numRays = caster->rayDirections.size();
+    caster->rangeData = boost::make_shared<RangeSensor::RangeData>(numRays);
+
+    if(!threadPool){
+        caster->castRays(0, numRays, depthError);
+    } else {
+        for(int i=0; i < numRays; i += NUM_RAYS_PER_CHUNK){
+            threadPool->start(
+                boost::bind(&RangeSensorCaster::castRays, caster, i, std::min(i + NUM_RAYS_PER_CHUNK, numRays), depthError));
+        }
+    }
+
+    castersInScanning.push_back(caster);
+}
+
+
+void RayCastRangeSensorSimulatorItemImpl::onPostDynamics()
+{
+    if(castersInScanning.empty()){
+        return;
+    }
+    if(threadPool){
+        threadPool->wait();
+    }
+    for(size_t i=0; i < castersInScanning.size(); ++i){
+        RangeSensorCaster* caster = castersInScanning[i];
+        RangeSensor* sensor = caster->rangeSensor;
+        sensor->setRangeData(caster->rangeData);
+        sensor->setDelay(0.0);
+        if(isVisionDataRecordingEnabled){
+            sensor->notifyStateChange();
+        } else {
+            caster->simBody->notifyUnrecordedDeviceStateChange(sensor);
+        }
+        caster->rangeData.reset();
+    }
+    castersInScanning.clear();
+}
+
+
+void RayCastRangeSensorSimulatorItem::finalizeSimulation()
+{
+    impl->finalizeSimulation();
+}
+
+
+void RayCastRangeSensorSimulatorItemImpl::finalizeSimulation()
+{
+    if(threadPool){
+        threadPool->wait();
+        threadPool.reset();
+    }
+    castersInScanning.clear();
+    casters.clear();
+    linkModels.clear();
+}
+
+
+void RayCastRangeSensorSimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
+{
+    impl->doPutProperties(putProperty);
+}
+
+
+void RayCastRangeSensorSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
+{
+    putProperty(_("Enabled"), isEnabled, changeProperty(isEnabled));
+    putProperty(_("Target bodies"), bodyNameListString, boost::bind(updateNames, _1, boost::ref(bodyNameListString), boost::ref(bodyNames)));
+    putProperty(_("Target sensors"), sensorNameListString, boost::bind(updateNames, _1, boost::ref(sensorNameListString), boost::ref(sensorNames)));
+    putProperty(_("Max frame rate"), maxFrameRate, changeProperty(maxFrameRate));
+    putProperty(_("Record vision data"), isVisionDataRecordingEnabled, changeProperty(isVisionDataRecordingEnabled));
+    putProperty.min(1)(_("Number of threads"), numThreads, changeProperty(numThreads));
+    putProperty.reset()(_("Depth error"), depthError, changeProperty(depthError));
+}
+
+
+bool RayCastRangeSensorSimulatorItem::store(Archive& archive)
+{
+    SubSimulatorItem::store(archive);
+    return impl->store(archive);
+}
+
+
+bool RayCastRangeSensorSimulatorItemImpl::store(Archive& archive)
+{
+    archive.write("enabled", isEnabled);
+    writeElements(archive, "targetBodies", bodyNames, true);
+    writeElements(archive, "targetSensors", sensorNames, true);
+    archive.write("maxFrameRate", maxFrameRate);
+    archive.write("recordVisionData", isVisionDataRecordingEnabled);
+    archive.write("numThreads", numThreads);
+    archive.write("depthError", depthError);
+    return true;
+}
+
+
+bool RayCastRangeSensorSimulatorItem::restore(const Archive& archive)
+{
+    SubSimulatorItem::restore(archive);
+    return impl->restore(archive);
+}
+
+
+bool RayCastRangeSensorSimulatorItemImpl::restore(const Archive& archive)
+{
+    archive.read("enabled", isEnabled);
+    readElements(archive, "targetBodies", bodyNames);
+    bodyNameListString = getNameListString(bodyNames);
+    readElements(archive, "targetSensors", sensorNames);
+    sensorNameListString = getNameListString(sensorNames);
+    archive.read("maxFrameRate", maxFrameRate);
+    archive.read("recordVisionData", isVisionDataRecordingEnabled);
+    archive.read("numThreads", numThreads);
+    archive.read("depthError", depthError);
+    return true;
+}
@@ -0,0 +1,46 @@
+/*!
+  @file
+  @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_BODYPLUGIN_RAY_CAST_RANGE_SENSOR_SIMULATOR_ITEM_H
+#define CNOID_BODYPLUGIN_RAY_CAST_RANGE_SENSOR_SIMULATOR_ITEM_H
+
+#include "SubSimulatorItem.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class RayCastRangeSensorSimulatorItemImpl;
+
+/**
+   This item simulates the range sensors by casting the rays to the collision models of
+   the link shapes on CPU. It does not require the OpenGL context unlike GLVisionSimulatorItem,
+   and the rays of the sensors are cast by the threads in parallel with the dynamics computation.
+*/
+class CNOID_EXPORT RayCastRangeSensorSimulatorItem : public SubSimulatorItem
+{
+public:
+    static void initializeClass(ExtensionManager* ext);
+
+    RayCastRangeSensorSimulatorItem();
+    RayCastRangeSensorSimulatorItem(const RayCastRangeSensorSimulatorItem& org);
+    ~RayCastRangeSensorSimulatorItem();
+
+    virtual bool isEnabled();
+    virtual bool initializeSimulation(SimulatorItem* simulatorItem);
+    virtual void finalizeSimulation();
+
+protected:
+    virtual ItemPtr doDuplicate() const;
+    virtual void doPutProperties(PutPropertyFunction& putProperty);
+    virtual bool store(Archive& archive);
+    virtual bool restore(const Archive& archive);
+
+private:
+    RayCastRangeSensorSimulatorItemImpl* impl;
+};
+
+}
+
+#endif
@@ -22,10 +22,12 @@
 #include <cnoid/ConnectionSet>
 #include <cnoid/Sleep>
 #include <cnoid/Timer>
+#include <cnoid/ThreadPool>
 #include <QThread>
-#include <QMutex>
+#include <QAtomicInt>
 #include <boost/thread.hpp>
 #include <boost/dynamic_bitset.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/bind.hpp>
 
 #if QT_VERSION >= 0x040700
@@ -45,6 +47,10 @@ namespace {
 
 typedef Deque2D<SE3, Eigen::aligned_allocator<SE3> > MultiSE3Deque;
 
+// The simulation time length covered by the result ring of each body
+const double resultRingTimeLength = 2.0;
+const int minResultRingSize = 16;
+
 class ControllerTarget : public ControllerItem::Target
 {
     SimulatorItemImpl* simImpl;
@@ -75,8 +81,26 @@ public:
     bool doStoreResult;
     bool areShapesCloned;
 
-    Deque2D<double> jointPosBuf;
-    MultiSE3Deque linkPosBuf;
+    /*
+      The results are passed from the simulation thread to the main thread through
+      a single-producer / single-consumer ring of preallocated frames. The simulation
+      thread only advances resultRingHead and the main thread only advances
+      resultRingTail, so neither thread waits for the other.
+    */
+    int resultRingSize;
+    Deque2D<double> jointPosRing;
+    MultiSE3Deque linkPosRing;
+    Deque2D<DeviceStatePtr> deviceStateRing;
+    QAtomicInt resultRingHead;
+    QAtomicInt resultRingTail;
+
+    /*
+      The frames stored while the ring is full. These buffers are only accessed by the
+      simulation thread until the simulation loop finishes.
+    */
+    Deque2D<double> jointPosOverflowBuf;
+    MultiSE3Deque linkPosOverflowBuf;
+    Deque2D<DeviceStatePtr> deviceStateOverflowBuf;
 
     BodyMotionPtr motion;
     MultiValueSeqPtr jointPosResult;
@@ -86,7 +110,7 @@ public:
     vector<Device*> devicesToNotifyResult;
     ConnectionSet deviceStateConnections;
     boost::dynamic_bitset<> deviceStateChangeFlag;
-    Deque2D<DeviceStatePtr> deviceStateBuf;
+    vector<DeviceStatePtr> currentDeviceStates;
     vector<DeviceStatePtr> prevFlushedDeviceStateInDirectMode;
     MultiDeviceStateSeqPtr deviceStateResult;
 
@@ -99,10 +123,21 @@ public:
     void setupResultMotion(
         SimulatorItemImpl* simImpl, Item* ownerItem, const string& simulatedMotionName);
     void setupDeviceStateRecording();
+    void setupResultRing();
     void setInitialStateOfBodyMotion(const BodyMotionPtr& bodyMotion);
     void onDeviceStateChanged(int deviceIndex);
     void storeResult();
+    void storeCurrentState(
+        Deque2D<double>::Row q, MultiSE3Deque::Row pos, Deque2D<DeviceStatePtr>::Row states);
+    void moveOverflowFramesToResultRing();
+    void copyFrame(
+        Deque2D<double>::Row q, MultiSE3Deque::Row pos, Deque2D<DeviceStatePtr>::Row states,
+        int destIndex);
     void flushResult();
+    void flushResultFrame(
+        Deque2D<double>::Row q, MultiSE3Deque::Row pos, Deque2D<DeviceStatePtr>::Row states);
+    void flushLastResultFrame(
+        Deque2D<double>::Row q, MultiSE3Deque::Row pos, Deque2D<DeviceStatePtr>::Row states);
     void notifyResult();
 };
 
@@ -129,6 +164,8 @@ public:
     bool isControlRequested;
     bool isControlFinished;
     bool isControlToBeContinued;
+    boost::scoped_ptr<ThreadPool> controllerThreadPool;
+    vector<char> controlResults;
         
     vector<SimulationBodyImpl*> simBodyImplsToNotifyResult;
     ItemList<SubSimulatorItem> subSimulatorItems;
@@ -141,7 +178,7 @@ public:
     int currentFrame;
     double worldFrameRate;
     double worldTimeStep;
-    int frameAtLastBufferWriting;
+    QAtomicInt frameAtLastBufferWriting;
     Timer flushTimer;
 
     Selection recordingMode;
@@ -150,6 +187,7 @@ public:
     bool isActiveControlPeriodOnlyMode;
     bool useControllerThreads;
     bool useControllerThreadsProperty;
+    int numControllerThreads;
     bool isAllLinkPositionOutputMode;
     bool isDeviceStateOutputEnabled;
     bool isDoingSimulationLoop;
@@ -166,7 +204,7 @@ public:
 
     TimeBar* timeBar;
     int fillLevelId;
-    QMutex mutex;
+    bool isFlushingFinalResult;
     double actualSimulationTime;
     double finishTime;
     MessageView* mv;
@@ -193,6 +231,7 @@ public:
     void updateSimBodyLists();
     bool stepSimulationMain();
     void concurrentControlLoop();
+    void control(int index);
     void flushResult();
     void stopSimulation(bool doSync);
     void pauseSimulation();
@@ -366,6 +405,7 @@ SimulationBodyImpl::SimulationBodyImpl(const BodyPtr& body)
     simImpl = 0;
     areShapesCloned = false;
     doStoreResult = false;
+    resultRingSize = 0;
 }
 
 
@@ -505,10 +545,10 @@ void SimulationBodyImpl::setupResultMotion
     }
     
     const int numAllJoints = body->numAllJoints();
-    jointPosBuf.resizeColumn(numAllJoints);
+    jointPosOverflowBuf.resizeColumn(numAllJoints);
 
     const int numLinksToRecord = simImpl->isAllLinkPositionOutputMode ? body->numLinks() : 1;
-    linkPosBuf.resizeColumn(numLinksToRecord);
+    linkPosOverflowBuf.resizeColumn(numLinksToRecord);
 
     if(!simImpl->isRecordingEnabled){
         return;
@@ -567,20 +607,19 @@ void SimulationBodyImpl::setupDeviceStateRecording()
     devicesToNotifyResult.clear();
     
     if(devices.empty() || !simImpl->isDeviceStateOutputEnabled){
-        deviceStateBuf.clear();
+        currentDeviceStates.clear();
         if(motion){
             clearMultiDeviceStateSeq(*motion);
         }
         prevFlushedDeviceStateInDirectMode.clear();
     } else {
-        deviceStateBuf.resize(1, devices.size());
+        currentDeviceStates.resize(devices.size());
         prevFlushedDeviceStateInDirectMode.resize(devices.size());
-        Deque2D<DeviceStatePtr>::Row dstate = deviceStateBuf.last();
 
         for(size_t i=0; i < devices.size(); ++i){
             Device* device = devices[i];
             DeviceState* s = device->cloneState();
-            dstate[i] = s;
+            currentDeviceStates[i] = s;
             prevFlushedDeviceStateInDirectMode[i] = s;
             deviceStateConnections.add(
                 device->sigStateChanged().connect(
@@ -590,14 +629,30 @@ void SimulationBodyImpl::setupDeviceStateRecording()
             deviceStateResult = getOrCreateMultiDeviceStateSeq(*motion);
             deviceStateResult->setNumParts(devices.size());
             MultiDeviceStateSeq::Row result0 = deviceStateResult->frame(0);
-            for(size_t i=0; i < dstate.size(); ++i){
-                result0[i] = dstate[i];
+            for(size_t i=0; i < currentDeviceStates.size(); ++i){
+                result0[i] = currentDeviceStates[i];
             }
         }
     }
 }
 
 
+void SimulationBodyImpl::setupResultRing()
+{
+    if(!doStoreResult){
+        return;
+    }
+    
+    resultRingSize = std::max(minResultRingSize, (int)(resultRingTimeLength * simImpl->worldFrameRate)) + 1;
+    jointPosRing.resize(resultRingSize, jointPosOverflowBuf.colSize());
+    linkPosRing.resize(resultRingSize, linkPosOverflowBuf.colSize());
+    deviceStateRing.resize(resultRingSize, currentDeviceStates.size());
+    deviceStateOverflowBuf.resizeColumn(currentDeviceStates.size());
+    resultRingHead.fetchAndStoreRelease(0);
+    resultRingTail.fetchAndStoreRelease(0);
+}
+
+
 void SimulationBodyImpl::setInitialStateOfBodyMotion(const BodyMotionPtr& bodyMotion)
 {
     bool updated = false;
@@ -631,7 +686,7 @@ bool SimulationBodyImpl::initialize(SimulatorItemImpl* simImpl, ControllerItem*
     this->simImpl = simImpl;
     this->controller = controllerItem;
     frameRate = simImpl->worldFrameRate;
-    linkPosBuf.resizeColumn(0);
+    linkPosOverflowBuf.resizeColumn(0);
     return true;
 }
 
@@ -658,36 +713,97 @@ void SimulationBody::storeResult()
 }
 
 
+/**
+   This function is called from the simulation thread.
+   The current state is directly written into the free slot of the result ring.
+   When the ring is full, the state is stored in the overflow buffers instead
+   and moved to the ring when the main thread has consumed some frames.
+*/
 void SimulationBodyImpl::storeResult()
 {
-    if(jointPosBuf.colSize() > 0){
-        Deque2D<double>::Row q = jointPosBuf.append();
-        for(int i=0; i < q.size() ; ++i){
-            q[i] = body->joint(i)->q();
+    const DeviceList<>& devices = body->devices();
+    for(size_t i=0; i < currentDeviceStates.size(); ++i){
+        if(deviceStateChangeFlag[i]){
+            currentDeviceStates[i] = devices[i]->cloneState();
+            deviceStateChangeFlag.reset(i);
         }
     }
-    MultiSE3Deque::Row pos = linkPosBuf.append();
-    for(int i=0; i < linkPosBuf.colSize(); ++i){
+
+    if(linkPosOverflowBuf.rowSize() > 0){
+        moveOverflowFramesToResultRing();
+    }
+
+    const int head = resultRingHead.fetchAndAddAcquire(0);
+    const int next = (head + 1) % resultRingSize;
+
+    if(linkPosOverflowBuf.rowSize() == 0 && next != resultRingTail.fetchAndAddAcquire(0)){
+        storeCurrentState(jointPosRing.row(head), linkPosRing.row(head), deviceStateRing.row(head));
+        resultRingHead.fetchAndStoreRelease(next);
+
+    } else if(simImpl->isRecordingEnabled || linkPosOverflowBuf.rowSize() == 0){
+        storeCurrentState(jointPosOverflowBuf.append(), linkPosOverflowBuf.append(), deviceStateOverflowBuf.append());
+
+    } else {
+        // Only the latest state is necessary when the results are not recorded
+        storeCurrentState(jointPosOverflowBuf.last(), linkPosOverflowBuf.last(), deviceStateOverflowBuf.last());
+    }
+}
+
+
+void SimulationBodyImpl::storeCurrentState
+(Deque2D<double>::Row q, MultiSE3Deque::Row pos, Deque2D<DeviceStatePtr>::Row states)
+{
+    for(int i=0; i < q.size() ; ++i){
+        q[i] = body->joint(i)->q();
+    }
+    for(int i=0; i < pos.size(); ++i){
         Link* link = body->link(i);
         pos[i].set(link->p(), link->R());
     }
+    for(int i=0; i < states.size(); ++i){
+        states[i] = currentDeviceStates[i];
+    }
+}
 
-    if(!deviceStateBuf.empty()){
-        Deque2D<DeviceStatePtr>::Row current = deviceStateBuf.append();
-        Deque2D<DeviceStatePtr>::Row old = deviceStateBuf[deviceStateBuf.rowSize() - 2];
-        const DeviceList<>& devices = body->devices();
-        for(size_t i=0; i < devices.size(); ++i){
-            if(deviceStateChangeFlag[i]){
-                current[i] = devices[i]->cloneState();
-                deviceStateChangeFlag.reset(i);
-            } else {
-                current[i] = old[i];
-            }
+
+void SimulationBodyImpl::moveOverflowFramesToResultRing()
+{
+    const int numOverflowFrames = linkPosOverflowBuf.rowSize();
+    const int tail = resultRingTail.fetchAndAddAcquire(0);
+    int head = resultRingHead.fetchAndAddAcquire(0);
+    int numMovedFrames = 0;
+
+    while(numMovedFrames < numOverflowFrames){
+        const int next = (head + 1) % resultRingSize;
+        if(next == tail){
+            break;
         }
+        copyFrame(jointPosOverflowBuf.row(numMovedFrames),
+                  linkPosOverflowBuf.row(numMovedFrames),
+                  deviceStateOverflowBuf.row(numMovedFrames),
+                  head);
+        head = next;
+        ++numMovedFrames;
+    }
+
+    if(numMovedFrames > 0){
+        resultRingHead.fetchAndStoreRelease(head);
+        jointPosOverflowBuf.pop_front(numMovedFrames);
+        linkPosOverflowBuf.pop_front(numMovedFrames);
+        deviceStateOverflowBuf.pop_front(numMovedFrames);
     }
 }
 
 
+void SimulationBodyImpl::copyFrame
+(Deque2D<double>::Row q, MultiSE3Deque::Row pos, Deque2D<DeviceStatePtr>::Row states, int destIndex)
+{
+    std::copy(q.begin(), q.end(), jointPosRing.row(destIndex).begin());
+    std::copy(pos.begin(), pos.end(), linkPosRing.row(destIndex).begin());
+    std::copy(states.begin(), states.end(), deviceStateRing.row(destIndex).begin());
+}
+
+
 bool SimulationBody::flushResult()
 {
     if(!impl->doStoreResult){
@@ -698,81 +814,101 @@ bool SimulationBody::flushResult()
 }
 
 
+/**
+   This function is called from the main thread. The frames in the result ring are
+   consumed without blocking the simulation thread. The overflow buffers are also
+   flushed when the simulation loop has finished.
+*/
 void SimulationBodyImpl::flushResult()
 {
+    const int head = resultRingHead.fetchAndAddAcquire(0);
+    int tail = resultRingTail.fetchAndAddAcquire(0);
+    
     if(simImpl->isRecordingEnabled){
-
-        const int ringBufferSize = simImpl->ringBufferSize;
-        const int numBufFrames = linkPosBuf.rowSize();
-
-        for(int i=0; i < numBufFrames; ++i){
-            MultiSE3Deque::Row buf = linkPosBuf.row(i);
-            if(linkPosResult->numFrames() >= ringBufferSize){
-                linkPosResult->popFrontFrame();
-            }
-            std::copy(buf.begin(), buf.end(), linkPosResult->appendFrame().begin());
+        while(tail != head){
+            flushResultFrame(jointPosRing.row(tail), linkPosRing.row(tail), deviceStateRing.row(tail));
+            tail = (tail + 1) % resultRingSize;
         }
-            
-        if(jointPosBuf.colSize() > 0){
-            for(int i=0; i < numBufFrames; ++i){
-                Deque2D<double>::Row buf = jointPosBuf.row(i);
-                if(jointPosResult->numFrames() >= ringBufferSize){
-                    jointPosResult->popFrontFrame();
-                }
-                std::copy(buf.begin(), buf.end(), jointPosResult->appendFrame().begin());
+        if(simImpl->isFlushingFinalResult){
+            const int numOverflowFrames = linkPosOverflowBuf.rowSize();
+            for(int i=0; i < numOverflowFrames; ++i){
+                flushResultFrame(jointPosOverflowBuf.row(i), linkPosOverflowBuf.row(i), deviceStateOverflowBuf.row(i));
             }
         }
-        if(deviceStateBuf.colSize() > 0){
-            for(int i=0; i < numBufFrames; ++i){
-                Deque2D<DeviceStatePtr>::Row buf = deviceStateBuf.row(i);
-                if(deviceStateResult->numFrames() >= ringBufferSize){
-                    deviceStateResult->popFrontFrame();
-                }
-                std::copy(buf.begin(), buf.end(), deviceStateResult->appendFrame().begin());
-            }
-            // keep the last state so that unchanged states can be shared
-            deviceStateBuf.pop_front(deviceStateBuf.rowSize() - 1);
-        }
     } else {
-        const Body* orgBody = bodyItem->body();
-        if(!linkPosBuf.empty()){
-            MultiSE3Deque::Row last = linkPosBuf.last();
-            const int n = last.size();
-            for(int i=0; i < n; ++i){
-                SE3& pos = last[i];
-                Link* link = orgBody->link(i);
-                link->p() = pos.translation();
-                link->R() = pos.rotation().toRotationMatrix();
-            }
+        if(simImpl->isFlushingFinalResult && linkPosOverflowBuf.rowSize() > 0){
+            flushLastResultFrame(jointPosOverflowBuf.last(), linkPosOverflowBuf.last(), deviceStateOverflowBuf.last());
+        } else if(tail != head){
+            const int last = (head + resultRingSize - 1) % resultRingSize;
+            flushLastResultFrame(jointPosRing.row(last), linkPosRing.row(last), deviceStateRing.row(last));
         }
-        if(!jointPosBuf.empty()){
-            Deque2D<double>::Row last = jointPosBuf.last();
-            const int n = body->numJoints();
-            for(int i=0; i < n; ++i){
-                orgBody->joint(i)->q() = last[i];
-            }
+        tail = head;
+    }
+
+    resultRingTail.fetchAndStoreRelease(tail);
+
+    if(simImpl->isFlushingFinalResult){
+        jointPosOverflowBuf.resizeRow(0);
+        linkPosOverflowBuf.resizeRow(0);
+        deviceStateOverflowBuf.resizeRow(0);
+    }
+}
+
+
+void SimulationBodyImpl::flushResultFrame
+(Deque2D<double>::Row q, MultiSE3Deque::Row pos, Deque2D<DeviceStatePtr>::Row states)
+{
+    const int ringBufferSize = simImpl->ringBufferSize;
+
+    if(linkPosResult->numFrames() >= ringBufferSize){
+        linkPosResult->popFrontFrame();
+    }
+    std::copy(pos.begin(), pos.end(), linkPosResult->appendFrame().begin());
+
+    if(q.size() > 0){
+        if(jointPosResult->numFrames() >= ringBufferSize){
+            jointPosResult->popFrontFrame();
         }
-        if(!deviceStateBuf.empty()){
-            devicesToNotifyResult.clear();
-            const DeviceList<>& devices = orgBody->devices();
-            Deque2D<DeviceStatePtr>::Row ds = deviceStateBuf.last();
-            const int ndevices = devices.size();
-            for(size_t i=0; i < ndevices; ++i){
-                const DeviceStatePtr& s = ds[i];
-                if(s != prevFlushedDeviceStateInDirectMode[i]){
-                    Device* device = devices.get(i);
-                    device->copyStateFrom(*s);
-                    prevFlushedDeviceStateInDirectMode[i] = s;
-                    devicesToNotifyResult.push_back(device);
-                }
-            }
-            // keep the last state so that unchanged states can be shared
-            deviceStateBuf.pop_front(deviceStateBuf.rowSize() - 1);
+        std::copy(q.begin(), q.end(), jointPosResult->appendFrame().begin());
+    }
+    if(states.size() > 0){
+        if(deviceStateResult->numFrames() >= ringBufferSize){
+            deviceStateResult->popFrontFrame();
         }
+        std::copy(states.begin(), states.end(), deviceStateResult->appendFrame().begin());
     }
+}
+
+
+void SimulationBodyImpl::flushLastResultFrame
+(Deque2D<double>::Row q, MultiSE3Deque::Row pos, Deque2D<DeviceStatePtr>::Row states)
+{
+    const Body* orgBody = bodyItem->body();
 
-    jointPosBuf.resizeRow(0);
-    linkPosBuf.resizeRow(0);
+    for(int i=0; i < pos.size(); ++i){
+        SE3& p = pos[i];
+        Link* link = orgBody->link(i);
+        link->p() = p.translation();
+        link->R() = p.rotation().toRotationMatrix();
+    }
+    const int n = std::min(q.size(), body->numJoints());
+    for(int i=0; i < n; ++i){
+        orgBody->joint(i)->q() = q[i];
+    }
+    if(states.size() > 0){
+        devicesToNotifyResult.clear();
+        const DeviceList<>& devices = orgBody->devices();
+        const int ndevices = devices.size();
+        for(int i=0; i < ndevices; ++i){
+            const DeviceStatePtr& s = states[i];
+            if(s != prevFlushedDeviceStateInDirectMode[i]){
+                Device* device = devices.get(i);
+                device->copyStateFrom(*s);
+                prevFlushedDeviceStateInDirectMode[i] = s;
+                devicesToNotifyResult.push_back(device);
+            }
+        }
+    }
 }
 
 
@@ -804,6 +940,7 @@ SimulatorItem::SimulatorItem(const SimulatorItem& org)
     impl->timeRangeMode = org.impl->timeRangeMode;
     impl->isActiveControlPeriodOnlyMode = org.impl->isActiveControlPeriodOnlyMode;
     impl->useControllerThreadsProperty = org.impl->useControllerThreadsProperty;
+    impl->numControllerThreads = org.impl->numControllerThreads;
 }
 
 
@@ -822,6 +959,7 @@ SimulatorItemImpl::SimulatorItemImpl(SimulatorItem* self)
     timeBar = TimeBar::instance();
     isDoingSimulationLoop = false;
     isRealtimeSyncMode = false;
+    isFlushingFinalResult = false;
 
     recordingMode.setSymbol(SimulatorItem::RECORD_FULL, N_("full"));
     recordingMode.setSymbol(SimulatorItem::RECORD_TAIL, N_("tail"));
@@ -835,6 +973,7 @@ SimulatorItemImpl::SimulatorItemImpl(SimulatorItem* self)
     specifiedTimeLength = 180.0; // 3 min.
     isActiveControlPeriodOnlyMode = true;
     useControllerThreadsProperty = true;
+    numControllerThreads = 1;
     isAllLinkPositionOutputMode = false;
     isDeviceStateOutputEnabled = true;
 }
@@ -889,6 +1028,15 @@ void SimulatorItem::setTimeRangeMode(int selection)
 }
 
 
+/**
+   The time length used in the SPECIFIED_PERIOD time range mode
+*/
+void SimulatorItem::setSpecifiedRecordingTimeLength(double length)
+{
+    impl->setSpecifiedRecordingTimeLength(length);
+}
+
+
 void SimulatorItem::setRealtimeSyncMode(bool on)
 {
     impl->isRealtimeSyncMode = on;
@@ -907,6 +1055,18 @@ void SimulatorItem::setActiveControlPeriodOnlyMode(bool on)
 }
 
 
+/**
+   Set the number of threads which execute the control functions of the controllers
+   in the "Controller Threads" mode. When the number is more than one, the control
+   functions of different controllers are executed in parallel, so the controllers
+   must not share any data updated in the control functions.
+*/
+void SimulatorItem::setNumControllerThreads(int n)
+{
+    impl->numControllerThreads = (n < 1) ? 1 : n;
+}
+
+
 void SimulatorItem::setAllLinkPositionOutputMode(bool on)
 {
     impl->isAllLinkPositionOutputMode = on;
@@ -1058,7 +1218,8 @@ bool SimulatorItemImpl::startSimulation(bool doReset)
     if(result){
 
         currentFrame = 0;
-        frameAtLastBufferWriting = 0;
+        frameAtLastBufferWriting.fetchAndStoreRelease(0);
+        isFlushingFinalResult = false;
         isDoingSimulationLoop = true;
         isWaitingForSimulationToStop = false;
         stopRequested = false;
@@ -1102,7 +1263,9 @@ bool SimulatorItemImpl::startSimulation(bool doReset)
         }
 
         for(size_t i=0; i < simBodiesWithBody.size(); ++i){
-            simBodiesWithBody[i]->impl->setupDeviceStateRecording();
+            SimulationBodyImpl* simBodyImpl = simBodiesWithBody[i]->impl;
+            simBodyImpl->setupDeviceStateRecording();
+            simBodyImpl->setupResultRing();
         }
 
         for(size_t i=0; i < allSimBodies.size(); ++i){
@@ -1142,6 +1305,9 @@ bool SimulatorItemImpl::startSimulation(bool doReset)
             isExitingControlLoopRequested = false;
             isControlRequested = false;
             isControlFinished = false;
+            if(numControllerThreads > 1){
+                controllerThreadPool.reset(new ThreadPool(numControllerThreads));
+            }
         }
 
         aboutToQuitConnection.disconnect();
@@ -1291,6 +1457,7 @@ void SimulatorItemImpl::run()
         }
         controlCondition.notify_all();
         controlThread.join();
+        controllerThreadPool.reset();
     }
 
     if(!isWaitingForSimulationToStop){
@@ -1383,16 +1550,10 @@ bool SimulatorItemImpl::stepSimulationMain()
         postDynamicsFunctions[i]();
     }
 
-    {
-        mutex.lock();
-        
-        for(size_t i=0; i < activeSimBodies.size(); ++i){
-            activeSimBodies[i]->storeResult();
-        }
-        frameAtLastBufferWriting = currentFrame;
-
-        mutex.unlock();
+    for(size_t i=0; i < activeSimBodies.size(); ++i){
+        activeSimBodies[i]->storeResult();
     }
+    frameAtLastBufferWriting.fetchAndStoreRelease(currentFrame);
 
     if(useControllerThreads){
         for(size_t i=0; i < activeControllers.size(); ++i){
@@ -1430,8 +1591,21 @@ void SimulatorItemImpl::concurrentControlLoop()
         }
 
         bool doContinue = false;
-        for(size_t i=0; i < activeControllers.size(); ++i){
-            doContinue |= activeControllers[i]->control();
+        const int n = activeControllers.size();
+        if(controllerThreadPool && n > 1){
+            controlResults.resize(n);
+            for(int i=0; i < n; ++i){
+                controllerThreadPool->start(boost::bind(&SimulatorItemImpl::control, this, i));
+            }
+            // All the controllers must finish the control before the finish is notified
+            controllerThreadPool->wait();
+            for(int i=0; i < n; ++i){
+                doContinue |= controlResults[i];
+            }
+        } else {
+            for(int i=0; i < n; ++i){
+                doContinue |= activeControllers[i]->control();
+            }
         }
         
         {
@@ -1447,11 +1621,18 @@ exitConcurrentControlLoop:
 }
 
 
+void SimulatorItemImpl::control(int index)
+{
+    controlResults[index] = activeControllers[index]->control();
+}
+
+
 void SimulatorItemImpl::flushResult()
 {
     simBodyImplsToNotifyResult.clear();
 
-    mutex.lock();
+    // The frame is obtained before the results are consumed not to go ahead of them
+    const int frame = frameAtLastBufferWriting.fetchAndAddAcquire(0);
     
     for(size_t i=0; i < allSimBodies.size(); ++i){
         SimulationBody* simBody = allSimBodies[i];
@@ -1460,10 +1641,6 @@ void SimulatorItemImpl::flushResult()
         }
     }
 
-    int frame = frameAtLastBufferWriting;
-    
-    mutex.unlock();
-
     if(isRecordingEnabled){
         double fillLevel = frame / worldFrameRate;
         timeBar->updateFillLevel(fillLevelId, fillLevel);
@@ -1547,7 +1724,10 @@ void SimulatorItemImpl::onSimulationLoopStopped()
         subSimulatorItems[i]->finalizeSimulation();
     }
 
+    // The simulation thread has finished, so the overflow buffers can also be flushed
+    isFlushingFinalResult = true;
     flushResult();
+    isFlushingFinalResult = false;
 
     if(isRecordingEnabled){
         timeBar->stopFillLevelUpdate(fillLevelId);
@@ -1633,6 +1813,8 @@ void SimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(impl->isDeviceStateOutputEnabled));
     putProperty(_("Controller Threads"), impl->useControllerThreadsProperty,
                 changeProperty(impl->useControllerThreadsProperty));
+    putProperty.min(1)(_("Controller thread count"), impl->numControllerThreads,
+                       changeProperty(impl->numControllerThreads));
 }
 
 
@@ -1652,6 +1834,7 @@ bool SimulatorItemImpl::store(Archive& archive)
     archive.write("allLinkPositionOutputMode", isAllLinkPositionOutputMode);
     archive.write("deviceStateOutput", isDeviceStateOutputEnabled);
     archive.write("controllerThreads", useControllerThreadsProperty);
+    archive.write("numControllerThreads", numControllerThreads);
 
     ListingPtr idseq = new Listing();
     idseq->setFlowStyle(true);
@@ -1701,6 +1884,7 @@ bool SimulatorItemImpl::restore(const Archive& archive)
     self->setAllLinkPositionOutputMode(archive.get("allLinkPositionOutputMode", isAllLinkPositionOutputMode));
     archive.read("deviceStateOutput", isDeviceStateOutputEnabled);
     archive.read("controllerThreads", useControllerThreadsProperty);
+    archive.read("numControllerThreads", numControllerThreads);
 
     archive.addPostProcess(
         boost::bind(&SimulatorItemImpl::restoreBodyMotionEngines, this, boost::ref(archive)));
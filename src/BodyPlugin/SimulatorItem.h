@@ -85,9 +85,11 @@ public:
     void setRecordingMode(int selection);
     Selection recordingMode() const;
     void setTimeRangeMode(int selection);
+    void setSpecifiedRecordingTimeLength(double length);
     void setRealtimeSyncMode(bool on);
     void setDeviceStateOutputEnabled(bool on);
     void setActiveControlPeriodOnlyMode(bool on);
+    void setNumControllerThreads(int n);
 
     bool isRecordingEnabled() const;
     bool isDeviceStateOutputEnabled() const;
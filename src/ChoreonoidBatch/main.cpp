@@ -0,0 +1,330 @@
+/*
+  This file is part of Choreonoid, an extensible graphical robotics application suit.
+  Copyright (c) 2007-2014 National Institute of Advanced Industrial Science and Technology (AIST)
+  Released under the MIT license. See accompanying file 'LICENSE' for more information.
+*/
+
+/**
+   This program runs the simulations of the given projects without the main window.
+   Only the base managers and items required for simulations, the Body plugin and the plugins
+   specified by the "--plugin" option are initialized, and the messages are put into the standard error.
+   The plugins are loaded only once, so running many projects with one invocation avoids the
+   startup overhead of each run. The QApplication object is still required by the simulator items
+   and the vision sensor simulation. With Qt5, "-platform offscreen" can be given to the program
+   to run it on a machine without a display.
+*/
+
+#include <cnoid/ExtensionManager>
+#include <cnoid/AppConfig>
+#include <cnoid/ViewManager>
+#include <cnoid/MessageView>
+#include <cnoid/PluginManager>
+#include <cnoid/ProjectManager>
+#include <cnoid/TimeBar>
+#include <cnoid/ItemTreeView>
+#include <cnoid/TimeSyncItemEngine>
+#include <cnoid/RootItem>
+#include <cnoid/FolderItem>
+#include <cnoid/SceneItem>
+#include <cnoid/MultiValueSeqItem>
+#include <cnoid/MultiSE3SeqItem>
+#include <cnoid/MultiAffine3SeqItem>
+#include <cnoid/Vector3SeqItem>
+#include <cnoid/ItemList>
+#include <cnoid/SimulatorItem>
+#include <cnoid/BodyItem>
+#include <cnoid/BodyMotionItem>
+#include <cnoid/FileUtil>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include <boost/bind.hpp>
+#include <iostream>
+#include <clocale>
+#include <cstdlib>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+class BatchSimulation
+{
+public:
+    string simulatorName;
+    double timeLength;
+    string outputDirectory;
+
+    bool run(const string& projectFile);
+
+private:
+    SimulatorItem* simulatorItem;
+    double simulatedTime;
+
+    SimulatorItem* findSimulatorItem();
+    void onSimulationFinished();
+    void saveResultMotions();
+    void clearItems();
+};
+
+}
+
+
+bool BatchSimulation::run(const string& projectFile)
+{
+    // The errors are put by the message view
+    if(!ProjectManager::instance()->loadProject(projectFile)){
+        clearItems();
+        return false;
+    }
+
+    simulatorItem = findSimulatorItem();
+    if(!simulatorItem){
+        if(simulatorName.empty()){
+            cerr << projectFile << ": No simulator item is found." << endl;
+        } else {
+            cerr << projectFile << ": Simulator item \"" << simulatorName << "\" is not found." << endl;
+        }
+        clearItems();
+        return false;
+    }
+
+    simulatorItem->setRecordingMode(SimulatorItem::RECORD_FULL);
+    simulatorItem->setTimeRangeMode(SimulatorItem::SPECIFIED_PERIOD);
+    simulatorItem->setSpecifiedRecordingTimeLength(timeLength);
+    simulatorItem->setRealtimeSyncMode(false);
+
+    Connection connection =
+        simulatorItem->sigSimulationFinished().connect(
+            boost::bind(&BatchSimulation::onSimulationFinished, this));
+
+    simulatedTime = 0.0;
+    QElapsedTimer timer;
+    timer.start();
+
+    bool result = simulatorItem->startSimulation(true);
+    if(result){
+        // The event loop is quit when the simulation is finished
+        qApp->exec();
+
+        const double elapsedTime = timer.elapsed() / 1000.0;
+        cout << boost::format("%1%: %2% [s] simulated in %3% [s] (x%4%)")
+            % projectFile % simulatedTime % elapsedTime
+            % (elapsedTime > 0.0 ? (simulatedTime / elapsedTime) : 0.0)
+             << endl;
+    } else {
+        cerr << projectFile << ": The simulation cannot be started." << endl;
+    }
+
+    connection.disconnect();
+    clearItems();
+
+    return result;
+}
+
+
+SimulatorItem* BatchSimulation::findSimulatorItem()
+{
+    ItemList<SimulatorItem> simulatorItems;
+    simulatorItems.extractChildItems(RootItem::instance());
+    for(size_t i=0; i < simulatorItems.size(); ++i){
+        if(simulatorName.empty() || simulatorItems[i]->name() == simulatorName){
+            return simulatorItems[i].get();
+        }
+    }
+    return 0;
+}
+
+
+void BatchSimulation::onSimulationFinished()
+{
+    simulatedTime = simulatorItem->currentTime();
+
+    if(!outputDirectory.empty()){
+        saveResultMotions();
+    }
+
+    qApp->quit();
+}
+
+
+/**
+   The simulation bodies are still available when sigSimulationFinished is emitted,
+   so the result motion items are found here by the names given by the simulator item.
+*/
+void BatchSimulation::saveResultMotions()
+{
+    const vector<SimulationBody*>& simBodies = simulatorItem->simulationBodies();
+    for(size_t i=0; i < simBodies.size(); ++i){
+        BodyItem* bodyItem = simBodies[i]->bodyItem();
+        const string motionName = simulatorItem->name() + "-" + bodyItem->name();
+        ItemList<BodyMotionItem> motionItems;
+        motionItems.extractChildItems(bodyItem);
+        for(size_t j=0; j < motionItems.size(); ++j){
+            BodyMotionItem* motionItem = motionItems[j].get();
+            if(motionItem->name() == motionName){
+                filesystem::path file = filesystem::path(outputDirectory) / (motionName + ".yaml");
+                if(!motionItem->motion()->saveAsStandardYAMLformat(getNativePathString(file))){
+                    cerr << "The motion cannot be saved to " << getNativePathString(file) << "." << endl;
+                }
+                break;
+            }
+        }
+    }
+}
+
+
+void BatchSimulation::clearItems()
+{
+    Item* item = RootItem::instance()->childItem();
+    while(item){
+        Item* next = item->nextItem();
+        item->detachFromParentItem();
+        item = next;
+    }
+}
+
+
+namespace {
+
+/**
+   The part of the base module initialized by App which is required to load projects and run simulations.
+   The views and the tool bars are created without being mounted because the items refer to them.
+*/
+void initializeBaseModule(ExtensionManager* ext)
+{
+    AppConfig::initialize("Choreonoid", "Choreonoid");
+
+    ViewManager::initializeClass(ext);
+    MessageView::initializeClass(ext);
+    MessageView::instance()->enableStderrOutput(true);
+    RootItem::initializeClass(ext);
+    ProjectManager::initialize(ext);
+    TimeBar::initialize(ext);
+    ItemTreeView::initializeClass(ext);
+
+    TimeSyncItemEngineManager::initialize();
+
+    FolderItem::initializeClass(ext);
+    MultiValueSeqItem::initializeClass(ext);
+    MultiSE3SeqItem::initializeClass(ext);
+    MultiAffine3SeqItem::initializeClass(ext);
+    Vector3SeqItem::initializeClass(ext);
+    SceneItem::initializeClass(ext);
+
+    PluginManager::initialize(ext);
+}
+
+
+bool loadPlugins(vector<string> pluginNames)
+{
+    PluginManager* pluginManager = PluginManager::instance();
+
+    if(const char* pluginPathList = getenv("CNOID_PLUGIN_PATH")){
+        pluginManager->scanPluginFilesInPathList(pluginPathList);
+    }
+    pluginManager->scanPluginFilesInDirectoyOfExecFile();
+
+    pluginNames.insert(pluginNames.begin(), "Body");
+    pluginManager->selectPlugins(pluginNames);
+    pluginManager->loadPlugins();
+
+    bool loaded = true;
+    for(size_t i=0; i < pluginNames.size(); ++i){
+        bool isActive = false;
+        for(int j=0; j < pluginManager->numPlugins(); ++j){
+            if(pluginManager->pluginName(j) == pluginNames[i] &&
+               pluginManager->pluginStatus(j) == PluginManager::ACTIVE){
+                isActive = true;
+                break;
+            }
+        }
+        if(!isActive){
+            cerr << "The " << pluginNames[i] << " plugin cannot be loaded." << endl;
+            loaded = false;
+        }
+    }
+    return loaded;
+}
+
+}
+
+
+int main(int argc, char *argv[])
+{
+    // This is required to render the vision sensors in the rendering threads
+    QCoreApplication::setAttribute(Qt::AA_X11InitThreads);
+
+    // The options for Qt such as "-platform" are removed from argv here
+    QApplication qapplication(argc, argv);
+
+    namespace po = boost::program_options;
+
+    BatchSimulation simulation;
+    vector<string> pluginNames;
+    vector<string> projectFiles;
+
+    po::options_description options("Options");
+    options.add_options()
+        ("help,h", "show this help")
+        ("simulator,s", po::value<string>(&simulation.simulatorName),
+         "the name of the simulator item to run (the first one is used by default)")
+        ("time,t", po::value<double>(&simulation.timeLength)->default_value(10.0),
+         "the simulation time length [s]")
+        ("output,o", po::value<string>(&simulation.outputDirectory),
+         "the directory to which the result motions are saved")
+        ("plugin,p", po::value< vector<string> >(&pluginNames),
+         "the name of a plugin required by the projects in addition to the Body plugin")
+        ("project", po::value< vector<string> >(&projectFiles), "project files");
+
+    po::positional_options_description positionalOptions;
+    positionalOptions.add("project", -1);
+
+    po::variables_map variables;
+    try {
+        po::store(po::command_line_parser(argc, argv)
+                  .options(options).positional(positionalOptions).run(), variables);
+        po::notify(variables);
+    } catch(const po::error& ex){
+        cerr << ex.what() << endl;
+        return 1;
+    }
+
+    if(variables.count("help") || projectFiles.empty()){
+        cout << "Usage: choreonoid-batch [options] project-file ...\n" << options << endl;
+        return variables.count("help") ? 0 : 1;
+    }
+
+    if(!simulation.outputDirectory.empty()){
+        filesystem::create_directories(filesystem::path(simulation.outputDirectory));
+    }
+
+    setlocale(LC_ALL, ""); // for gettext
+
+    ExtensionManager* ext = new ExtensionManager("Base", false);
+    initializeBaseModule(ext);
+
+    int numFailures = 0;
+    if(!loadPlugins(pluginNames)){
+        numFailures = projectFiles.size();
+    } else {
+        for(size_t i=0; i < projectFiles.size(); ++i){
+            if(!simulation.run(projectFiles[i])){
+                ++numFailures;
+            }
+        }
+    }
+
+    /*
+      The plugins are finalized while the base module is alive, and the objects of the base module
+      are deleted before the QApplication object. AppConfig is not flushed so that the batch runs
+      do not change the configuration of the application.
+    */
+    PluginManager::finalize();
+    delete ext;
+
+    return (numFailures > 0) ? 1 : 0;
+}
@@ -399,6 +399,14 @@ void FCLCollisionDetector::updatePosition(int geometryId, const Position& positi
 }
 
 
+void FCLCollisionDetector::updatePositions(int begin, int end, const Position* positions)
+{
+    for(int i=begin; i < end; ++i){
+        impl->updatePosition(i, *positions++);
+    }
+}
+
+
 void FCLCollisionDetectorImpl::updatePosition(int geometryId, const Position& _position)
 {
     CollisionObjectExPtr& model = models[geometryId];
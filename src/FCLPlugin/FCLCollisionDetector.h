@@ -28,6 +28,7 @@ public:
     virtual void setNonInterfarenceGeometyrPair(int geometryId1, int geometryId2);
     virtual bool makeReady();
     virtual void updatePosition(int geometryId, const Position& position);
+    virtual void updatePositions(int begin, int end, const Position* positions);
     virtual void detectCollisions(boost::function<void(const CollisionPair&)> callback);
 
 private:
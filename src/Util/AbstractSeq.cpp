@@ -6,6 +6,7 @@
 #include "AbstractSeq.h"
 #include "YAMLWriter.h"
 #include <boost/format.hpp>
+#include <algorithm>
 
 using namespace std;
 using namespace boost;
@@ -147,7 +148,8 @@ AbstractMultiSeq::AbstractMultiSeq(const char* seqType)
 
 
 AbstractMultiSeq::AbstractMultiSeq(const AbstractMultiSeq& org)
-    : AbstractSeq(org)
+    : AbstractSeq(org),
+      partLabels(org.partLabels)
 {
 
 }
@@ -156,6 +158,7 @@ AbstractMultiSeq::AbstractMultiSeq(const AbstractMultiSeq& org)
 AbstractMultiSeq& AbstractMultiSeq::operator=(const AbstractMultiSeq& rhs)
 {
     AbstractSeq::operator=(rhs);
+    partLabels = rhs.partLabels;
     return *this;
 }
 
@@ -163,6 +166,7 @@ AbstractMultiSeq& AbstractMultiSeq::operator=(const AbstractMultiSeq& rhs)
 void AbstractMultiSeq::copySeqProperties(const AbstractMultiSeq& source)
 {
     AbstractSeq::copySeqProperties(source);
+    partLabels = source.partLabels;
 }
 
 
@@ -174,6 +178,12 @@ AbstractMultiSeq::~AbstractMultiSeq()
 
 int AbstractMultiSeq::partIndex(const std::string& partLabel) const
 {
+    const int n = std::min((int)partLabels.size(), getNumParts());
+    for(int i=0; i < n; ++i){
+        if(partLabels[i] == partLabel){
+            return i;
+        }
+    }
     return -1;
 }
 
@@ -181,10 +191,25 @@ int AbstractMultiSeq::partIndex(const std::string& partLabel) const
 const std::string& AbstractMultiSeq::partLabel(int partIndex) const
 {
     static const std::string nolabel;
+    if(partIndex >= 0 && partIndex < (int)partLabels.size()){
+        return partLabels[partIndex];
+    }
     return nolabel;
 }
 
 
+void AbstractMultiSeq::setPartLabel(int partIndex, const std::string& label)
+{
+    if(partIndex >= (int)partLabels.size()){
+        if(label.empty()){
+            return;
+        }
+        partLabels.resize(partIndex + 1);
+    }
+    partLabels[partIndex] = label;
+}
+
+
 bool AbstractMultiSeq::doWriteSeq(YAMLWriter& writer)
 {
     writer.putKeyValue("numParts", getNumParts());
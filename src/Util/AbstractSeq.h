@@ -7,6 +7,7 @@
 #define CNOID_UTIL_ABSTRACT_SEQ_H
 
 #include <string>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
 #include "exportdecl.h"
@@ -134,6 +135,7 @@ public:
 
     virtual int partIndex(const std::string& partLabel) const;
     virtual const std::string& partLabel(int partIndex) const;
+    void setPartLabel(int partIndex, const std::string& label);
 
 protected:
     virtual bool doWriteSeq(YAMLWriter& writer);
@@ -141,6 +143,9 @@ protected:
     typedef boost::function<void(const std::string& label, int index)> SetPartLabelFunction;
     bool readSeqPartLabels(const Mapping& archive, SetPartLabelFunction setPartLabel);
     bool writeSeqPartLabels(YAMLWriter& writer);
+
+private:
+    std::vector<std::string> partLabels;
 };
 
 typedef boost::shared_ptr<AbstractMultiSeq> AbstractMultiSeqPtr;
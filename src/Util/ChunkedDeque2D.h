@@ -0,0 +1,523 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_UTIL_CHUNKED_DEQUE_2D_H
+#define CNOID_UTIL_CHUNKED_DEQUE_2D_H
+
+#include <Eigen/StdVector>
+#include <deque>
+#include <memory>
+#include <iterator>
+
+namespace cnoid {
+
+/**
+   A two dimensional container which has the same interface as Deque2D.
+   The rows are stored in the fixed size chunks of memory instead of a single ring buffer,
+   so appending a row never moves the existing elements and popping the front rows releases
+   the memory of the chunks which become empty. The elements of a row are contiguous and
+   any row can be accessed by its index in a constant time.
+
+   The elements which are not used in the allocated chunks always have the default value.
+*/
+template <typename ElementType, typename Allocator = std::allocator<ElementType> >
+class ChunkedDeque2D
+{
+    typedef ChunkedDeque2D<ElementType, Allocator> ChunkedDeque2DType;
+
+public:
+    typedef ElementType Element;
+
+    class const_iterator : public std::iterator<std::random_access_iterator_tag, ElementType> {
+
+        friend class ChunkedDeque2D<ElementType, Allocator>;
+
+    protected:
+        const ChunkedDeque2DType* owner;
+        int index;
+
+        const_iterator(const ChunkedDeque2DType& owner, int index) {
+            this->owner = &owner;
+            this->index = index;
+        }
+
+        ElementType* pointer() const {
+            return owner->rowTop(index / owner->colSize_) + (index % owner->colSize_);
+        }
+
+    public:
+        const_iterator() { }
+
+        const_iterator(const const_iterator& org) {
+            owner = org.owner;
+            index = org.index;
+        }
+
+        const Element& operator*() const {
+            return *pointer();
+        }
+        const_iterator& operator++() {
+            ++index;
+            return *this;
+        }
+        const_iterator& operator--() {
+            --index;
+            return *this;
+        }
+        const_iterator& operator+=(size_t n){
+            index += n;
+            return *this;
+        }
+        const_iterator& operator-=(size_t n){
+            index -= n;
+            return *this;
+        }
+        const_iterator operator+(size_t n){
+            const_iterator iter(*this);
+            iter += n;
+            return iter;
+        }
+        const_iterator operator-(size_t n){
+            const_iterator iter(*this);
+            iter -= n;
+            return iter;
+        }
+        bool operator==(const const_iterator& rhs) const {
+            return (index == rhs.index);
+        }
+        bool operator!=(const const_iterator& rhs) const {
+            return (index != rhs.index);
+        }
+    };
+
+    class iterator : public const_iterator {
+
+        friend class ChunkedDeque2D<ElementType, Allocator>;
+
+        iterator(ChunkedDeque2DType& owner, int index) : const_iterator(owner, index) { }
+
+    public:
+        iterator() { }
+        iterator(const iterator& org) : const_iterator(org) { }
+
+        Element& operator*() {
+            return *const_iterator::pointer();
+        }
+        iterator& operator+=(size_t n){
+            const_iterator::index += n;
+            return *this;
+        }
+        iterator& operator-=(size_t n){
+            const_iterator::index -= n;
+            return *this;
+        }
+        iterator operator+(size_t n){
+            iterator iter(*this);
+            iter += n;
+            return iter;
+        }
+        iterator operator-(size_t n){
+            iterator iter(*this);
+            iter -= n;
+            return iter;
+        }
+    };
+
+    iterator begin() {
+        return iterator(*this, 0);
+    }
+
+    const_iterator cbegin() const {
+        return const_iterator(*this, 0);
+    }
+
+    iterator end() {
+        return iterator(*this, rowSize_ * colSize_);
+    }
+
+    const_iterator cend() const {
+        return const_iterator(*this, rowSize_ * colSize_);
+    }
+
+    class Row
+    {
+        ElementType* top;
+        int size_;
+
+    public:
+        Row() {
+            size_ = 0;
+        }
+
+        Row(const ChunkedDeque2D<ElementType, Allocator>& owner, int rowIndex) {
+            size_ = owner.colSize_;
+            top = (size_ > 0) ? owner.rowTop(rowIndex) : 0;
+        }
+
+        bool empty() const {
+            return (size_ == 0);
+        }
+
+        int size() const {
+            return size_;
+        }
+
+        Element& operator[](int index){
+            return top[index];
+        }
+
+        const Element& operator[](int index) const {
+            return top[index];
+        }
+
+        Element& at(int index) {
+            return top[index];
+        }
+
+        Element* begin() {
+            return top;
+        }
+
+        Element* end() {
+            return top + size_;
+        }
+    };
+
+    class Column
+    {
+    public:
+        Column() {
+            owner = 0;
+            column = 0;
+            rowSize = 0;
+        }
+
+        Column(const ChunkedDeque2D<ElementType, Allocator>& owner, int column) {
+            this->owner = &owner;
+            this->column = column;
+            rowSize = owner.rowSize_;
+        }
+
+        bool empty() const {
+            return (rowSize == 0);
+        }
+
+        int size() const {
+            return rowSize;
+        }
+
+        Element& operator[](int rowIndex){
+            return owner->rowTop(rowIndex)[column];
+        }
+
+        const Element& operator[](int rowIndex) const {
+            return owner->rowTop(rowIndex)[column];
+        }
+
+        Element& at(int index) {
+            return owner->rowTop(index)[column];
+        }
+
+        class iterator : public std::iterator<std::bidirectional_iterator_tag, ElementType, int> {
+
+            const ChunkedDeque2DType* owner;
+            int column;
+            int rowIndex;
+
+        public:
+
+            iterator() { }
+
+            iterator(Column& column, int rowIndex){
+                owner = column.owner;
+                this->column = column.column;
+                this->rowIndex = rowIndex;
+            }
+            Element& operator*() {
+                return owner->rowTop(rowIndex)[column];
+            }
+            void operator++() {
+                ++rowIndex;
+            }
+            void operator--() {
+                --rowIndex;
+            }
+            bool operator==(iterator rhs) const {
+                return (rowIndex == rhs.rowIndex);
+            }
+            bool operator!=(iterator rhs) const {
+                return (rowIndex != rhs.rowIndex);
+            }
+        };
+
+        iterator begin() {
+            return iterator(*this, 0);
+        }
+        iterator end() {
+            return iterator(*this, rowSize);
+        }
+
+    private:
+        const ChunkedDeque2DType* owner;
+        int column;
+        int rowSize;
+    };
+
+    ChunkedDeque2D() {
+        initialize();
+    }
+
+    ChunkedDeque2D(int rowSize, int colSize) {
+        initialize();
+        resize(rowSize, colSize);
+    }
+
+    ChunkedDeque2D(const ChunkedDeque2DType& org) {
+        initialize();
+        copyFrom(org);
+    }
+
+    ChunkedDeque2DType& operator=(const ChunkedDeque2DType& rhs) {
+        if(this != &rhs){
+            copyFrom(rhs);
+        }
+        return *this;
+    }
+
+    virtual ~ChunkedDeque2D() {
+        releaseChunks();
+    }
+
+    bool empty() const {
+        return !rowSize_ || !colSize_;
+    }
+
+private:
+    void initialize() {
+        offset = 0;
+        rowSize_ = 0;
+        colSize_ = 0;
+        chunkShift = 0;
+        chunkRowMask = 0;
+        chunkSize = 0;
+    }
+
+    ElementType* rowTop(int rowIndex) const {
+        const int pos = offset + rowIndex;
+        return chunks[pos >> chunkShift] + (pos & chunkRowMask) * colSize_;
+    }
+
+    void allocateChunk() {
+        ElementType* chunk = allocator.allocate(chunkSize);
+        ElementType* p = chunk;
+        ElementType* pend = chunk + chunkSize;
+        while(p != pend){
+            allocator.construct(p++, ElementType());
+        }
+        chunks.push_back(chunk);
+    }
+
+    void releaseChunk(ElementType* chunk) {
+        ElementType* p = chunk;
+        ElementType* pend = chunk + chunkSize;
+        while(p != pend){
+            allocator.destroy(p++);
+        }
+        allocator.deallocate(chunk, chunkSize);
+    }
+
+    void releaseChunks() {
+        for(size_t i=0; i < chunks.size(); ++i){
+            releaseChunk(chunks[i]);
+        }
+        chunks.clear();
+        offset = 0;
+    }
+
+    void clearRows(int beginRow, int endRow) {
+        for(int i=beginRow; i < endRow; ++i){
+            ElementType* p = rowTop(i);
+            ElementType* pend = p + colSize_;
+            while(p != pend){
+                *p++ = ElementType();
+            }
+        }
+    }
+
+    void setColumnSize(int newColSize) {
+        releaseChunks();
+        rowSize_ = 0;
+        colSize_ = newColSize;
+
+        // A chunk has the rows of the power of two so that a row is found by a bit shift
+        static const size_t minChunkBytes = 65536;
+        chunkShift = 4;
+        while(chunkShift < 16 && ((size_t)1 << chunkShift) * colSize_ * sizeof(ElementType) < minChunkBytes){
+            ++chunkShift;
+        }
+        chunkRowMask = (1 << chunkShift) - 1;
+        chunkSize = (1 << chunkShift) * colSize_;
+    }
+
+    void copyFrom(const ChunkedDeque2DType& org) {
+        setColumnSize(org.colSize_);
+        resize(org.rowSize_, org.colSize_);
+        for(int i=0; i < rowSize_ && colSize_ > 0; ++i){
+            ElementType* src = org.rowTop(i);
+            std::copy(src, src + colSize_, rowTop(i));
+        }
+    }
+
+public:
+    /**
+       The existing elements are kept when only the row size is changed.
+       All the elements are initialized with the default value when the column size is changed.
+    */
+    void resize(int newRowSize, int newColSize) {
+
+        if(newColSize != colSize_){
+            setColumnSize(newColSize);
+        }
+
+        if(colSize_ > 0){
+            if(newRowSize > rowSize_){
+                while(offset + newRowSize > ((int)chunks.size() << chunkShift)){
+                    allocateChunk();
+                }
+            } else if(newRowSize < rowSize_){
+                if(newRowSize == 0){
+                    releaseChunks();
+                } else {
+                    clearRows(newRowSize, rowSize_);
+                    const size_t numNecessaryChunks = ((offset + newRowSize - 1) >> chunkShift) + 1;
+                    while(chunks.size() > numNecessaryChunks){
+                        releaseChunk(chunks.back());
+                        chunks.pop_back();
+                    }
+                }
+            }
+        }
+
+        rowSize_ = newRowSize;
+    }
+
+    void resizeColumn(int newColSize){
+        resize(rowSize_, newColSize);
+    }
+
+    int rowSize() const {
+        return rowSize_;
+    }
+
+    void resizeRow(int newRowSize){
+        resize(newRowSize, colSize_);
+    }
+
+    int colSize() const {
+        return colSize_;
+    }
+
+    void clear() {
+        resize(0, 0);
+    }
+
+    const Element& operator()(int rowIndex, int colIndex) const {
+        return rowTop(rowIndex)[colIndex];
+    }
+
+    Element& operator()(int rowIndex, int colIndex) {
+        return rowTop(rowIndex)[colIndex];
+    }
+
+    const Element& at(int rowIndex, int colIndex) const {
+        return rowTop(rowIndex)[colIndex];
+    }
+
+    Element& at(int rowIndex, int colIndex) {
+        return rowTop(rowIndex)[colIndex];
+    }
+
+    Row operator[](int rowIndex) {
+        return Row(*this, rowIndex);
+    }
+
+    const Row operator[](int rowIndex) const {
+        return Row(*this, rowIndex);
+    }
+
+    Row row(int rowIndex) {
+        return Row(*this, rowIndex);
+    }
+
+    const Row row(int rowIndex) const {
+        return Row(*this, rowIndex);
+    }
+
+    Row last() {
+        return Row(*this, rowSize_ - 1);
+    }
+
+    const Row last() const {
+        return Row(*this, rowSize_ - 1);
+    }
+
+    Column column(int colIndex) {
+        return Column(*this, colIndex);
+    }
+
+    const Column column(int colIndex) const {
+        return Column(*this, colIndex);
+    }
+
+    Row append() {
+        resize(rowSize_ + 1, colSize_);
+        return Row(*this, rowSize_ - 1);
+    }
+
+    void pop_back() {
+        resize(rowSize_ - 1, colSize_);
+    }
+
+    void pop_front(int numRows) {
+        if(numRows <= 0){
+            return;
+        }
+        if(numRows > rowSize_){
+            numRows = rowSize_;
+        }
+        if(colSize_ > 0){
+            if(numRows == rowSize_){
+                releaseChunks();
+            } else {
+                clearRows(0, numRows);
+                offset += numRows;
+                while(offset > chunkRowMask){
+                    releaseChunk(chunks.front());
+                    chunks.pop_front();
+                    offset -= (chunkRowMask + 1);
+                }
+            }
+        }
+        rowSize_ -= numRows;
+    }
+
+    void pop_front() {
+        pop_front(1);
+    }
+
+private:
+    Allocator allocator;
+    std::deque<ElementType*> chunks;
+    int offset;
+    int rowSize_;
+    int colSize_;
+    int chunkShift;
+    int chunkRowMask;
+    int chunkSize;
+};
+
+}
+
+#endif
@@ -5,6 +5,7 @@
 
 #include "CollisionDetector.h"
 #include <boost/make_shared.hpp>
+#include <boost/bind.hpp>
 #include <map>
 
 using namespace std;
@@ -118,3 +119,43 @@ CollisionDetector::~CollisionDetector()
 {
 
 }
+
+
+namespace {
+
+void storeCollisionPair(const CollisionPair& collisionPair, std::vector<CollisionPair>& out_collisionPairs, size_t& numPairs)
+{
+    if(numPairs < out_collisionPairs.size()){
+        out_collisionPairs[numPairs] = collisionPair;
+    } else {
+        out_collisionPairs.push_back(collisionPair);
+    }
+    ++numPairs;
+}
+
+}
+
+
+int CollisionDetector::detectCollisions(std::vector<CollisionPair>& out_collisionPairs)
+{
+    size_t numPairs = 0;
+    detectCollisions(boost::bind(storeCollisionPair, _1, boost::ref(out_collisionPairs), boost::ref(numPairs)));
+    for(size_t i=numPairs; i < out_collisionPairs.size(); ++i){
+        out_collisionPairs[i].collisions.clear();
+    }
+    return numPairs;
+}
+
+
+void CollisionDetector::updatePositions(int begin, int end, const Position* positions)
+{
+    for(int i=begin; i < end; ++i){
+        updatePosition(i, *positions++);
+    }
+}
+
+
+void CollisionDetector::setNumThreads(int n)
+{
+
+}
@@ -65,13 +65,36 @@ public:
     virtual bool makeReady() = 0;
     virtual void updatePosition(int geometryId, const Position& position) = 0;
 
-    // Is this faster than the above function?
-    //virtual void updatePositions(int begin, int end, const std::vector<Position>& positions) = 0;
+    /**
+       Update the positions of the geometries whose ids are in [begin, end).
+       positions[i] is the position of the geometry whose id is begin + i.
+       The default implementation calls updatePosition() for each geometry.
+       This is not faster than calling updatePosition() for each geometry when the positions
+       have to be copied into an array for this function.
+       See sample/CollisionDetectorUpdateBenchmark for the comparison.
+    */
+    virtual void updatePositions(int begin, int end, const Position* positions);
 
     virtual void detectCollisions(boost::function<void(const CollisionPair&)> callback) = 0;
 
-    // or
-    // virtual void detectCollisions(std::vector<CollisionPair>& out_collisionPairs) = 0;
+    /**
+       Detect the collisions and store the colliding pairs into the first elements of
+       out_collisionPairs in the same order as the callback version outputs them.
+       The existing elements of out_collisionPairs are overwritten to reuse the capacities
+       of their collision lists, and the vector is never shrunk. The collision lists of the
+       elements after the valid ones are cleared without releasing their capacities,
+       so passing the same vector every time avoids the memory allocation in the steady state.
+       The default implementation uses the callback version.
+       \return the number of the valid colliding pairs
+    */
+    virtual int detectCollisions(std::vector<CollisionPair>& out_collisionPairs);
+
+    /**
+       Set the number of threads used in detectCollisions().
+       The detectors which do not support the multi-threaded detection ignore this.
+       The order of the detected collision pairs must not depend on the number of threads.
+    */
+    virtual void setNumThreads(int n);
 
 };
 
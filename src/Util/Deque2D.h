@@ -609,6 +609,11 @@ public:
         if(numRows > rowSize_){
             numRows = rowSize_;
         }
+        if(capacity_ == 0){
+            // no elements when the column size is zero
+            rowSize_ -= numRows;
+            return;
+        }
         const size_t popSize = numRows * colSize_;
         ElementType* p = buf + offset;
         const ElementType* pend = buf + (offset + popSize) % capacity_;
@@ -16,9 +16,10 @@ class Mapping;
 class Listing;
 class YAMLWriter;
         
-class CNOID_EXPORT MultiSE3Seq : public MultiSeq<SE3, Eigen::aligned_allocator<SE3> >
+class CNOID_EXPORT MultiSE3Seq
+    : public MultiSeq<SE3, Eigen::aligned_allocator<SE3>, ChunkedDeque2D<SE3, Eigen::aligned_allocator<SE3> > >
 {
-    typedef MultiSeq<SE3, Eigen::aligned_allocator<SE3> > BaseSeqType;
+    typedef MultiSeq<SE3, Eigen::aligned_allocator<SE3>, ChunkedDeque2D<SE3, Eigen::aligned_allocator<SE3> > > BaseSeqType;
 
 public:
     typedef boost::shared_ptr<MultiSE3Seq> Ptr;
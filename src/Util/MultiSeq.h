@@ -8,6 +8,7 @@
 
 #include "AbstractSeq.h"
 #include "Deque2D.h"
+#include "ChunkedDeque2D.h"
 #include <Eigen/StdVector>
 #include <boost/make_shared.hpp>
 #include <algorithm>
@@ -15,13 +16,19 @@
 
 namespace cnoid {
 
-template <typename ElementType, typename Allocator = std::allocator<ElementType> >
-class MultiSeq : public Deque2D<ElementType, Allocator>, public AbstractMultiSeq
+/**
+   The storage of the frames can be specified by ContainerType.
+   Deque2D stores all the frames in a single ring buffer, and ChunkedDeque2D stores them
+   in the fixed size chunks so that appending frames does not copy the existing ones.
+*/
+template <typename ElementType, typename Allocator = std::allocator<ElementType>,
+          typename ContainerType = Deque2D<ElementType, Allocator> >
+class MultiSeq : public ContainerType, public AbstractMultiSeq
 {
-    typedef MultiSeq<ElementType, Allocator> MultiSeqType;
+    typedef MultiSeq<ElementType, Allocator, ContainerType> MultiSeqType;
         
 public:
-    typedef Deque2D<ElementType, Allocator> Container;
+    typedef ContainerType Container;
     
     typedef typename Container::Element Element;
     typedef boost::shared_ptr< MultiSeqType > Ptr;
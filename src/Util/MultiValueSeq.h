@@ -11,9 +11,9 @@
 
 namespace cnoid {
 
-class CNOID_EXPORT MultiValueSeq : public MultiSeq<double>
+class CNOID_EXPORT MultiValueSeq : public MultiSeq<double, std::allocator<double>, ChunkedDeque2D<double> >
 {
-    typedef MultiSeq<double> BaseSeqType;
+    typedef MultiSeq<double, std::allocator<double>, ChunkedDeque2D<double> > BaseSeqType;
             
 public:
     typedef boost::shared_ptr<MultiValueSeq> Ptr;
@@ -4,9 +4,15 @@
 */
 
 #include "PointSetUtil.h"
-#include <cnoid/EasyScanner>
 #include <cnoid/Exception>
+#include <boost/format.hpp>
+#include <boost/cstdint.hpp>
 #include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
 
 using namespace std;
 using namespace boost;
@@ -14,149 +20,590 @@ using namespace cnoid;
 
 namespace {
 
-enum Element { E_X, E_Y, E_Z, E_NORMAL_X,E_NORMAL_Y, E_NORMAL_Z };
+enum Element { E_X, E_Y, E_Z, E_NORMAL_X, E_NORMAL_Y, E_NORMAL_Z, E_RGB, E_OTHER };
 
-void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vector<Element>& elements, int numPoints)
+struct Field
 {
-    SgVertexArrayPtr vertices = new SgVertexArray();
-    vertices->reserve(numPoints);
+    Element element;
+    int size;
+    char type;
+    int count;
+};
+
+void throwReadError(const std::string& message)
+{
+    throw file_read_error() << error_info_message(message);
+}
 
-    const int numElements = elements.size();
 
+class PointBuffer
+{
+public:
+    SgVertexArrayPtr vertices;
     SgNormalArrayPtr normals;
-    bool hasNormals = false;
-    for(int i=0; i < numElements; ++i){
-        if(elements[i] >= E_NORMAL_X){
-            hasNormals = true;
-            normals = new SgNormalArray();
+    SgColorArrayPtr colors;
+    Vector3f vertex;
+    Vector3f normal;
+    Vector3f color;
+
+    PointBuffer(const vector<Field>& fields) {
+        vertices = new SgVertexArray();
+        vertex.setZero();
+        normal.setZero();
+        color.setZero();
+        for(size_t i=0; i < fields.size(); ++i){
+            const Element element = fields[i].element;
+            if(element >= E_NORMAL_X && element <= E_NORMAL_Z && !normals){
+                normals = new SgNormalArray();
+            } else if(element == E_RGB && !colors){
+                colors = new SgColorArray();
+            }
+        }
+    }
+
+    void reserve(size_t numPoints) {
+        vertices->reserve(numPoints);
+        if(normals){
             normals->reserve(numPoints);
         }
+        if(colors){
+            colors->reserve(numPoints);
+        }
+    }
+
+    void setValue(Element element, double value) {
+        switch(element){
+        case E_X: vertex.x() = value; break;
+        case E_Y: vertex.y() = value; break;
+        case E_Z: vertex.z() = value; break;
+        case E_NORMAL_X: normal.x() = value; break;
+        case E_NORMAL_Y: normal.y() = value; break;
+        case E_NORMAL_Z: normal.z() = value; break;
+        default: break;
+        }
     }
 
-    Vector3f vertex = Vector3f::Zero();
-    Vector3f normal = Vector3f::Zero();
+    // The color is packed into the lower three bytes in the order of red, green and blue
+    void setColor(uint32_t rgb) {
+        color << ((rgb >> 16) & 0xff) / 255.0f, ((rgb >> 8) & 0xff) / 255.0f, (rgb & 0xff) / 255.0f;
+    }
 
-    while(!scanner.isEOF()){
-        scanner.skipBlankLines();
+    void addPoint() {
+        // An invalid point is represented by NaN in the organized point clouds
+        if(vertex.x() != vertex.x() || vertex.y() != vertex.y() || vertex.z() != vertex.z()){
+            return;
+        }
+        vertices->push_back(vertex);
+        if(normals){
+            normals->push_back(normal);
+        }
+        if(colors){
+            colors->push_back(color);
+        }
+    }
+};
 
-        bool hasIllegalValue = false;
-        for(int i=0; i < numElements; ++i){
-            //double value = scanner.readDoubleEx("Illeagel point values");
 
-            if(!scanner.readDouble()){
-                // put warning here
-                hasIllegalValue = true;
-                scanner.skipToLineEnd();
-                break;
-                    
-            } else {
-                double value = scanner.doubleValue;
-                switch(elements[i]){
-                case E_X: vertex.x() = value; break;
-                case E_Y: vertex.y() = value; break;
-                case E_Z: vertex.z() = value; break;
-                case E_NORMAL_X: normal.x() = value; break;
-                case E_NORMAL_Y: normal.y() = value; break;
-                case E_NORMAL_Z: normal.z() = value; break;
+double readBinaryValue(const char* p, char type, int size)
+{
+    if(type == 'F'){
+        if(size == 4){
+            float value;
+            memcpy(&value, p, 4);
+            return value;
+        } else if(size == 8){
+            double value;
+            memcpy(&value, p, 8);
+            return value;
+        }
+    } else if(type == 'U'){
+        switch(size){
+        case 1: { uint8_t value; memcpy(&value, p, 1); return value; }
+        case 2: { uint16_t value; memcpy(&value, p, 2); return value; }
+        case 4: { uint32_t value; memcpy(&value, p, 4); return value; }
+        case 8: { uint64_t value; memcpy(&value, p, 8); return static_cast<double>(value); }
+        }
+    } else if(type == 'I'){
+        switch(size){
+        case 1: { int8_t value; memcpy(&value, p, 1); return value; }
+        case 2: { int16_t value; memcpy(&value, p, 2); return value; }
+        case 4: { int32_t value; memcpy(&value, p, 4); return value; }
+        case 8: { int64_t value; memcpy(&value, p, 8); return static_cast<double>(value); }
+        }
+    }
+    return 0.0;
+}
+
+
+/**
+   The 'rgb' field is usually stored as a float value which has the bits of the packed color,
+   and the 'rgba' field is stored as an unsigned integer.
+*/
+uint32_t readBinaryColor(const char* p)
+{
+    uint32_t rgb;
+    memcpy(&rgb, p, 4);
+    return rgb;
+}
+
+
+/**
+   Each line is parsed separately so that a line with missing values does not take the values
+   of the next line. A line which does not have the values of all the fields is skipped.
+*/
+void readAsciiPoints(PointBuffer& buf, const vector<Field>& fields, const char* p, const char* end)
+{
+    const int numFields = fields.size();
+
+    while(p < end){
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+        if(!lineEnd){
+            lineEnd = end;
+        }
+        bool isValid = true;
+        for(int i=0; isValid && i < numFields; ++i){
+            const Field& field = fields[i];
+            for(int j=0; j < field.count; ++j){
+                while(p < lineEnd && (*p == ' ' || *p == '\t' || *p == '\r')){
+                    ++p;
                 }
+                if(p == lineEnd){
+                    isValid = false;
+                    break;
+                }
+                char* endptr;
+                if(field.element == E_RGB){
+                    uint32_t rgb;
+                    if(field.type == 'F'){
+                        const float value = strtod(p, &endptr);
+                        memcpy(&rgb, &value, 4);
+                    } else {
+                        rgb = strtoul(p, &endptr, 10);
+                    }
+                    if(j == 0){
+                        buf.setColor(rgb);
+                    }
+                } else {
+                    const double value = strtod(p, &endptr);
+                    if(j == 0){
+                        buf.setValue(field.element, value);
+                    }
+                }
+                if(endptr == p || endptr > lineEnd){
+                    isValid = false;
+                    break;
+                }
+                p = endptr;
             }
         }
-        if(!hasIllegalValue){
-            vertices->push_back(vertex);
-            if(hasNormals){
-                normals->push_back(normal);
+        if(isValid){
+            // Extra values also make the line invalid
+            while(p < lineEnd && (*p == ' ' || *p == '\t' || *p == '\r')){
+                ++p;
+            }
+            isValid = (p == lineEnd);
+        }
+        if(isValid){
+            buf.addPoint();
+        }
+        p = (lineEnd < end) ? lineEnd + 1 : end;
+    }
+}
+
+
+/**
+   @param stride The number of bytes from a point to the next point in each field
+   @param fieldOffsets The offset of the first value of each field
+*/
+void readBinaryPoints
+(PointBuffer& buf, const vector<Field>& fields, const char* data, int numPoints,
+ const vector<size_t>& fieldOffsets, const vector<size_t>& strides)
+{
+    const int numFields = fields.size();
+
+    for(int i=0; i < numPoints; ++i){
+        for(int j=0; j < numFields; ++j){
+            const Field& field = fields[j];
+            if(field.element != E_OTHER){
+                const char* p = data + fieldOffsets[j] + i * strides[j];
+                if(field.element == E_RGB){
+                    buf.setColor(readBinaryColor(p));
+                } else {
+                    buf.setValue(field.element, readBinaryValue(p, field.type, field.size));
+                }
             }
         }
-        scanner.readLFEOF();
+        buf.addPoint();
     }
+}
+
 
-    if(vertices->empty()){
-        throw file_read_error() << error_info_message("No valid points");
+/**
+   The decompressor of the LZF format, which is used in the binary_compressed PCD data.
+   @return The size of the decompressed data, or zero if the data is broken
+*/
+size_t decompressLZF(const unsigned char* in, size_t inSize, unsigned char* out, size_t outSize)
+{
+    const unsigned char* ip = in;
+    const unsigned char* const inEnd = in + inSize;
+    unsigned char* op = out;
+    unsigned char* const outEnd = out + outSize;
+
+    while(ip < inEnd){
+        size_t ctrl = *ip++;
+        if(ctrl < 32){
+            // literal run
+            ++ctrl;
+            if(op + ctrl > outEnd || ip + ctrl > inEnd){
+                return 0;
+            }
+            memcpy(op, ip, ctrl);
+            op += ctrl;
+            ip += ctrl;
+        } else {
+            // back reference
+            size_t len = ctrl >> 5;
+            if(len == 7){
+                if(ip >= inEnd){
+                    return 0;
+                }
+                len += *ip++;
+            }
+            if(ip >= inEnd){
+                return 0;
+            }
+            const size_t offset = ((ctrl & 0x1f) << 8) + *ip++ + 1;
+            len += 2;
+            if(op + len > outEnd || offset > static_cast<size_t>(op - out)){
+                return 0;
+            }
+            const unsigned char* ref = op - offset;
+            for(size_t i=0; i < len; ++i){
+                *op++ = *ref++;
+            }
+        }
+    }
+    return op - out;
+}
+
+
+void compressLZF(const unsigned char* in, size_t inSize, vector<unsigned char>& out)
+{
+    static const int hashBits = 14;
+    static const size_t maxOffset = 1 << 13;
+    static const size_t maxLiteralLength = 32;
+    static const size_t maxMatchLength = 264;
+
+    vector<int> hashTable(1 << hashBits, -1);
+
+    out.clear();
+    out.reserve(inSize + inSize / 32 + 16);
+
+    size_t literalHead = out.size();
+    out.push_back(0);
+    size_t literalLength = 0;
+    size_t ip = 0;
+
+    while(ip < inSize){
+        bool isMatched = false;
+        if(ip + 2 < inSize){
+            const uint32_t seq = (in[ip] << 16) | (in[ip + 1] << 8) | in[ip + 2];
+            const uint32_t h = ((seq * 2654435761u) >> (32 - hashBits)) & ((1 << hashBits) - 1);
+            const int ref = hashTable[h];
+            hashTable[h] = ip;
+            if(ref >= 0 && ip - ref - 1 < maxOffset && memcmp(in + ref, in + ip, 3) == 0){
+                const size_t offset = ip - ref - 1;
+                const size_t maxLength = std::min(inSize - ip, maxMatchLength);
+                size_t length = 3;
+                while(length < maxLength && in[ref + length] == in[ip + length]){
+                    ++length;
+                }
+                if(literalLength > 0){
+                    out[literalHead] = literalLength - 1;
+                } else {
+                    out.pop_back();
+                }
+                const size_t encodedLength = length - 2;
+                if(encodedLength < 7){
+                    out.push_back((offset >> 8) + (encodedLength << 5));
+                } else {
+                    out.push_back((offset >> 8) + (7 << 5));
+                    out.push_back(encodedLength - 7);
+                }
+                out.push_back(offset & 0xff);
+                ip += length;
+                literalHead = out.size();
+                out.push_back(0);
+                literalLength = 0;
+                isMatched = true;
+            }
+        }
+        if(!isMatched){
+            out.push_back(in[ip++]);
+            if(++literalLength == maxLiteralLength){
+                out[literalHead] = literalLength - 1;
+                literalHead = out.size();
+                out.push_back(0);
+                literalLength = 0;
+            }
+        }
+    }
+
+    if(literalLength > 0){
+        out[literalHead] = literalLength - 1;
     } else {
-        out_pointSet->setVertices(vertices);
-        out_pointSet->setNormals(normals);
-        out_pointSet->normalIndices().clear();
-        out_pointSet->setColors(0);
-        out_pointSet->colorIndices().clear();
+        out.pop_back();
     }
 }
+
 }
 
 
 void cnoid::loadPCD(SgPointSet* out_pointSet, const std::string& filename)
 {
-    try {
-        EasyScanner scanner(filename);
-        scanner.setCommentChar('#');
-
-        int numPoints = 0;
-
-        std::vector<Element> elements;
-
-        while(true){
-            scanner.skipBlankLines();
-            scanner.readWordEx("Illegal header key");
-
-            if(scanner.stringValue == "FIELDS"){
-                while(scanner.readWord()){
-                    if(scanner.stringValue == "x"){
-                        elements.push_back(E_X);
-                    } else if(scanner.stringValue == "y"){
-                        elements.push_back(E_Y);
-                    } else if(scanner.stringValue == "z"){
-                        elements.push_back(E_Z);
-                    } else if(scanner.stringValue == "normal_x"){
-                        elements.push_back(E_NORMAL_X);
-                    } else if(scanner.stringValue == "normal_y"){
-                        elements.push_back(E_NORMAL_Y);
-                    } else if(scanner.stringValue == "normal_z"){
-                        elements.push_back(E_NORMAL_Z);
-                    }
-                }
-            } else if(scanner.stringValue == "POINTS"){
-                numPoints = scanner.readIntEx("The 'POINTS' field is not correctly specified.");
-            } else if(scanner.stringValue == "DATA"){
-                scanner.readWordEx("The 'DATA' field is not correctly specified.");
-                if(scanner.stringValue == "ascii"){
-                    scanner.readLFex();
-                    if(elements.empty()){
-                        scanner.throwException("The specification of field elements is not found.");
-                    }
-                    readPoints(out_pointSet, scanner, elements, numPoints);
-                    break;
+    ifstream ifs(filename.c_str(), ios::in | ios::binary);
+    if(!ifs){
+        throwReadError(filename + " cannot be opened.");
+    }
+    ifs.seekg(0, ios::end);
+    const size_t fileSize = ifs.tellg();
+    ifs.seekg(0, ios::beg);
+    // A null character is appended to parse the ascii data as a string
+    vector<char> buffer(fileSize + 1, '\0');
+    ifs.read(&buffer[0], fileSize);
+    ifs.close();
+
+    vector<Field> fields;
+    vector<int> sizes;
+    vector<char> types;
+    vector<int> counts;
+    int width = 0;
+    int height = 1;
+    int numPoints = -1;
+    string dataFormat;
+    size_t pos = 0;
+
+    while(dataFormat.empty()){
+        if(pos >= fileSize){
+            throwReadError("The 'DATA' field is not found.");
+        }
+        size_t end = pos;
+        while(end < fileSize && buffer[end] != '\n'){
+            ++end;
+        }
+        istringstream line(string(&buffer[pos], end - pos));
+        pos = end + 1;
+
+        string key;
+        line >> key;
+        if(key.empty() || key[0] == '#'){
+            continue;
+        } else if(key == "FIELDS"){
+            string name;
+            while(line >> name){
+                Field field;
+                if(name == "x"){
+                    field.element = E_X;
+                } else if(name == "y"){
+                    field.element = E_Y;
+                } else if(name == "z"){
+                    field.element = E_Z;
+                } else if(name == "normal_x"){
+                    field.element = E_NORMAL_X;
+                } else if(name == "normal_y"){
+                    field.element = E_NORMAL_Y;
+                } else if(name == "normal_z"){
+                    field.element = E_NORMAL_Z;
+                } else if(name == "rgb" || name == "rgba"){
+                    field.element = E_RGB;
                 } else {
-                    scanner.throwException("The 'ascii' format is only supported for the point DATA.");
+                    field.element = E_OTHER;
                 }
-            } else {
-                scanner.skipToLineEnd();
+                field.size = 4;
+                field.type = 'F';
+                field.count = 1;
+                fields.push_back(field);
+            }
+        } else if(key == "SIZE"){
+            int size;
+            while(line >> size){
+                sizes.push_back(size);
             }
-            scanner.readLFEOFex("The field value is not correctly specified.");
+        } else if(key == "TYPE"){
+            char type;
+            while(line >> type){
+                types.push_back(type);
+            }
+        } else if(key == "COUNT"){
+            int count;
+            while(line >> count){
+                counts.push_back(count);
+            }
+        } else if(key == "WIDTH"){
+            line >> width;
+        } else if(key == "HEIGHT"){
+            line >> height;
+        } else if(key == "POINTS"){
+            if(!(line >> numPoints)){
+                throwReadError("The 'POINTS' field is not correctly specified.");
+            }
+        } else if(key == "DATA"){
+            if(!(line >> dataFormat)){
+                throwReadError("The 'DATA' field is not correctly specified.");
+            }
+        }
+    }
+
+    if(fields.empty()){
+        throwReadError("The specification of field elements is not found.");
+    }
+    for(size_t i=0; i < fields.size(); ++i){
+        Field& field = fields[i];
+        if(i < sizes.size()){
+            field.size = sizes[i];
+        }
+        if(i < types.size()){
+            field.type = types[i];
+        }
+        if(i < counts.size()){
+            field.count = counts[i];
+        }
+        if(field.size <= 0 || field.count <= 0){
+            throwReadError("The size and count of a field must be positive.");
+        }
+        if(field.element == E_RGB && field.size != 4){
+            throwReadError("The size of the color field must be 4.");
+        }
+    }
+    if(numPoints < 0){
+        if(width < 0 || height < 0 || (height > 0 && width > INT_MAX / height)){
+            throwReadError("The 'WIDTH' and 'HEIGHT' fields are not correctly specified.");
+        }
+        numPoints = width * height;
+    }
+
+    PointBuffer buf(fields);
+    const int numFields = fields.size();
+    vector<size_t> fieldOffsets(numFields);
+    vector<size_t> strides(numFields);
+    const size_t dataSize = (pos < fileSize) ? (fileSize - pos) : 0;
+
+    if(dataFormat == "ascii"){
+        // The buffers are not reserved beyond the number of the lines which the data can contain
+        buf.reserve(std::min((size_t)numPoints, dataSize / 2 + 1));
+        readAsciiPoints(buf, fields, &buffer[0] + fileSize - dataSize, &buffer[0] + fileSize);
+
+    } else if(dataFormat == "binary"){
+        // The values of a point are stored contiguously
+        size_t pointSize = 0;
+        for(int i=0; i < numFields; ++i){
+            fieldOffsets[i] = pointSize;
+            pointSize += fields[i].size * fields[i].count;
+        }
+        for(int i=0; i < numFields; ++i){
+            strides[i] = pointSize;
+        }
+        if(pointSize == 0 || (size_t)numPoints > dataSize / pointSize){
+            throwReadError("The binary data is shorter than the specified number of points.");
         }
-    } catch(EasyScanner::Exception& ex){
-        throw file_read_error() << error_info_message(ex.getFullMessage());
+        buf.reserve(numPoints);
+        readBinaryPoints(buf, fields, &buffer[pos], numPoints, fieldOffsets, strides);
+
+    } else if(dataFormat == "binary_compressed"){
+        // The values of a field are stored contiguously in the decompressed data
+        if(pos + 8 > fileSize){
+            throwReadError("The size of the compressed data is not found.");
+        }
+        uint32_t compressedSize;
+        uint32_t uncompressedSize;
+        memcpy(&compressedSize, &buffer[pos], 4);
+        memcpy(&uncompressedSize, &buffer[pos + 4], 4);
+        pos += 8;
+        if(pos + compressedSize > fileSize){
+            throwReadError("The compressed data is shorter than the specified size.");
+        }
+        size_t pointSize = 0;
+        for(int i=0; i < numFields; ++i){
+            strides[i] = fields[i].size * fields[i].count;
+            pointSize += strides[i];
+        }
+        if(pointSize == 0 || (size_t)numPoints > uncompressedSize / pointSize){
+            throwReadError("The compressed data is shorter than the specified number of points.");
+        }
+        size_t fieldOffset = 0;
+        for(int i=0; i < numFields; ++i){
+            fieldOffsets[i] = fieldOffset;
+            fieldOffset += strides[i] * numPoints;
+        }
+        buf.reserve(numPoints);
+        vector<unsigned char> data(uncompressedSize + 1);
+        if(decompressLZF(reinterpret_cast<unsigned char*>(&buffer[pos]), compressedSize,
+                         &data[0], uncompressedSize) != uncompressedSize){
+            throwReadError("The compressed data is broken.");
+        }
+        readBinaryPoints(buf, fields, reinterpret_cast<char*>(&data[0]), numPoints, fieldOffsets, strides);
+
+    } else {
+        throwReadError(str(format("The '%1%' format of the point DATA is not supported.") % dataFormat));
+    }
+
+    if(buf.vertices->empty()){
+        throwReadError("No valid points");
+    } else {
+        out_pointSet->setVertices(buf.vertices);
+        out_pointSet->setNormals(buf.normals);
+        out_pointSet->normalIndices().clear();
+        out_pointSet->setColors(buf.colors);
+        out_pointSet->colorIndices().clear();
     }
 }
 
 
-void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Affine3& viewpoint)
+void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Affine3& viewpoint, PCDDataFormat dataFormat)
 {
     if(!pointSet->hasVertices()){
         throw empty_data_error() << error_info_message("Empty pointset");
     }
 
+    const SgVertexArray& points = *pointSet->vertices();
+    const int numPoints = points.size();
+
+    const SgNormalArray* normals = 0;
+    if(pointSet->hasNormals() && pointSet->normals()->size() == numPoints && pointSet->normalIndices().empty()){
+        normals = pointSet->normals();
+    }
+    const SgColorArray* colors = 0;
+    if(pointSet->hasColors() && pointSet->colors()->size() == numPoints && pointSet->colorIndices().empty()){
+        colors = pointSet->colors();
+    }
+
     ofstream ofs;
-    ofs.open(filename.c_str());
+    ofs.open(filename.c_str(), ios::out | ios::binary);
 
-    ofs <<
-        "# .PCD v.7 - Point Cloud Data file format\n"
-        "VERSION .7\n"
-        "FIELDS x y z\n"
-        "SIZE 4 4 4\n"
-        "TYPE F F F\n"
-        "COUNT 1 1 1\n";
+    ofs << "# .PCD v.7 - Point Cloud Data file format\n"
+        "VERSION .7\n";
+
+    int numFloats = 3;
+    if(!normals){
+        ofs << "FIELDS x y z" << (colors ? " rgba\n" : "\n");
+    } else {
+        ofs << "FIELDS x y z normal_x normal_y normal_z" << (colors ? " rgba\n" : "\n");
+        numFloats = 6;
+    }
+    ofs << "SIZE";
+    for(int i=0; i < numFloats; ++i){
+        ofs << " 4";
+    }
+    ofs << (colors ? " 4\n" : "\n") << "TYPE";
+    for(int i=0; i < numFloats; ++i){
+        ofs << " F";
+    }
+    ofs << (colors ? " U\n" : "\n") << "COUNT";
+    for(int i=0; i < numFloats; ++i){
+        ofs << " 1";
+    }
+    ofs << (colors ? " 1\n" : "\n");
 
-    const SgVertexArray& points = *pointSet->vertices();
-    const int numPoints = points.size();
     ofs << "WIDTH " << numPoints << "\n";
     ofs << "HEIGHT 1\n";
 
@@ -167,12 +614,78 @@ void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Aff
     ofs << q.w() << " " << q.x() << " " << q.y() << " " << q.z() << "\n";
 
     ofs << "POINTS " << numPoints << "\n";
-    
-    ofs << "DATA ascii\n";
 
-    for(int i=0; i < numPoints; ++i){
-        const Vector3f& p = points[i];
-        ofs << p.x() << " " << p.y() << " " << p.z() << "\n";
+    vector<uint32_t> packedColors;
+    if(colors){
+        packedColors.resize(numPoints);
+        for(int i=0; i < numPoints; ++i){
+            const Vector3f& c = (*colors)[i];
+            uint32_t rgb = 0xff;
+            for(int j=0; j < 3; ++j){
+                const float value = std::max(0.0f, std::min(c[j], 1.0f));
+                rgb = (rgb << 8) | static_cast<uint32_t>(value * 255.0f + 0.5f);
+            }
+            packedColors[i] = rgb;
+        }
+    }
+
+    if(dataFormat == PCD_ASCII){
+        ofs << "DATA ascii\n";
+        for(int i=0; i < numPoints; ++i){
+            const Vector3f& p = points[i];
+            ofs << p.x() << " " << p.y() << " " << p.z();
+            if(normals){
+                const Vector3f& n = (*normals)[i];
+                ofs << " " << n.x() << " " << n.y() << " " << n.z();
+            }
+            if(colors){
+                ofs << " " << packedColors[i];
+            }
+            ofs << "\n";
+        }
+    } else {
+        const size_t pointSize = numFloats * 4 + (colors ? 4 : 0);
+        vector<unsigned char> data(pointSize * numPoints);
+        for(int i=0; i < numPoints; ++i){
+            /*
+              The values of a point are stored contiguously in the 'binary' data, and the values
+              of a field are stored contiguously in the 'binary_compressed' data.
+            */
+            size_t offset;
+            size_t stride;
+            if(dataFormat == PCD_BINARY){
+                offset = i * pointSize;
+                stride = 4;
+            } else {
+                offset = i * 4;
+                stride = numPoints * 4;
+            }
+            memcpy(&data[offset], points[i].data(), 4);
+            memcpy(&data[offset + stride], points[i].data() + 1, 4);
+            memcpy(&data[offset + stride * 2], points[i].data() + 2, 4);
+            if(normals){
+                const Vector3f& n = (*normals)[i];
+                memcpy(&data[offset + stride * 3], n.data(), 4);
+                memcpy(&data[offset + stride * 4], n.data() + 1, 4);
+                memcpy(&data[offset + stride * 5], n.data() + 2, 4);
+            }
+            if(colors){
+                memcpy(&data[offset + stride * numFloats], &packedColors[i], 4);
+            }
+        }
+        if(dataFormat == PCD_BINARY){
+            ofs << "DATA binary\n";
+            ofs.write(reinterpret_cast<const char*>(&data[0]), data.size());
+        } else {
+            vector<unsigned char> compressed;
+            compressLZF(&data[0], data.size(), compressed);
+            ofs << "DATA binary_compressed\n";
+            const uint32_t compressedSize = compressed.size();
+            const uint32_t uncompressedSize = data.size();
+            ofs.write(reinterpret_cast<const char*>(&compressedSize), 4);
+            ofs.write(reinterpret_cast<const char*>(&uncompressedSize), 4);
+            ofs.write(reinterpret_cast<const char*>(&compressed[0]), compressed.size());
+        }
     }
 
     ofs.close();
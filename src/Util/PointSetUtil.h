@@ -11,8 +11,20 @@
 
 namespace cnoid {
 
+enum PCDDataFormat { PCD_ASCII, PCD_BINARY, PCD_BINARY_COMPRESSED };
+
+/**
+   The points are loaded from the 'ascii', 'binary' and 'binary_compressed' data.
+   The normals and colors are also loaded when the file has the normal fields
+   and the 'rgb' or 'rgba' field. The points whose coordinates are NaN are skipped.
+*/
 CNOID_EXPORT void loadPCD(SgPointSet* out_pointSet, const std::string& filename);
-CNOID_EXPORT void savePCD(SgPointSet* pointSet, const std::string& filename, const Affine3d& viewpoint = Affine3d::Identity());
+
+/**
+   The normals and colors are saved with the points when they are given for each point.
+*/
+CNOID_EXPORT void savePCD(SgPointSet* pointSet, const std::string& filename, const Affine3d& viewpoint = Affine3d::Identity(),
+                          PCDDataFormat dataFormat = PCD_ASCII);
 
 }
 
@@ -3,20 +3,165 @@
 #include "SceneShape.h"
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <fstream>
+#include <cstring>
+#include <cmath>
 
 using namespace std;
 using namespace boost::algorithm;
 using namespace cnoid;
+using boost::uint32_t;
 
+namespace {
 
-const char* STLSceneLoader::format() const
+/**
+   The spatial hash used to find the vertex which has already been added at the same position.
+   The vertices are hashed by their coordinates when the tolerance is zero. Otherwise they are
+   hashed by the cells of the grid whose size is the tolerance, and the 27 cells around a vertex
+   are searched for the vertex within the tolerance.
+*/
+class VertexWelder
 {
-    return "STL";
+public:
+    VertexWelder(SgVertexArray& vertices, double tolerance)
+        : vertices(vertices),
+          tolerance(tolerance),
+          sqrTolerance(tolerance * tolerance) {
+        mask = 1023;
+        table.resize(mask + 1, -1);
+    }
+
+    int weld(const Vector3f& v) {
+        Cell cell = getCell(v);
+        int index = -1;
+        if(tolerance <= 0.0){
+            index = find(cell, v);
+        } else {
+            for(int i=-1; index < 0 && i <= 1; ++i){
+                for(int j=-1; index < 0 && j <= 1; ++j){
+                    for(int k=-1; index < 0 && k <= 1; ++k){
+                        index = find(Cell(cell.x + i, cell.y + j, cell.z + k), v);
+                    }
+                }
+            }
+        }
+        if(index < 0){
+            index = vertices.size();
+            vertices.push_back(v);
+            cells.push_back(cell);
+            if(cells.size() * 2 > table.size()){
+                expandTable();
+            } else {
+                insert(index);
+            }
+        }
+        return index;
+    }
+
+private:
+    struct Cell {
+        int x, y, z;
+        Cell() { }
+        Cell(int x, int y, int z) : x(x), y(y), z(z) { }
+        bool operator==(const Cell& rhs) const { return x == rhs.x && y == rhs.y && z == rhs.z; }
+    };
+
+    SgVertexArray& vertices;
+    double tolerance;
+    double sqrTolerance;
+    std::vector<Cell> cells;
+    std::vector<int> table;
+    uint32_t mask;
+
+    static int toCellCoordinate(double x) {
+        static const double limit = 1 << 30;
+        return static_cast<int>(std::floor(std::max(-limit, std::min(x, limit))));
+    }
+
+    Cell getCell(const Vector3f& v) const {
+        Cell cell;
+        if(tolerance <= 0.0){
+            // Adding zero makes the bits of -0.0 same as those of 0.0
+            const float x = v.x() + 0.0f;
+            const float y = v.y() + 0.0f;
+            const float z = v.z() + 0.0f;
+            std::memcpy(&cell.x, &x, sizeof(float));
+            std::memcpy(&cell.y, &y, sizeof(float));
+            std::memcpy(&cell.z, &z, sizeof(float));
+        } else {
+            cell.x = toCellCoordinate(v.x() / tolerance);
+            cell.y = toCellCoordinate(v.y() / tolerance);
+            cell.z = toCellCoordinate(v.z() / tolerance);
+        }
+        return cell;
+    }
+
+    static uint32_t hash(const Cell& cell) {
+        uint32_t h = (uint32_t)cell.x * 73856093u ^ (uint32_t)cell.y * 19349663u ^ (uint32_t)cell.z * 83492791u;
+        h ^= h >> 16;
+        h *= 0x45d9f3bu;
+        h ^= h >> 16;
+        return h;
+    }
+
+    int find(const Cell& cell, const Vector3f& v) const {
+        uint32_t pos = hash(cell) & mask;
+        while(true){
+            const int index = table[pos];
+            if(index < 0){
+                return -1;
+            }
+            if(cells[index] == cell){
+                if(tolerance <= 0.0){
+                    if(vertices[index] == v){
+                        return index;
+                    }
+                } else if((vertices[index] - v).cast<double>().squaredNorm() <= sqrTolerance){
+                    return index;
+                }
+            }
+            pos = (pos + 1) & mask;
+        }
+    }
+
+    void insert(int index) {
+        uint32_t pos = hash(cells[index]) & mask;
+        while(table[pos] >= 0){
+            pos = (pos + 1) & mask;
+        }
+        table[pos] = index;
+    }
+
+    void expandTable() {
+        mask = mask * 2 + 1;
+        table.assign(mask + 1, -1);
+        for(size_t i=0; i < cells.size(); ++i){
+            insert(i);
+        }
+    }
+};
+
+
+inline float readFloat(const unsigned char* p)
+{
+    // The values of binary STL are always little endian
+    const uint32_t bits = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    float value;
+    std::memcpy(&value, &bits, sizeof(float));
+    return value;
 }
 
 
-static void readVector3(string text, SgVectorArray<Vector3f>* array)
+inline Vector3f readVector3f(const unsigned char* p)
+{
+    return Vector3f(readFloat(p), readFloat(p + 4), readFloat(p + 8));
+}
+
+
+void readVector3(string text, SgVectorArray<Vector3f>* array)
 {
     trim(text);
     Vector3f value;
@@ -31,47 +176,222 @@ static void readVector3(string text, SgVectorArray<Vector3f>* array)
     }
 }
 
+}
+
+namespace cnoid {
+
+class STLSceneLoaderImpl
+{
+public:
+    bool isVertexWeldingEnabled;
+    double weldingTolerance;
+
+    SgMeshPtr mesh;
+    SgVertexArrayPtr vertices;
+    SgNormalArrayPtr normals;
+    boost::scoped_ptr<VertexWelder> welder;
+
+    STLSceneLoaderImpl();
+    SgNode* load(const std::string& fileName);
+    void loadBinary(const unsigned char* data, int numTriangles);
+    void loadAscii(const std::string& fileName);
+    void initializeMesh(int numTriangles);
+    void addTriangle(const Vector3f& v0, const Vector3f& v1, const Vector3f& v2);
+    void addTriangle(const Vector3f& v0, const Vector3f& v1, const Vector3f& v2, const Vector3f& normal);
+};
+
+}
+
+
+STLSceneLoader::STLSceneLoader()
+{
+    impl = new STLSceneLoaderImpl;
+}
+
+
+STLSceneLoaderImpl::STLSceneLoaderImpl()
+{
+    isVertexWeldingEnabled = true;
+    weldingTolerance = 0.0;
+    mesh = 0;
+}
+
+
+STLSceneLoader::~STLSceneLoader()
+{
+    delete impl;
+}
+
+
+const char* STLSceneLoader::format() const
+{
+    return "STL";
+}
+
+
+void STLSceneLoader::setVertexWeldingEnabled(bool on)
+{
+    impl->isVertexWeldingEnabled = on;
+}
+
+
+void STLSceneLoader::setVertexWeldingTolerance(double tolerance)
+{
+    impl->weldingTolerance = tolerance;
+}
+
 
 SgNode* STLSceneLoader::load(const std::string& fileName)
+{
+    return impl->load(fileName);
+}
+
+
+SgNode* STLSceneLoaderImpl::load(const std::string& fileName)
+{
+    mesh = new SgMesh;
+    vertices = new SgVertexArray;
+    normals = new SgNormalArray;
+
+    /*
+      A binary STL file consists of the 80 bytes header, the number of the triangles
+      and the 50 bytes records of the triangles. A file is regarded as a binary one if
+      its size matches the number of the triangles or it does not start with "solid".
+    */
+    bool isBinary = false;
+    try {
+        boost::iostreams::mapped_file_source file(fileName);
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+        const size_t size = file.size();
+        if(size >= 84){
+            const uint32_t numTriangles =
+                data[80] | (data[81] << 8) | (data[82] << 16) | ((uint32_t)data[83] << 24);
+            const size_t binarySize = 84 + (size_t)numTriangles * 50;
+            if(size == binarySize || (size > binarySize && std::strncmp(file.data(), "solid", 5) != 0)){
+                isBinary = true;
+                loadBinary(data, numTriangles);
+            }
+        }
+    } catch(const std::exception&){
+        // An empty file cannot be mapped, and the other errors are detected by the ASCII parser
+    }
+
+    if(!isBinary){
+        loadAscii(fileName);
+    }
+
+    SgShape* shape = 0;
+
+    if(!vertices->empty()){
+        mesh->setVertices(vertices);
+        if(!normals->empty()){
+            mesh->setNormals(normals);
+        }
+        shape = new SgShape;
+        shape->setMesh(mesh);
+    }
+
+    welder.reset();
+    mesh = 0;
+    vertices = 0;
+    normals = 0;
+
+    return shape;
+}
+
+
+void STLSceneLoaderImpl::initializeMesh(int numTriangles)
+{
+    mesh->reserveNumTriangles(numTriangles);
+    if(isVertexWeldingEnabled){
+        welder.reset(new VertexWelder(*vertices, weldingTolerance));
+    } else {
+        vertices->reserve(numTriangles * 3);
+    }
+}
+
+
+void STLSceneLoaderImpl::loadBinary(const unsigned char* data, int numTriangles)
+{
+    initializeMesh(numTriangles);
+    normals->reserve(numTriangles);
+    mesh->normalIndices().reserve(numTriangles * 3);
+
+    const unsigned char* p = data + 84;
+    for(int i=0; i < numTriangles; ++i){
+        addTriangle(readVector3f(p + 12), readVector3f(p + 24), readVector3f(p + 36), readVector3f(p));
+        p += 50;
+    }
+}
+
+
+void STLSceneLoaderImpl::loadAscii(const std::string& fileName)
 {
     std::ifstream ifs(fileName.c_str(), std::ios::in);
 
-    SgVertexArrayPtr vertices = new SgVertexArray;
-    SgNormalArrayPtr normals = new SgNormalArray;
+    SgVertexArrayPtr facetVertices = new SgVertexArray;
+    SgNormalArrayPtr facetNormals = new SgNormalArray;
 
     std::string line;
     while(!ifs.eof() && getline(ifs, line)){
         trim(line);
         if(boost::istarts_with(line, "vertex")){
-            readVector3(line.substr(6), vertices);
+            readVector3(line.substr(6), facetVertices);
         } else if(boost::istarts_with(line, "facet normal")){
-            readVector3(line.substr(12), normals);
+            readVector3(line.substr(12), facetNormals);
         }
     }
 
-    SgShape* shape = 0;
-    
-    if(!vertices->empty()){
-        shape = new SgShape;
-        SgMesh* mesh = shape->getOrCreateMesh();
-        mesh->setVertices(vertices);
-        const int numTriangles = vertices->size() / 3;
-        mesh->reserveNumTriangles(numTriangles);
-        for(int i = 0; i < numTriangles; ++i){
-            const int j = i * 3;
-            mesh->addTriangle(j, j + 1, j + 2);
+    const int numTriangles = facetVertices->size() / 3;
+    initializeMesh(numTriangles);
+
+    const bool hasNormals = (facetNormals->size() == numTriangles);
+    if(hasNormals){
+        normals->reserve(numTriangles);
+        mesh->normalIndices().reserve(numTriangles * 3);
+    }
+    for(int i=0; i < numTriangles; ++i){
+        const int j = i * 3;
+        if(hasNormals){
+            addTriangle((*facetVertices)[j], (*facetVertices)[j + 1], (*facetVertices)[j + 2], (*facetNormals)[i]);
+        } else {
+            addTriangle((*facetVertices)[j], (*facetVertices)[j + 1], (*facetVertices)[j + 2]);
         }
-        if(!normals->empty()){
-            mesh->setNormals(normals);
-            SgIndexArray& indices = mesh->normalIndices();
-            indices.reserve(normals->size() * 3);
-            for(int i = 0; i < normals->size(); ++i) {
-                indices.push_back(i);
-                indices.push_back(i);
-                indices.push_back(i);
-            }
+    }
+}
+
+
+void STLSceneLoaderImpl::addTriangle(const Vector3f& v0, const Vector3f& v1, const Vector3f& v2)
+{
+    if(!welder.get()){
+        const int index = vertices->size();
+        vertices->push_back(v0);
+        vertices->push_back(v1);
+        vertices->push_back(v2);
+        mesh->addTriangle(index, index + 1, index + 2);
+    } else {
+        const int i0 = welder->weld(v0);
+        const int i1 = welder->weld(v1);
+        const int i2 = welder->weld(v2);
+        // The triangle which is degenerated by welding the vertices is removed
+        if(i0 != i1 && i1 != i2 && i2 != i0){
+            mesh->addTriangle(i0, i1, i2);
         }
     }
-    
-    return shape; 
+}
+
+
+void STLSceneLoaderImpl::addTriangle
+(const Vector3f& v0, const Vector3f& v1, const Vector3f& v2, const Vector3f& normal)
+{
+    const int numTriangles = mesh->numTriangles();
+    addTriangle(v0, v1, v2);
+    if(mesh->numTriangles() > numTriangles){
+        const int index = normals->size();
+        normals->push_back(normal);
+        SgIndexArray& indices = mesh->normalIndices();
+        indices.push_back(index);
+        indices.push_back(index);
+        indices.push_back(index);
+    }
 }
@@ -8,12 +8,27 @@ namespace cnoid {
 
 class STLSceneLoaderImpl;
 
+/**
+   This class loads both the ASCII and binary STL files.
+   The identical vertices of the triangles are welded into a shared vertex by default.
+*/
 class CNOID_EXPORT STLSceneLoader : public AbstractSceneLoader
 {
 public:
+    STLSceneLoader();
+    ~STLSceneLoader();
     virtual const char* format() const;
     virtual SgNode* load(const std::string& fileName);
 
+    void setVertexWeldingEnabled(bool on);
+
+    /**
+       The vertices whose distance is within the tolerance are welded.
+       The vertices are welded only when they have exactly the same coordinates
+       if the tolerance is zero, which is the default value.
+    */
+    void setVertexWeldingTolerance(double tolerance);
+
 private:
     STLSceneLoaderImpl* impl;
 };
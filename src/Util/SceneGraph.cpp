@@ -177,6 +177,12 @@ const BoundingBox& SgNode::boundingBox() const
 }
 
 
+bool SgNode::isUnbounded() const
+{
+    return false;
+}
+
+
 bool SgNode::isGroup() const
 {
     return false;
@@ -186,6 +192,7 @@ bool SgNode::isGroup() const
 SgGroup::SgGroup()
 {
     isBboxCacheValid = false;
+    isUnboundedCacheValid = false;
 }
 
 
@@ -201,6 +208,7 @@ SgGroup::SgGroup(const SgGroup& org)
 
     isBboxCacheValid = true;
     bboxCache = org.bboxCache;
+    isUnboundedCacheValid = false;
 }
 
 
@@ -215,6 +223,7 @@ SgGroup::SgGroup(const SgGroup& org, SgCloneMap& cloneMap)
 
     isBboxCacheValid = true;
     bboxCache = org.bboxCache;
+    isUnboundedCacheValid = false;
 }
 
 
@@ -273,6 +282,22 @@ const BoundingBox& SgGroup::boundingBox() const
 }
 
 
+bool SgGroup::isUnbounded() const
+{
+    if(!isUnboundedCacheValid){
+        isUnboundedCache = false;
+        for(const_iterator p = begin(); p != end(); ++p){
+            if((*p)->isUnbounded()){
+                isUnboundedCache = true;
+                break;
+            }
+        }
+        isUnboundedCacheValid = true;
+    }
+    return isUnboundedCache;
+}
+
+
 bool SgGroup::isGroup() const
 {
     return true;
@@ -1634,6 +1659,15 @@ void SgOverlay::accept(SceneVisitor& visitor)
 }
 
 
+/**
+   The overlay is rendered in its own view volume regardless of the camera.
+*/
+bool SgOverlay::isUnbounded() const
+{
+    return true;
+}
+
+
 void SgOverlay::calcViewVolume(double viewportWidth, double viewportHeight, ViewVolume& io_volume)
 {
 
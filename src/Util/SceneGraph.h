@@ -148,6 +148,13 @@ public:
     virtual void accept(SceneVisitor& visitor);
     virtual const BoundingBox& boundingBox() const;
 
+    /**
+       True if the node renders something which is not covered by its bounding box,
+       such as a custom OpenGL node or an overlay. The groups containing such a node
+       must not be culled by their bounding boxes.
+    */
+    virtual bool isUnbounded() const;
+
     SgNode* cloneNode(SgCloneMap& cloneMap) const {
         return static_cast<SgNode*>(this->clone(cloneMap));
     }
@@ -182,9 +189,10 @@ public:
     virtual void accept(SceneVisitor& visitor);
     virtual void transferUpdate(SgUpdate& update);
     virtual const BoundingBox& boundingBox() const;
+    virtual bool isUnbounded() const;
     virtual bool isGroup() const;
         
-    void invalidateBoundingBox() { isBboxCacheValid = false; }
+    void invalidateBoundingBox() { isBboxCacheValid = false; isUnboundedCacheValid = false; }
 
     const_iterator begin() const { return children.begin(); }
     const_iterator end() const { return children.end(); }
@@ -228,6 +236,8 @@ public:
 protected:
     mutable BoundingBox bboxCache;
     mutable bool isBboxCacheValid;
+    mutable bool isUnboundedCache;
+    mutable bool isUnboundedCacheValid;
 
 private:
     Container children;
@@ -394,6 +404,7 @@ public:
 
     virtual SgObject* clone(SgCloneMap& cloneMap) const;
     virtual void accept(SceneVisitor& visitor);
+    virtual bool isUnbounded() const;
 
     struct ViewVolume {
         double left;
@@ -0,0 +1,659 @@
+/*!
+  @file
+  @author Shin'ichiro Nakaoka
+*/
+
+#include "SceneRayPicker.h"
+#include "SceneShape.h"
+#include "SceneVisitor.h"
+#include <map>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// The same minimum width as the one used in the picking of GLSceneRenderer
+const double MinPickingWidth = 5.0;
+
+const int MaxNumTrianglesInLeaf = 4;
+const int MaxBVHDepth = 64;
+
+struct BVHNode
+{
+    Vector3f min;
+    Vector3f max;
+    // The index of the second child for an inner node, or the first triangle for a leaf.
+    // The first child of an inner node is the next node.
+    int index;
+    // Zero for an inner node
+    int numTriangles;
+};
+
+
+bool intersectBox(const Vector3& origin, const Vector3& invDirection,
+                  const Vector3& min, const Vector3& max, double tmax, double& out_tmin)
+{
+    double t0 = 0.0;
+    double t1 = tmax;
+    for(int i=0; i < 3; ++i){
+        double ta = (min[i] - origin[i]) * invDirection[i];
+        double tb = (max[i] - origin[i]) * invDirection[i];
+        if(ta > tb){
+            std::swap(ta, tb);
+        }
+        if(ta > t0){
+            t0 = ta;
+        }
+        if(tb < t1){
+            t1 = tb;
+        }
+        if(t0 > t1){
+            return false;
+        }
+    }
+    out_tmin = t0;
+    return true;
+}
+
+
+struct CentroidLess
+{
+    const vector<Vector3f>& centroids;
+    int axis;
+    CentroidLess(const vector<Vector3f>& centroids, int axis) : centroids(centroids), axis(axis) { }
+    bool operator()(int i, int j) const {
+        return centroids[i][axis] < centroids[j][axis];
+    }
+};
+
+
+class MeshBVH : public Referenced
+{
+public:
+    weak_ref_ptr<SgMesh> mesh;
+    int numVertices;
+    int numTriangles;
+    vector<BVHNode> nodes;
+    vector<int> triangles;
+
+    MeshBVH(SgMesh* mesh);
+    bool isValidFor(SgMesh* mesh) const;
+    int build(int begin, int end, const SgVertexArray& vertices, const SgIndexArray& triangleVertices,
+              const vector<Vector3f>& centroids);
+    bool intersect(const SgMesh* mesh, const Vector3& origin, const Vector3& direction,
+                   int frontFaceSign, double& io_t, Vector3& out_normal) const;
+};
+typedef ref_ptr<MeshBVH> MeshBVHPtr;
+
+}
+
+namespace cnoid {
+
+class SceneRayPickerImpl : public SceneVisitor
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+    Vector3 start;
+    Vector3 direction;
+    Vector3 invDirection;
+    double pixelSizeAtStart;
+    double pixelSizeAtEnd;
+    double defaultPointSize;
+    double defaultLineWidth;
+
+    // The width used to expand the bounding boxes so that the points and lines near them can be picked
+    double maxPickingWidth;
+
+    // The transform from the current coordinate to the root coordinate
+    Affine3 T;
+    SgNodePath currentNodePath;
+
+    double tPicked;
+    SgNodePath pickedNodePath;
+    Vector3 pickedPoint;
+    Vector3 pickedNormal;
+
+    typedef std::map<SgMesh*, MeshBVHPtr> BVHMap;
+    BVHMap bvhMap;
+    bool isExpiredCacheCheckNeeded;
+
+    SceneRayPickerImpl();
+    bool pick(SgNode* root, const Vector3& start, const Vector3& end);
+    double pixelSize(double t) const {
+        return pixelSizeAtStart + (pixelSizeAtEnd - pixelSizeAtStart) * t;
+    }
+    bool checkBoundingBox(const BoundingBox& bbox, double width);
+    void pickGroup(SgGroup* group);
+    void setPickedObject(double t);
+    MeshBVH* getBVH(SgMesh* mesh);
+    void invalidateCache(const SgUpdate& update);
+
+    virtual void visitGroup(SgGroup* group);
+    virtual void visitTransform(SgTransform* transform);
+    virtual void visitUnpickableGroup(SgUnpickableGroup* group);
+    virtual void visitShape(SgShape* shape);
+    virtual void visitPointSet(SgPointSet* pointSet);
+    virtual void visitLineSet(SgLineSet* lineSet);
+    virtual void visitPreprocessed(SgPreprocessed* preprocessed);
+    virtual void visitOverlay(SgOverlay* overlay);
+};
+
+}
+
+
+MeshBVH::MeshBVH(SgMesh* mesh)
+    : mesh(mesh)
+{
+    const SgVertexArray& vertices = *mesh->vertices();
+    const SgIndexArray& triangleVertices = mesh->triangleVertices();
+    numVertices = vertices.size();
+    numTriangles = mesh->numTriangles();
+
+    vector<Vector3f> centroids(numTriangles);
+    triangles.reserve(numTriangles);
+    for(int i=0; i < numTriangles; ++i){
+        const int* tri = &triangleVertices[i * 3];
+        if(tri[0] < 0 || tri[0] >= numVertices ||
+           tri[1] < 0 || tri[1] >= numVertices ||
+           tri[2] < 0 || tri[2] >= numVertices){
+            continue;
+        }
+        centroids[i] = (vertices[tri[0]] + vertices[tri[1]] + vertices[tri[2]]) / 3.0f;
+        triangles.push_back(i);
+    }
+
+    if(!triangles.empty()){
+        nodes.reserve(2 * triangles.size() / MaxNumTrianglesInLeaf + 1);
+        build(0, triangles.size(), vertices, triangleVertices, centroids);
+    }
+}
+
+
+bool MeshBVH::isValidFor(SgMesh* mesh) const
+{
+    return (!this->mesh.expired() &&
+            mesh->vertices()->size() == numVertices &&
+            mesh->numTriangles() == numTriangles);
+}
+
+
+/**
+   The triangles are divided at the median of the centroids on the longest axis of their bounds.
+   @return the index of the node
+*/
+int MeshBVH::build
+(int begin, int end, const SgVertexArray& vertices, const SgIndexArray& triangleVertices,
+ const vector<Vector3f>& centroids)
+{
+    const int index = nodes.size();
+    nodes.push_back(BVHNode());
+
+    BoundingBoxf bbox;
+    BoundingBoxf centroidBox;
+    for(int i=begin; i < end; ++i){
+        const int t = triangles[i];
+        for(int j=0; j < 3; ++j){
+            bbox.expandBy(vertices[triangleVertices[t * 3 + j]]);
+        }
+        centroidBox.expandBy(centroids[t]);
+    }
+
+    int axis;
+    const Vector3f size = centroidBox.max() - centroidBox.min();
+    size.maxCoeff(&axis);
+
+    if(end - begin <= MaxNumTrianglesInLeaf || size[axis] <= 0.0f){
+        BVHNode& node = nodes[index];
+        node.min = bbox.min();
+        node.max = bbox.max();
+        node.index = begin;
+        node.numTriangles = end - begin;
+    } else {
+        const int mid = (begin + end) / 2;
+        std::nth_element(triangles.begin() + begin, triangles.begin() + mid, triangles.begin() + end,
+                         CentroidLess(centroids, axis));
+        build(begin, mid, vertices, triangleVertices, centroids);
+        const int second = build(mid, end, vertices, triangleVertices, centroids);
+        BVHNode& node = nodes[index];
+        node.min = bbox.min();
+        node.max = bbox.max();
+        node.index = second;
+        node.numTriangles = 0;
+    }
+
+    return index;
+}
+
+
+/**
+   @param frontFaceSign 1 or -1 if the back faces are not picked, or 0 if both the faces are picked.
+   The sign is -1 when the mesh is mirrored by the transform.
+   @param io_t the parameter of the nearest hit on the ray, which is updated when a nearer
+   triangle is hit
+*/
+bool MeshBVH::intersect
+(const SgMesh* mesh, const Vector3& origin, const Vector3& direction,
+ int frontFaceSign, double& io_t, Vector3& out_normal) const
+{
+    if(nodes.empty()){
+        return false;
+    }
+
+    const SgVertexArray& vertices = *mesh->vertices();
+    const SgIndexArray& triangleVertices = mesh->triangleVertices();
+    const Vector3 invDirection = direction.cwiseInverse();
+    bool isHit = false;
+
+    int stack[MaxBVHDepth * 2];
+    int stackSize = 0;
+    double tmin;
+    if(intersectBox(origin, invDirection, nodes[0].min.cast<double>(), nodes[0].max.cast<double>(), io_t, tmin)){
+        stack[stackSize++] = 0;
+    }
+
+    while(stackSize > 0){
+        const int nodeIndex = stack[--stackSize];
+        const BVHNode& node = nodes[nodeIndex];
+
+        if(node.numTriangles > 0){
+            const int end = node.index + node.numTriangles;
+            for(int i=node.index; i < end; ++i){
+                const int* tri = &triangleVertices[triangles[i] * 3];
+                const Vector3 v0 = vertices[tri[0]].cast<double>();
+                const Vector3 e1 = vertices[tri[1]].cast<double>() - v0;
+                const Vector3 e2 = vertices[tri[2]].cast<double>() - v0;
+                const Vector3 p = direction.cross(e2);
+                const double det = e1.dot(p);
+                // The determinant is positive when the ray hits the front face of a CCW triangle
+                if(det == 0.0 || det * frontFaceSign < 0.0){
+                    continue;
+                }
+                const double invDet = 1.0 / det;
+                const Vector3 s = origin - v0;
+                const double u = s.dot(p) * invDet;
+                if(u < 0.0 || u > 1.0){
+                    continue;
+                }
+                const Vector3 q = s.cross(e1);
+                const double v = direction.dot(q) * invDet;
+                if(v < 0.0 || u + v > 1.0){
+                    continue;
+                }
+                const double t = e2.dot(q) * invDet;
+                if(t >= 0.0 && t < io_t){
+                    io_t = t;
+                    out_normal = e1.cross(e2);
+                    isHit = true;
+                }
+            }
+        } else {
+            // The nearer child is visited first
+            const int children[2] = { nodeIndex + 1, node.index };
+            double tmins[2];
+            bool hits[2];
+            for(int i=0; i < 2; ++i){
+                const BVHNode& child = nodes[children[i]];
+                hits[i] = intersectBox(
+                    origin, invDirection, child.min.cast<double>(), child.max.cast<double>(), io_t, tmins[i]);
+            }
+            if(hits[0] && hits[1]){
+                if(tmins[0] < tmins[1]){
+                    stack[stackSize++] = children[1];
+                    stack[stackSize++] = children[0];
+                } else {
+                    stack[stackSize++] = children[0];
+                    stack[stackSize++] = children[1];
+                }
+            } else if(hits[0]){
+                stack[stackSize++] = children[0];
+            } else if(hits[1]){
+                stack[stackSize++] = children[1];
+            }
+        }
+    }
+
+    return isHit;
+}
+
+
+SceneRayPicker::SceneRayPicker()
+{
+    impl = new SceneRayPickerImpl();
+}
+
+
+SceneRayPickerImpl::SceneRayPickerImpl()
+{
+    pixelSizeAtStart = 0.0;
+    pixelSizeAtEnd = 0.0;
+    defaultPointSize = 1.0;
+    defaultLineWidth = 1.0;
+    T.setIdentity();
+    tPicked = 1.0;
+    pickedPoint.setZero();
+    pickedNormal.setZero();
+    isExpiredCacheCheckNeeded = false;
+}
+
+
+SceneRayPicker::~SceneRayPicker()
+{
+    delete impl;
+}
+
+
+void SceneRayPicker::setPixelSizes(double sizeAtStart, double sizeAtEnd)
+{
+    impl->pixelSizeAtStart = sizeAtStart;
+    impl->pixelSizeAtEnd = sizeAtEnd;
+}
+
+
+void SceneRayPicker::setDefaultPointSize(double size)
+{
+    impl->defaultPointSize = size;
+}
+
+
+void SceneRayPicker::setDefaultLineWidth(double width)
+{
+    impl->defaultLineWidth = width;
+}
+
+
+bool SceneRayPicker::pick(SgNode* root, const Vector3& start, const Vector3& end)
+{
+    return impl->pick(root, start, end);
+}
+
+
+bool SceneRayPickerImpl::pick(SgNode* root, const Vector3& start, const Vector3& end)
+{
+    if(isExpiredCacheCheckNeeded){
+        BVHMap::iterator p = bvhMap.begin();
+        while(p != bvhMap.end()){
+            if(p->second->mesh.expired()){
+                bvhMap.erase(p++);
+            } else {
+                ++p;
+            }
+        }
+        isExpiredCacheCheckNeeded = false;
+    }
+
+    this->start = start;
+    direction = end - start;
+    invDirection = direction.cwiseInverse();
+    maxPickingWidth = std::max(MinPickingWidth, std::max(defaultPointSize, defaultLineWidth));
+    T.setIdentity();
+    currentNodePath.clear();
+
+    // The parameter of the ray is 0 at the start point and 1 at the end point
+    tPicked = 1.0;
+    pickedNodePath.clear();
+    pickedPoint.setZero();
+    pickedNormal.setZero();
+
+    root->accept(*this);
+
+    return !pickedNodePath.empty();
+}
+
+
+const SgNodePath& SceneRayPicker::pickedNodePath() const
+{
+    return impl->pickedNodePath;
+}
+
+
+const Vector3& SceneRayPicker::pickedPoint() const
+{
+    return impl->pickedPoint;
+}
+
+
+const Vector3& SceneRayPicker::pickedNormal() const
+{
+    return impl->pickedNormal;
+}
+
+
+void SceneRayPicker::invalidateCache(const SgUpdate& update)
+{
+    impl->invalidateCache(update);
+}
+
+
+void SceneRayPickerImpl::invalidateCache(const SgUpdate& update)
+{
+    if(update.action() & SgUpdate::REMOVED){
+        isExpiredCacheCheckNeeded = true;
+    }
+    // The update of a vertex array is propagated to the mesh owning it
+    const SgUpdate::Path& path = update.path();
+    for(size_t i=0; i < path.size() && i < 2; ++i){
+        if(SgMesh* mesh = dynamic_cast<SgMesh*>(path[i])){
+            bvhMap.erase(mesh);
+            break;
+        }
+    }
+}
+
+
+void SceneRayPicker::clearCache()
+{
+    impl->bvhMap.clear();
+}
+
+
+/**
+   The bounding box in the current coordinate is tested in the root coordinate,
+   where it is expanded by the half of the picking width in pixels.
+*/
+bool SceneRayPickerImpl::checkBoundingBox(const BoundingBox& bbox, double width)
+{
+    if(bbox.empty()){
+        return false;
+    }
+    BoundingBox b(bbox);
+    b.transform(T);
+    const double margin = 0.5 * width * std::max(pixelSize(0.0), pixelSize(tPicked));
+    const Vector3 d(margin, margin, margin);
+    double tmin;
+    return intersectBox(start, invDirection, b.min() - d, b.max() + d, tPicked, tmin);
+}
+
+
+void SceneRayPickerImpl::pickGroup(SgGroup* group)
+{
+    currentNodePath.push_back(group);
+    for(SgGroup::const_iterator p = group->begin(); p != group->end(); ++p){
+        (*p)->accept(*this);
+    }
+    currentNodePath.pop_back();
+}
+
+
+void SceneRayPickerImpl::setPickedObject(double t)
+{
+    tPicked = t;
+    pickedNodePath = currentNodePath;
+    pickedPoint = start + t * direction;
+}
+
+
+void SceneRayPickerImpl::visitGroup(SgGroup* group)
+{
+    if(checkBoundingBox(group->boundingBox(), maxPickingWidth)){
+        pickGroup(group);
+    }
+}
+
+
+void SceneRayPickerImpl::visitTransform(SgTransform* transform)
+{
+    // The bounding box of the transform node is tested in the parent coordinate
+    if(checkBoundingBox(transform->boundingBox(), maxPickingWidth)){
+        Affine3 T1;
+        transform->getTransform(T1);
+        const Affine3 T0 = T;
+        T = T0 * T1;
+        pickGroup(transform);
+        T = T0;
+    }
+}
+
+
+void SceneRayPickerImpl::visitUnpickableGroup(SgUnpickableGroup* group)
+{
+
+}
+
+
+MeshBVH* SceneRayPickerImpl::getBVH(SgMesh* mesh)
+{
+    MeshBVHPtr& bvh = bvhMap[mesh];
+    if(!bvh || !bvh->isValidFor(mesh)){
+        bvh = new MeshBVH(mesh);
+    }
+    return bvh.get();
+}
+
+
+void SceneRayPickerImpl::visitShape(SgShape* shape)
+{
+    SgMesh* mesh = shape->mesh();
+    if(!mesh || !mesh->hasVertices() || mesh->numTriangles() == 0){
+        return;
+    }
+    if(!checkBoundingBox(mesh->boundingBox(), 0.0)){
+        return;
+    }
+
+    // The parameter of the ray is not changed by the transformation into the mesh coordinate
+    const Affine3 Tinv = T.inverse();
+    const Vector3 localStart = Tinv * start;
+    const Vector3 localDirection = Tinv.linear() * direction;
+
+    int frontFaceSign = 0;
+    if(mesh->isSolid()){
+        frontFaceSign = (T.linear().determinant() < 0.0) ? -1 : 1;
+    }
+
+    double t = tPicked;
+    Vector3 normal;
+    if(getBVH(mesh)->intersect(mesh, localStart, localDirection, frontFaceSign, t, normal)){
+        currentNodePath.push_back(shape);
+        setPickedObject(t);
+        currentNodePath.pop_back();
+        pickedNormal = Tinv.linear().transpose() * normal;
+        if(pickedNormal.dot(direction) > 0.0){
+            pickedNormal = -pickedNormal;
+        }
+        pickedNormal.normalize();
+    }
+}
+
+
+void SceneRayPickerImpl::visitPointSet(SgPointSet* pointSet)
+{
+    if(!pointSet->hasVertices()){
+        return;
+    }
+    const double size = std::max(pointSet->pointSize() > 0.0 ? pointSet->pointSize() : defaultPointSize,
+                                 MinPickingWidth);
+    if(!checkBoundingBox(pointSet->boundingBox(), size)){
+        return;
+    }
+
+    const SgVertexArray& vertices = *pointSet->vertices();
+    const double dd = direction.squaredNorm();
+    double tmin = tPicked;
+    for(size_t i=0; i < vertices.size(); ++i){
+        const Vector3 p = T * vertices[i].cast<double>();
+        const double t = (p - start).dot(direction) / dd;
+        if(t >= 0.0 && t < tmin){
+            const double r = 0.5 * size * pixelSize(t);
+            if((p - (start + t * direction)).squaredNorm() <= r * r){
+                tmin = t;
+            }
+        }
+    }
+    if(tmin < tPicked){
+        currentNodePath.push_back(pointSet);
+        setPickedObject(tmin);
+        currentNodePath.pop_back();
+        pickedNormal.setZero();
+    }
+}
+
+
+void SceneRayPickerImpl::visitLineSet(SgLineSet* lineSet)
+{
+    const int n = lineSet->numLines();
+    if(!lineSet->hasVertices() || (n <= 0)){
+        return;
+    }
+    const double width = std::max(lineSet->lineWidth() > 0.0 ? lineSet->lineWidth() : defaultLineWidth,
+                                  MinPickingWidth);
+    if(!checkBoundingBox(lineSet->boundingBox(), width)){
+        return;
+    }
+
+    const SgVertexArray& vertices = *lineSet->vertices();
+    const int numVertices = vertices.size();
+    const double dd = direction.squaredNorm();
+    double tmin = tPicked;
+
+    for(int i=0; i < n; ++i){
+        SgLineSet::LineRef line = lineSet->line(i);
+        if(line[0] < 0 || line[0] >= numVertices || line[1] < 0 || line[1] >= numVertices){
+            continue;
+        }
+        const Vector3 a = T * vertices[line[0]].cast<double>();
+        const Vector3 u = T * vertices[line[1]].cast<double>() - a;
+
+        // The closest points between the ray and the segment
+        const double uu = u.squaredNorm();
+        const double du = direction.dot(u);
+        const Vector3 w = start - a;
+        const double dw = direction.dot(w);
+        const double uw = u.dot(w);
+        const double denom = dd * uu - du * du;
+        double s = (denom > 1.0e-12 * dd * uu) ? (dd * uw - du * dw) / denom : 0.0;
+        if(s < 0.0){
+            s = 0.0;
+        } else if(s > 1.0){
+            s = 1.0;
+        }
+        const Vector3 q = a + s * u;
+        const double t = (q - start).dot(direction) / dd;
+        if(t >= 0.0 && t < tmin){
+            const double r = 0.5 * width * pixelSize(t);
+            if((q - (start + t * direction)).squaredNorm() <= r * r){
+                tmin = t;
+            }
+        }
+    }
+    if(tmin < tPicked){
+        currentNodePath.push_back(lineSet);
+        setPickedObject(tmin);
+        currentNodePath.pop_back();
+        pickedNormal.setZero();
+    }
+}
+
+
+void SceneRayPickerImpl::visitPreprocessed(SgPreprocessed* preprocessed)
+{
+
+}
+
+
+void SceneRayPickerImpl::visitOverlay(SgOverlay* overlay)
+{
+
+}
@@ -0,0 +1,69 @@
+/*!
+  @file
+  @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_UTIL_SCENE_RAY_PICKER_H_INCLUDED
+#define CNOID_UTIL_SCENE_RAY_PICKER_H_INCLUDED
+
+#include "SceneGraph.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SceneRayPickerImpl;
+
+/**
+   This class picks the nearest object on a ray by testing the ray against the scene graph
+   on the CPU. The subtrees whose bounding boxes the ray does not pass are skipped, and the
+   triangles of each mesh are tested with the bounding volume hierarchy which is built
+   when the mesh is picked first and kept until the mesh is updated.
+   The node path of the picked object is the same as the one given by the picking of
+   GLSceneRenderer, where the unpickable groups and overlays are not picked.
+*/
+class CNOID_EXPORT SceneRayPicker
+{
+public:
+    SceneRayPicker();
+    ~SceneRayPicker();
+
+    /**
+       The pixel sizes at the start point and the end point of the ray, which are given when
+       the ray is the segment from the near plane to the far plane of a view volume.
+       The points and lines are picked within their sizes in pixels like the rendered ones.
+       The pixel size between the two points is interpolated linearly.
+    */
+    void setPixelSizes(double sizeAtStart, double sizeAtEnd);
+    void setDefaultPointSize(double size);
+    void setDefaultLineWidth(double width);
+
+    /**
+       @param start the start point of the ray in the coordinate of the root node
+       @param end the end point of the ray. The objects beyond this point are not picked.
+       @return true if an object is picked
+    */
+    bool pick(SgNode* root, const Vector3& start, const Vector3& end);
+
+    const SgNodePath& pickedNodePath() const;
+    const Vector3& pickedPoint() const;
+
+    /**
+       The normal of the picked triangle facing the start point of the ray.
+       This is zero when a point or a line is picked.
+    */
+    const Vector3& pickedNormal() const;
+
+    /**
+       This function must be called with the updates of the scene graph so that the
+       hierarchy of a mesh whose vertices or triangles are updated is built again.
+    */
+    void invalidateCache(const SgUpdate& update);
+    void clearCache();
+
+private:
+    SceneRayPickerImpl* impl;
+};
+
+}
+
+#endif
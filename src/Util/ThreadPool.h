@@ -15,10 +15,13 @@ private:
     boost::thread_group group;
     boost::mutex mutex;
     boost::condition_variable condition;
+    boost::condition_variable finishCondition;
+    int numActiveThreads;
     bool isDestroying;
         
 public:
     ThreadPool(int size = 1) {
+        numActiveThreads = 0;
         isDestroying = false;
         for(int i = 0; i < size; i++){
             group.create_thread(boost::bind(&ThreadPool::run, this));
@@ -40,6 +43,16 @@ public:
         queue.push(f);
         condition.notify_one();
     }
+
+    /**
+       Wait until all the started functions are finished
+    */
+    void wait() {
+        boost::mutex::scoped_lock lock(mutex);
+        while(!queue.empty() || numActiveThreads > 0){
+            finishCondition.wait(lock);
+        }
+    }
         
 private:
     void run() {
@@ -54,10 +67,15 @@ private:
                 if(!queue.empty()){
                     f = queue.front();
                     queue.pop();
+                    ++numActiveThreads;
                 }
             }
             if(f){
                 f();
+                boost::mutex::scoped_lock lock(mutex);
+                if(--numActiveThreads == 0 && queue.empty()){
+                    finishCondition.notify_all();
+                }
             } else {
                 break;
             }
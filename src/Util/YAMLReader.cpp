@@ -4,6 +4,7 @@
 
 #include "YAMLReader.h"
 #include <cerrno>
+#include <cstdlib>
 #include <stack>
 #include <iostream>
 #include <yaml.h>
@@ -40,6 +41,8 @@ public:
     void onListingEnd(yaml_event_t& event);
     void onScalar(yaml_event_t& event);
     void onAlias(yaml_event_t& event);
+    bool startNumericListing();
+    void putNumericScalar(const yaml_event_t& event);
 
     static ScalarNode* createScalar(const yaml_event_t& event);
         
@@ -63,6 +66,13 @@ public:
     bool isRegularMultiListingExpected;
     vector<int> expectedListingSizes;
 
+    string numericListingKey;
+    YAMLReader::NumericListingReceiver* numericListingReceiver;
+    int numericListingDepth;
+    vector<double> numericElement;
+    vector<int> numericSubElementSizes;
+    int numericSubElementStart;
+
     string errorMessage;
 };
 }
@@ -81,6 +91,9 @@ YAMLReaderImpl::YAMLReaderImpl()
     mappingFactory = new YAMLReader::MappingFactory<Mapping>();
     currentDocumentIndex = 0;
     isRegularMultiListingExpected = false;
+    numericListingReceiver = 0;
+    numericListingDepth = 0;
+    numericSubElementStart = 0;
 }
 
 
@@ -122,6 +135,13 @@ void YAMLReader::expectRegularMultiListing()
 }
 
 
+void YAMLReader::setNumericListingReceiver(const std::string& key, NumericListingReceiver* receiver)
+{
+    impl->numericListingKey = key;
+    impl->numericListingReceiver = receiver;
+}
+
+
 void YAMLReader::clearDocuments()
 {
     impl->clearDocuments();
@@ -134,6 +154,7 @@ void YAMLReaderImpl::clearDocuments()
         nodeStack.pop();
     }
     documents.clear();
+    numericListingDepth = 0;
 }
 
 
@@ -331,6 +352,13 @@ void YAMLReaderImpl::onMappingStart(yaml_event_t& event)
         cout << "YAMLReaderImpl::onMappingStart()" << endl;
     }
 
+    if(numericListingDepth > 0){
+        ValueNode::SyntaxException ex;
+        ex.setMessage("A mapping cannot be put in the listing of numbers");
+        ex.setPosition(event.start_mark.line, event.start_mark.column);
+        throw ex;
+    }
+
     NodeInfo info;
     Mapping* mapping = mappingFactory->create(event.start_mark.line, event.start_mark.column);
     mapping->setFlowStyle(event.data.mapping_start.style == YAML_FLOW_MAPPING_STYLE);
@@ -356,6 +384,17 @@ void YAMLReaderImpl::onListingStart(yaml_event_t& event)
         cout << "YAMLReaderImpl::onListingStart()" << endl;
     }
 
+    if(numericListingDepth > 0){
+        ++numericListingDepth;
+        if(numericListingDepth == 3){
+            numericSubElementStart = numericElement.size();
+        }
+        return;
+    }
+    if(numericListingReceiver && startNumericListing()){
+        return;
+    }
+
     NodeInfo info;
     Listing* listing;
 
@@ -382,6 +421,23 @@ void YAMLReaderImpl::onListingEnd(yaml_event_t& event)
         cout << "YAMLReaderImpl::onListingEnd()" << endl;
     }
 
+    if(numericListingDepth > 0){
+        --numericListingDepth;
+        if(numericListingDepth == 2){
+            numericSubElementSizes.push_back(numericElement.size() - numericSubElementStart);
+        } else if(numericListingDepth == 1){
+            numericListingReceiver->putElement(
+                numericElement.empty() ? 0 : &numericElement[0], numericElement.size(),
+                numericSubElementSizes);
+            numericElement.clear();
+            numericSubElementSizes.clear();
+        } else if(numericListingDepth == 0){
+            numericListingReceiver->endListing();
+            nodeStack.top().key.clear();
+        }
+        return;
+    }
+
     if(isRegularMultiListingExpected){
         Listing* listing = static_cast<Listing*>(nodeStack.top().node.get());
         const int level = nodeStack.size() - 1;
@@ -398,6 +454,11 @@ void YAMLReaderImpl::onScalar(yaml_event_t& event)
         cout << "YAMLReaderImpl::onScalar()" << endl;
     }
 
+    if(numericListingDepth > 0){
+        putNumericScalar(event);
+        return;
+    }
+
     yaml_char_t* value = event.data.scalar.value;
     size_t length = event.data.scalar.length;
 
@@ -466,6 +527,52 @@ ScalarNode* YAMLReaderImpl::createScalar(const yaml_event_t& event)
 }
 
 
+bool YAMLReaderImpl::startNumericListing()
+{
+    if(nodeStack.empty()){
+        return false;
+    }
+    NodeInfo& info = nodeStack.top();
+    if(info.node->type() != ValueNode::MAPPING || info.key != numericListingKey){
+        return false;
+    }
+    if(!numericListingReceiver->startListing(*static_cast<Mapping*>(info.node.get()))){
+        return false;
+    }
+    numericListingDepth = 1;
+    numericElement.clear();
+    numericSubElementSizes.clear();
+    return true;
+}
+
+
+/**
+   The scalar is converted into a double value in the same way as ValueNode::toDouble()
+   without creating a ScalarNode object.
+*/
+void YAMLReaderImpl::putNumericScalar(const yaml_event_t& event)
+{
+    const char* nptr = (const char*)event.data.scalar.value;
+    char* endptr;
+    const double value = strtod(nptr, &endptr);
+
+    if(endptr == nptr){
+        const yaml_mark_t& start_mark = event.start_mark;
+        ValueNode::ScalarTypeMismatchException ex;
+        ex.setMessage(str(format("\"%1%\" at line %2%, column %3% should be a double value.")
+                          % nptr % start_mark.line % start_mark.column));
+        ex.setPosition(start_mark.line, start_mark.column);
+        throw ex;
+    }
+
+    if(numericListingDepth == 1){
+        numericListingReceiver->putElement(&value, 1, numericSubElementSizes);
+    } else {
+        numericElement.push_back(value);
+    }
+}
+
+
 void YAMLReaderImpl::onAlias(yaml_event_t& event)
 {
     if(debugTrace){
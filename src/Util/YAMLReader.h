@@ -6,6 +6,7 @@
 #define CNOID_UTIL_YAML_READER_H_INCLUDED
 
 #include "ValueTree.h"
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -27,6 +28,31 @@ class CNOID_EXPORT YAMLReader
         
 public:
 
+    /**
+       The receiver of the numbers in a listing which is parsed without creating the nodes.
+       The listing received by this object does not appear in the loaded document.
+    */
+    class NumericListingReceiver {
+    public:
+        virtual ~NumericListingReceiver() { }
+
+        /**
+           Called when a listing is started as the value of the registered key.
+           The pairs which precede the key are available in the mapping.
+           @return false if the listing should be loaded into the document as usual
+        */
+        virtual bool startListing(const Mapping& mapping) = 0;
+
+        /**
+           Called for each element of the listing.
+           The numbers in the nested listings of the element are flattened into the values.
+           @param subElementSizes the number of values in each nested listing of the element
+        */
+        virtual void putElement(const double* values, int size, const std::vector<int>& subElementSizes) = 0;
+
+        virtual void endListing() = 0;
+    };
+
     YAMLReader();
     ~YAMLReader();
 
@@ -35,6 +61,14 @@ public:
     }
         
     void expectRegularMultiListing();
+
+    /**
+       The listings which are the values of the given key are passed to the receiver
+       element by element instead of being loaded into the document.
+       This is used to read a large listing of numbers efficiently.
+       The receiver is not owned by the reader, and a null receiver disables this function.
+    */
+    void setNumericListingReceiver(const std::string& key, NumericListingReceiver* receiver);
 #ifdef CNOID_BACKWARD_COMPATIBILITY
     void expectRegularMultiSequence() { expectRegularMultiListing(); }
     bool load_string(const std::string& yamlstring) { return parse(yamlstring); }